@@ -1,19 +1,143 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <cstdint>
+#include <optional>
+#include <string>
 
 namespace MITSU_Domoe
 {
+    // What the rows of Polygon_mesh::N belong to.
+    enum class Normal_kind
+    {
+        face,
+        vertex,
+    };
     struct Polygon_mesh
     {
         Eigen::MatrixXd V;
         Eigen::MatrixXi F;
+        // Unit normals, one row per face or per vertex as normal_kind says; may be empty.
         Eigen::MatrixXd N;
+        // Absent means per face, which is what the readers produce.
+        std::optional<Normal_kind> normal_kind;
     };
+    // Whether N holds one normal per vertex of mesh.
+    inline bool has_vertex_normals(const Polygon_mesh &mesh)
+    {
+        return mesh.normal_kind == Normal_kind::vertex && mesh.N.rows() == mesh.V.rows() && mesh.N.rows() > 0 && mesh.N.cols() == 3;
+    }
+    // Whether N holds one normal per face of mesh.
+    inline bool has_face_normals(const Polygon_mesh &mesh)
+    {
+        return mesh.normal_kind.value_or(Normal_kind::face) == Normal_kind::face && mesh.N.rows() == mesh.F.rows() && mesh.N.rows() > 0 && mesh.N.cols() == 3;
+    }
+    // The kind of normals mesh holds, or none if N is empty or does not fit its kind.
+    inline std::optional<Normal_kind> valid_normal_kind(const Polygon_mesh &mesh)
+    {
+        if (has_vertex_normals(mesh))
+        {
+            return Normal_kind::vertex;
+        }
+        if (has_face_normals(mesh))
+        {
+            return Normal_kind::face;
+        }
+        return std::nullopt;
+    }
+    // Partition of the faces of a Polygon_mesh into clusters (see Clustering.hpp).
     struct Polygon_clusters
     {
+        // Cluster of every face, in [0, number of clusters).
+        Eigen::VectorXi face_clusters;
+        // The faces of cluster c are faces[offsets[c], offsets[c + 1]), ascending.
+        Eigen::VectorXi offsets;
+        Eigen::VectorXi faces;
+        // Per cluster: total area, area-weighted centroid, area-weighted mean of the face normals
+        // (normalized; zero if they cancel out) and bounds (min x, y, z, max x, y, z).
+        Eigen::VectorXd areas;
+        Eigen::MatrixXd centroids;
+        Eigen::MatrixXd normals;
+        Eigen::MatrixXd bounds;
+    };
+    // One part of a Polygon_mesh split by partitionMesh (see Partition.hpp), as a standalone submesh.
+    struct Mesh_partition
+    {
+        Polygon_mesh mesh;
+        // Index in the source mesh of every face and vertex of mesh.
+        Eigen::VectorXi face_ids;
+        Eigen::VectorXi vertex_ids;
+        // Local indices of the vertices this part shares with other parts, ascending.
+        Eigen::VectorXi boundary_vertices;
     };
+    // Occupancy of a regular grid of cubic voxels (see Voxelization.hpp), stored sparsely in bricks
+    // of 8 x 8 x 8 voxels. Voxel (i, j, k) spans origin + voxel_size * ([i, i + 1] x [j, j + 1] x [k, k + 1]).
+    struct Voxel_grid
+    {
+        Eigen::RowVector3d origin = Eigen::RowVector3d::Zero();
+        double voxel_size = 0.0;
+        // Voxels along x, y and z.
+        Eigen::RowVector3i dimensions = Eigen::RowVector3i::Zero();
+        // Bricks with some but not all voxels occupied, one row per brick (x, y, z in bricks),
+        // sorted. Voxel (8 x + i, 8 y + j, 8 z + k) is bit i + 8 j of word k in the same row of
+        // brick_bits.
+        Eigen::MatrixXi bricks;
+        Eigen::Matrix<uint64_t, Eigen::Dynamic, Eigen::Dynamic> brick_bits;
+        // Bricks with all 512 voxels occupied, sorted.
+        Eigen::MatrixXi full_bricks;
+    };
+    // Points stored attribute by attribute, one row per point. normals and colors are either empty
+    // (the attribute is absent) or have as many rows as positions.
     struct Point_cloud
     {
+        Eigen::MatrixXd positions;
+        Eigen::MatrixXd normals;
+        // RGB in [0, 1].
+        Eigen::MatrixXd colors;
+    };
+    // Handle to a mesh file that is read chunk by chunk instead of being loaded whole
+    // (see MeshStream.hpp). Only the description travels through results, never the data.
+    struct Mesh_stream
+    {
+        std::string filepath;
+        // "stl_binary" or "stl_ascii"
+        std::string format;
+        // Number of triangles, or 0 if it is only known after a full pass (ASCII).
+        uint64_t triangle_count = 0;
+        // Triangles per chunk handed to consumers; bounds their peak memory.
+        uint64_t chunk_triangles = 0;
+    };
+    // Bounding volume hierarchy over the triangles of a Polygon_mesh (see Bvh.hpp), flattened in
+    // depth-first order. It carries its own copy of the triangles, so queries need only this result.
+    struct Mesh_bvh
+    {
+        // One row per node: min x, y, z, max x, y, z.
+        Eigen::MatrixXd node_bounds;
+        // One row per node: offset, count, split axis. A leaf (count > 0) holds the triangles
+        // [offset, offset + count); an interior node (count == 0) is followed by its first child,
+        // and offset is the index of its second child.
+        Eigen::MatrixXi node_links;
+        // One row per triangle in leaf order: corner positions a, b, c (9 columns).
+        Eigen::MatrixXd triangles;
+        // Face index in the source mesh of every triangle, in leaf order.
+        Eigen::VectorXi face_ids;
+        // Fingerprint of the contents when built. The query cache recomputes it from the arrays
+        // instead of trusting this field, so an edited result cannot alias a cached structure.
+        uint64_t key = 0;
+    };
+    // KD-tree over 3D points (see KdTree.hpp), flattened in depth-first order like Mesh_bvh. It
+    // carries its own copy of the points, so queries need only this result.
+    struct Point_kd_tree
+    {
+        // One row per node: min x, y, z, max x, y, z of the points below it.
+        Eigen::MatrixXd node_bounds;
+        // One row per node: offset, count, split axis, with the same layout as Mesh_bvh::node_links.
+        Eigen::MatrixXi node_links;
+        // One row per point in leaf order.
+        Eigen::MatrixXd points;
+        // Row in the source positions of every point, in leaf order.
+        Eigen::VectorXi point_ids;
+        // Fingerprint of the contents when built; see Mesh_bvh::key.
+        uint64_t key = 0;
     };
 } // namespace MITSU_Domoe
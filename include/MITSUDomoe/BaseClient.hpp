@@ -3,8 +3,12 @@
 #include "IClient.hpp"
 #include "CommandProcessor.hpp"
 #include "ResultRepository.hpp"
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <filesystem>
+#include <string>
+#include <vector>
 
 namespace MITSU_Domoe
 {
@@ -18,8 +22,51 @@ public:
     void run() override = 0;
 
 public:
+    // Progress of a load_logs()/trace_logs() call. Safe to poll from another thread.
+    struct LogLoadProgress
+    {
+        std::atomic<size_t> total{0};
+        std::atomic<size_t> completed{0};
+    };
+
+    struct LoadedLog
+    {
+        std::filesystem::path path;
+        std::string pretty_json;
+    };
+
     void load_result(const std::string& json_content);
 
+    // Reads and parses a log file or every *.json in a directory on the shared thread pool,
+    // then stores the results in ID order. Returns the pretty-printed logs in the same order.
+    std::vector<LoadedLog> load_logs(const std::filesystem::path& path, LogLoadProgress* progress = nullptr);
+
+    struct TraceReport
+    {
+        size_t posted = 0;
+        size_t workers = 0;
+        std::chrono::duration<double> wall_time{0};
+        // Sum of the run times of all replayed commands.
+        std::chrono::duration<double> total_command_time{0};
+        // Longest chain of dependent commands, by run time, and its new command IDs.
+        std::chrono::duration<double> critical_path_time{0};
+        std::vector<uint64_t> critical_path;
+
+        std::string to_string() const;
+    };
+
+    // Re-posts the request of a log file or of every *.json in a directory and waits for the replay to finish.
+    // Files are read and parsed in parallel. Commands are posted in filename order, and ones that do
+    // not depend on each other run concurrently; the results match a serial replay.
+    // With reuse_cached, commands whose resolved input matches an existing result are not re-run,
+    // which turns the trace into an incremental rebuild.
+    TraceReport trace_logs(const std::filesystem::path& path, LogLoadProgress* progress = nullptr, bool reuse_cached = false);
+
+    // Dumps every result, its schema and the command ID counter into one binary file.
+    bool save_snapshot(const std::filesystem::path& path);
+    // Restores a snapshot written by save_snapshot. New commands continue after the saved IDs.
+    bool restore_snapshot(const std::filesystem::path& path);
+
 protected:
     uint64_t post_command(const std::string& command_name, const std::string& json_input) override;
     std::optional<CommandResult> get_result(uint64_t command_id) override;
@@ -27,6 +74,11 @@ protected:
     std::vector<std::string> get_command_names() override;
     std::map<std::string, std::string> get_input_schema(const std::string& command_name) override;
 
+    // Client-specific state stored alongside the results in a snapshot. On restore the attachments
+    // are handed back before the results are stored.
+    virtual std::map<std::string, std::string> get_snapshot_attachments() { return {}; }
+    virtual void restore_snapshot_attachments(const std::map<std::string, std::string>& attachments) {}
+
     std::shared_ptr<ResultRepository> result_repo;
     std::unique_ptr<CommandProcessor> processor;
 };
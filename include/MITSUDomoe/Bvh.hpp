@@ -0,0 +1,702 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Geometry.hpp"
+#include "Hash.hpp"
+#include "PackedCache.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace bvh_detail
+    {
+        constexpr int NUM_BINS = 16;
+        // Ranges larger than this are binned and split on several threads.
+        constexpr size_t PARALLEL_RANGE = 1 << 15;
+        // Leaves are forced to split beyond this size even when SAH prefers a leaf.
+        constexpr size_t MAX_LEAF_SIZE = 16;
+        constexpr double TRAVERSAL_COST = 1.0;
+
+        // One node per 64-byte cache line: both bounds and the links are read together on every visit.
+        struct alignas(64) Node
+        {
+            double min[3];
+            uint32_t offset;
+            uint32_t count;
+            double max[3];
+            uint32_t axis;
+        };
+        static_assert(sizeof(Node) == 64);
+
+        struct Box
+        {
+            Eigen::Vector3d min = Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity());
+            Eigen::Vector3d max = Eigen::Vector3d::Constant(-std::numeric_limits<double>::infinity());
+
+            void extend(const Box &other)
+            {
+                min = min.cwiseMin(other.min);
+                max = max.cwiseMax(other.max);
+            }
+
+            void extend(const Eigen::Vector3d &p)
+            {
+                min = min.cwiseMin(p);
+                max = max.cwiseMax(p);
+            }
+
+            double half_area() const
+            {
+                const Eigen::Vector3d d = (max - min).cwiseMax(0.0);
+                return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+            }
+        };
+
+        class Builder
+        {
+        public:
+            Builder(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, size_t leaf_size)
+                : leaf_size_(std::clamp<size_t>(leaf_size, 1, MAX_LEAF_SIZE)), primitives_(F.rows())
+            {
+                parallel_for(0, static_cast<size_t>(F.rows()), [&](size_t begin, size_t end)
+                             {
+                    for (size_t f = begin; f < end; ++f)
+                    {
+                        Box box;
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            box.extend(Eigen::Vector3d(V.row(F(f, k)).transpose()));
+                        }
+                        primitives_[f] = Primitive{box, static_cast<uint32_t>(f)};
+                    } });
+            }
+
+            // Nodes of the whole tree in depth-first order. Afterwards face(i) is the i-th triangle in leaf order.
+            std::vector<Node> build()
+            {
+                std::vector<Node> nodes;
+                if (primitives_.empty())
+                {
+                    return nodes;
+                }
+                const Range root = measure(0, primitives_.size());
+                const Subtree tree = build_subtree(root);
+                nodes.resize(tree.size);
+                flatten(tree, nodes.data(), 0);
+                return nodes;
+            }
+
+            uint32_t face(size_t i) const { return primitives_[i].face; }
+
+        private:
+            // The centroid of the box stands in for the triangle. It is recomputed when needed rather
+            // than stored, since every build pass streams over all primitives.
+            struct Primitive
+            {
+                Box box;
+                uint32_t face;
+
+                Eigen::Vector3d centroid() const { return 0.5 * (box.min + box.max); }
+                double centroid(int axis) const { return 0.5 * (box.min(axis) + box.max(axis)); }
+            };
+
+            // A range of primitives with the bounds of their boxes and of their centroids.
+            struct Range
+            {
+                size_t begin;
+                size_t end;
+                Box bounds;
+                Box centroid_bounds;
+            };
+
+            // Centroid bounds are tracked per bin so that both children of a split know their ranges'
+            // bounds without another pass over the primitives.
+            struct Bins
+            {
+                Box bounds[NUM_BINS];
+                Box centroid_bounds[NUM_BINS];
+                size_t counts[NUM_BINS] = {};
+
+                void merge(const Bins &other)
+                {
+                    for (int b = 0; b < NUM_BINS; ++b)
+                    {
+                        bounds[b].extend(other.bounds[b]);
+                        centroid_bounds[b].extend(other.centroid_bounds[b]);
+                        counts[b] += other.counts[b];
+                    }
+                }
+            };
+
+            // The top of the tree is built as a tree of separately built parts, which are copied into
+            // the final depth-first array once at the end.
+            struct Subtree
+            {
+                Node root;
+                std::unique_ptr<Subtree> children[2];
+                std::vector<Node> nodes; // a part built serially, with indices relative to its first node
+                size_t size = 0;
+            };
+
+            Subtree build_subtree(const Range &range)
+            {
+                Subtree tree;
+                if (range.end - range.begin <= PARALLEL_RANGE)
+                {
+                    build_into(tree.nodes, range);
+                    tree.size = tree.nodes.size();
+                    return tree;
+                }
+
+                Range children[2];
+                if (!split_range(tree.root, range, children))
+                {
+                    tree.size = 1;
+                    return tree;
+                }
+                parallel_for(0, 2, [&](size_t first, size_t last)
+                             {
+                    for (size_t child = first; child < last; ++child)
+                    {
+                        tree.children[child] = std::make_unique<Subtree>(build_subtree(children[child]));
+                    } }, 1);
+                tree.size = 1 + tree.children[0]->size + tree.children[1]->size;
+                return tree;
+            }
+
+            static void flatten(const Subtree &tree, Node *out, uint32_t base)
+            {
+                if (!tree.children[0])
+                {
+                    if (tree.nodes.empty())
+                    {
+                        out[base] = tree.root;
+                        return;
+                    }
+                    for (size_t i = 0; i < tree.nodes.size(); ++i)
+                    {
+                        Node node = tree.nodes[i];
+                        if (node.count == 0)
+                        {
+                            node.offset += base;
+                        }
+                        out[base + i] = node;
+                    }
+                    return;
+                }
+                out[base] = tree.root;
+                out[base].offset = base + 1 + static_cast<uint32_t>(tree.children[0]->size);
+                flatten(*tree.children[0], out, base + 1);
+                flatten(*tree.children[1], out, out[base].offset);
+            }
+
+            void build_into(std::vector<Node> &nodes, const Range &range)
+            {
+                const size_t index = nodes.size();
+                nodes.emplace_back();
+                Node node;
+                Range children[2];
+                const bool split = split_range(node, range, children);
+                nodes[index] = node;
+                if (!split)
+                {
+                    return;
+                }
+                build_into(nodes, children[0]);
+                nodes[index].offset = static_cast<uint32_t>(nodes.size());
+                build_into(nodes, children[1]);
+            }
+
+            Range measure(size_t begin, size_t end) const
+            {
+                Range range{begin, end, Box(), Box()};
+                accumulate(begin, end, [&](size_t first, size_t last, Box &bounds, Box &centroid_bounds)
+                           {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        bounds.extend(primitives_[i].box);
+                        centroid_bounds.extend(primitives_[i].centroid());
+                    } }, range.bounds, range.centroid_bounds);
+                return range;
+            }
+
+            // Fills in node for range. Returns false for a leaf; otherwise partitions the range and
+            // describes the two halves in children.
+            bool split_range(Node &node, const Range &range, Range children[2])
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    node.min[k] = range.bounds.min(k);
+                    node.max[k] = range.bounds.max(k);
+                }
+                const size_t count = range.end - range.begin;
+                node.offset = static_cast<uint32_t>(range.begin);
+                node.count = static_cast<uint32_t>(count);
+                node.axis = 0;
+                if (count <= leaf_size_)
+                {
+                    return false;
+                }
+
+                int axis;
+                const double extent = (range.centroid_bounds.max - range.centroid_bounds.min).maxCoeff(&axis);
+                if (!(extent > 0.0))
+                {
+                    // All centroids coincide: binning cannot separate them, so halve the range by index.
+                    if (count <= MAX_LEAF_SIZE)
+                    {
+                        return false;
+                    }
+                    const size_t middle = range.begin + count / 2;
+                    children[0] = measure(range.begin, middle);
+                    children[1] = measure(middle, range.end);
+                    node.offset = 0;
+                    node.count = 0;
+                    return true;
+                }
+
+                // Binned SAH along the axis with the largest centroid extent.
+                const double lo = range.centroid_bounds.min(axis);
+                const double scale = NUM_BINS / extent;
+                Bins bins;
+                accumulate(range.begin, range.end, [&](size_t first, size_t last, Bins &local)
+                           {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        const int b = bin_of(primitives_[i].centroid(axis), lo, scale);
+                        local.bounds[b].extend(primitives_[i].box);
+                        local.centroid_bounds[b].extend(primitives_[i].centroid());
+                        ++local.counts[b];
+                    } }, bins);
+
+                // Sweep from the right to get the cost of every right-hand side.
+                double right_cost[NUM_BINS];
+                Box right;
+                size_t right_count = 0;
+                for (int b = NUM_BINS - 1; b > 0; --b)
+                {
+                    right.extend(bins.bounds[b]);
+                    right_count += bins.counts[b];
+                    right_cost[b] = right.half_area() * static_cast<double>(right_count);
+                }
+                int best_bin = -1;
+                double best_cost = std::numeric_limits<double>::infinity();
+                const double inverse_area = 1.0 / std::max(range.bounds.half_area(), std::numeric_limits<double>::min());
+                Box left;
+                size_t left_count = 0;
+                for (int b = 0; b < NUM_BINS - 1; ++b)
+                {
+                    left.extend(bins.bounds[b]);
+                    left_count += bins.counts[b];
+                    if (left_count == 0 || left_count == count)
+                    {
+                        continue;
+                    }
+                    const double cost = TRAVERSAL_COST + (left.half_area() * static_cast<double>(left_count) + right_cost[b + 1]) * inverse_area;
+                    if (cost < best_cost)
+                    {
+                        best_bin = b;
+                        best_cost = cost;
+                    }
+                }
+                if (best_cost >= static_cast<double>(count) && count <= MAX_LEAF_SIZE)
+                {
+                    return false;
+                }
+
+                const auto middle = std::partition(primitives_.begin() + range.begin, primitives_.begin() + range.end, [&](const Primitive &primitive)
+                                                   { return bin_of(primitive.centroid(axis), lo, scale) <= best_bin; });
+                const size_t split = static_cast<size_t>(middle - primitives_.begin());
+                children[0] = Range{range.begin, split, Box(), Box()};
+                children[1] = Range{split, range.end, Box(), Box()};
+                for (int b = 0; b < NUM_BINS; ++b)
+                {
+                    Range &child = children[b <= best_bin ? 0 : 1];
+                    child.bounds.extend(bins.bounds[b]);
+                    child.centroid_bounds.extend(bins.centroid_bounds[b]);
+                }
+                node.offset = 0;
+                node.count = 0;
+                node.axis = static_cast<uint32_t>(axis);
+                return true;
+            }
+
+            static int bin_of(double value, double lo, double scale)
+            {
+                return std::clamp(static_cast<int>((value - lo) * scale), 0, NUM_BINS - 1);
+            }
+
+            // Runs fn(first, last, partials...) over [begin, end) and merges the partial results into
+            // results. Large ranges are split across the pool; the merge is exact (min, max, counts),
+            // so the result does not depend on the order in which chunks finish.
+            template <typename Fn, typename... Partials>
+            static void accumulate(size_t begin, size_t end, Fn &&fn, Partials &...results)
+            {
+                if (end - begin <= PARALLEL_RANGE)
+                {
+                    fn(begin, end, results...);
+                    return;
+                }
+                std::mutex mutex;
+                parallel_for(begin, end, [&](size_t first, size_t last)
+                             {
+                    std::tuple<Partials...> local;
+                    std::apply([&](auto &...partials)
+                               { fn(first, last, partials...); }, local);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::apply([&](auto &...partials)
+                               { (merge(results, partials), ...); }, local);
+                }, PARALLEL_RANGE / 4);
+            }
+
+            static void merge(Box &into, const Box &from) { into.extend(from); }
+            static void merge(Bins &into, const Bins &from) { into.merge(from); }
+
+            size_t leaf_size_;
+            // Kept in leaf order as the ranges are partitioned, so every pass over a range reads contiguous memory.
+            std::vector<Primitive> primitives_;
+        };
+
+        inline uint64_t fingerprint(const Mesh_bvh &bvh)
+        {
+            uint64_t h = hash_bytes(bvh.node_bounds.data(), sizeof(double) * bvh.node_bounds.size(), 1);
+            h = hash_bytes(bvh.node_links.data(), sizeof(int) * bvh.node_links.size(), h);
+            h = hash_bytes(bvh.triangles.data(), sizeof(double) * bvh.triangles.size(), h);
+            return hash_bytes(bvh.face_ids.data(), sizeof(int) * bvh.face_ids.size(), h);
+        }
+    } // namespace bvh_detail
+
+    // In-memory form of a Mesh_bvh used by the queries: cache-line nodes and contiguous triangles.
+    class PackedBvh
+    {
+    public:
+        struct Triangle
+        {
+            Eigen::Vector3d a, b, c;
+        };
+
+        struct NearestHit
+        {
+            int face = -1;
+            Eigen::Vector3d point = Eigen::Vector3d::Zero();
+            double squared_distance = std::numeric_limits<double>::infinity();
+        };
+
+        struct RayHit
+        {
+            int face = -1;
+            double distance = std::numeric_limits<double>::infinity();
+        };
+
+        // Content hash of the arrays of bvh, recomputed rather than read from bvh.key.
+        static uint64_t fingerprint(const Mesh_bvh &bvh) { return bvh_detail::fingerprint(bvh); }
+
+        // Throws std::invalid_argument if the arrays of bvh are inconsistent.
+        explicit PackedBvh(const Mesh_bvh &bvh)
+            : PackedBvh(bvh, fingerprint(bvh)) {}
+
+        // key must be fingerprint(bvh).
+        PackedBvh(const Mesh_bvh &bvh, uint64_t key)
+            : key_(key)
+        {
+            const Eigen::Index num_nodes = bvh.node_bounds.rows();
+            const Eigen::Index num_triangles = bvh.triangles.rows();
+            if (bvh.node_links.rows() != num_nodes || (num_nodes > 0 && (bvh.node_bounds.cols() != 6 || bvh.node_links.cols() != 3)) ||
+                (num_triangles > 0 && bvh.triangles.cols() != 9) || bvh.face_ids.size() != num_triangles)
+            {
+                throw std::invalid_argument("Inconsistent BVH arrays.");
+            }
+
+            nodes_.resize(num_nodes);
+            std::vector<char> valid(num_nodes, 1);
+            parallel_for(0, static_cast<size_t>(num_nodes), [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    bvh_detail::Node &node = nodes_[i];
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        node.min[k] = bvh.node_bounds(i, k);
+                        node.max[k] = bvh.node_bounds(i, 3 + k);
+                    }
+                    const int offset = bvh.node_links(i, 0);
+                    const int count = bvh.node_links(i, 1);
+                    node.offset = static_cast<uint32_t>(offset);
+                    node.count = static_cast<uint32_t>(count);
+                    node.axis = static_cast<uint32_t>(std::clamp(bvh.node_links(i, 2), 0, 2));
+                    // Children must come after their parent, which also rules out cycles.
+                    valid[i] = offset >= 0 && count >= 0 &&
+                               (count > 0 ? static_cast<Eigen::Index>(offset) + count <= num_triangles
+                                          : static_cast<Eigen::Index>(i) + 1 < num_nodes && offset > static_cast<int>(i) + 1 && offset < num_nodes);
+                } });
+            if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+            {
+                throw std::invalid_argument("BVH node links are out of range.");
+            }
+
+            triangles_.resize(num_triangles);
+            face_ids_.assign(bvh.face_ids.data(), bvh.face_ids.data() + num_triangles);
+            parallel_for(0, static_cast<size_t>(num_triangles), [&](size_t begin, size_t end)
+                         {
+                for (size_t t = begin; t < end; ++t)
+                {
+                    triangles_[t].a = bvh.triangles.block<1, 3>(t, 0).transpose();
+                    triangles_[t].b = bvh.triangles.block<1, 3>(t, 3).transpose();
+                    triangles_[t].c = bvh.triangles.block<1, 3>(t, 6).transpose();
+                } });
+        }
+
+        NearestHit nearest(const Eigen::Vector3d &p, std::vector<uint32_t> &stack) const
+        {
+            NearestHit best;
+            if (nodes_.empty())
+            {
+                return best;
+            }
+            stack.assign(1, 0);
+            while (!stack.empty())
+            {
+                const bvh_detail::Node &node = nodes_[stack.back()];
+                const uint32_t index = stack.back();
+                stack.pop_back();
+                if (box_squared_distance(p, node) >= best.squared_distance)
+                {
+                    continue;
+                }
+                if (node.count > 0)
+                {
+                    for (uint32_t t = node.offset; t < node.offset + node.count; ++t)
+                    {
+                        const Eigen::Vector3d q = closest_point_on_triangle(p, triangles_[t].a, triangles_[t].b, triangles_[t].c);
+                        const double d = (q - p).squaredNorm();
+                        if (d < best.squared_distance)
+                        {
+                            best = NearestHit{face_ids_[t], q, d};
+                        }
+                    }
+                    continue;
+                }
+                // Push the farther child first so that the nearer one is searched first.
+                uint32_t first = index + 1;
+                uint32_t second = node.offset;
+                double first_distance = box_squared_distance(p, nodes_[first]);
+                double second_distance = box_squared_distance(p, nodes_[second]);
+                if (second_distance < first_distance)
+                {
+                    std::swap(first, second);
+                    std::swap(first_distance, second_distance);
+                }
+                if (second_distance < best.squared_distance)
+                {
+                    stack.push_back(second);
+                }
+                if (first_distance < best.squared_distance)
+                {
+                    stack.push_back(first);
+                }
+            }
+            return best;
+        }
+
+        RayHit raycast(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, std::vector<uint32_t> &stack) const
+        {
+            RayHit best;
+            if (nodes_.empty())
+            {
+                return best;
+            }
+            const Eigen::Vector3d inverse_direction = direction.cwiseInverse();
+            stack.assign(1, 0);
+            while (!stack.empty())
+            {
+                const uint32_t index = stack.back();
+                const bvh_detail::Node &node = nodes_[index];
+                stack.pop_back();
+                if (ray_box_distance(origin, inverse_direction, min_of(node), max_of(node), best.distance) == std::numeric_limits<double>::infinity())
+                {
+                    continue;
+                }
+                if (node.count > 0)
+                {
+                    for (uint32_t t = node.offset; t < node.offset + node.count; ++t)
+                    {
+                        const double d = ray_triangle_distance(origin, direction, triangles_[t].a, triangles_[t].b, triangles_[t].c, 0.0, best.distance);
+                        if (d < best.distance)
+                        {
+                            best = RayHit{face_ids_[t], d};
+                        }
+                    }
+                    continue;
+                }
+                // Visit the child on the near side of the split axis first.
+                const bool backwards = direction(node.axis) < 0.0;
+                stack.push_back(backwards ? index + 1 : node.offset);
+                stack.push_back(backwards ? node.offset : index + 1);
+            }
+            return best;
+        }
+
+        // Appends the face ids of the triangles that intersect the box [box_min, box_max], ascending.
+        void overlap(const Eigen::Vector3d &box_min, const Eigen::Vector3d &box_max, std::vector<int> &faces, std::vector<uint32_t> &stack) const
+        {
+            if (nodes_.empty())
+            {
+                return;
+            }
+            const size_t first_result = faces.size();
+            const Eigen::Vector3d center = 0.5 * (box_min + box_max);
+            const Eigen::Vector3d half_extent = 0.5 * (box_max - box_min);
+            stack.assign(1, 0);
+            while (!stack.empty())
+            {
+                const uint32_t index = stack.back();
+                const bvh_detail::Node &node = nodes_[index];
+                stack.pop_back();
+                if ((min_of(node).array() > box_max.array()).any() || (max_of(node).array() < box_min.array()).any())
+                {
+                    continue;
+                }
+                if (node.count > 0)
+                {
+                    for (uint32_t t = node.offset; t < node.offset + node.count; ++t)
+                    {
+                        if (triangle_box_overlap(center, half_extent, triangles_[t].a, triangles_[t].b, triangles_[t].c))
+                        {
+                            faces.push_back(face_ids_[t]);
+                        }
+                    }
+                    continue;
+                }
+                stack.push_back(node.offset);
+                stack.push_back(index + 1);
+            }
+            std::sort(faces.begin() + first_result, faces.end());
+        }
+
+        uint64_t key() const { return key_; }
+
+        // Whether this was packed from bvh, given its fingerprint.
+        bool matches(const Mesh_bvh &bvh, uint64_t key) const
+        {
+            return key_ == key && nodes_.size() == static_cast<size_t>(bvh.node_bounds.rows()) &&
+                   triangles_.size() == static_cast<size_t>(bvh.triangles.rows());
+        }
+
+        size_t memory_usage() const
+        {
+            return sizeof(bvh_detail::Node) * nodes_.capacity() + sizeof(Triangle) * triangles_.capacity() + sizeof(int) * face_ids_.capacity();
+        }
+
+        size_t node_count() const { return nodes_.size(); }
+        size_t triangle_count() const { return triangles_.size(); }
+
+        size_t depth() const
+        {
+            size_t max_depth = 0;
+            std::vector<std::pair<uint32_t, size_t>> stack;
+            if (!nodes_.empty())
+            {
+                stack.emplace_back(0, 1);
+            }
+            while (!stack.empty())
+            {
+                const auto [index, depth] = stack.back();
+                stack.pop_back();
+                max_depth = std::max(max_depth, depth);
+                if (nodes_[index].count == 0)
+                {
+                    stack.emplace_back(index + 1, depth + 1);
+                    stack.emplace_back(nodes_[index].offset, depth + 1);
+                }
+            }
+            return max_depth;
+        }
+
+    private:
+        static Eigen::Vector3d min_of(const bvh_detail::Node &node) { return Eigen::Vector3d(node.min[0], node.min[1], node.min[2]); }
+        static Eigen::Vector3d max_of(const bvh_detail::Node &node) { return Eigen::Vector3d(node.max[0], node.max[1], node.max[2]); }
+
+        static double box_squared_distance(const Eigen::Vector3d &p, const bvh_detail::Node &node)
+        {
+            return point_box_squared_distance(p, min_of(node), max_of(node));
+        }
+
+        std::vector<bvh_detail::Node> nodes_;
+        std::vector<Triangle> triangles_;
+        std::vector<int> face_ids_;
+        uint64_t key_;
+    };
+
+    // Builds a BVH over the triangles of (V, F) with binned SAH (16 bins along the widest centroid axis). Large ranges
+    // are binned in parallel and their subtrees are built concurrently; the result is independent of
+    // the number of threads. leaf_size is the size below which ranges are not split further.
+    // Throws std::invalid_argument for non-triangle meshes or out-of-range indices.
+    inline Mesh_bvh build_bvh(const Polygon_mesh &mesh, size_t leaf_size = 4)
+    {
+        if (mesh.F.rows() > 0 && (mesh.F.cols() != 3 || mesh.V.cols() != 3))
+        {
+            throw std::invalid_argument("A BVH can only be built over a triangle mesh with 3D vertices.");
+        }
+        if (mesh.F.size() > 0 && (mesh.F.minCoeff() < 0 || mesh.F.maxCoeff() >= mesh.V.rows()))
+        {
+            throw std::invalid_argument("Face index out of range.");
+        }
+
+        bvh_detail::Builder builder(mesh.V, mesh.F, leaf_size);
+        const std::vector<bvh_detail::Node> nodes = builder.build();
+
+        Mesh_bvh bvh;
+        bvh.node_bounds.resize(nodes.size(), 6);
+        bvh.node_links.resize(nodes.size(), 3);
+        parallel_for(0, nodes.size(), [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                bvh.node_bounds.row(i) << nodes[i].min[0], nodes[i].min[1], nodes[i].min[2], nodes[i].max[0], nodes[i].max[1], nodes[i].max[2];
+                bvh.node_links.row(i) << static_cast<int>(nodes[i].offset), static_cast<int>(nodes[i].count), static_cast<int>(nodes[i].axis);
+            } });
+        bvh.triangles.resize(mesh.F.rows(), 9);
+        bvh.face_ids.resize(mesh.F.rows());
+        parallel_for(0, static_cast<size_t>(mesh.F.rows()), [&](size_t begin, size_t end)
+                     {
+            for (size_t t = begin; t < end; ++t)
+            {
+                const uint32_t f = builder.face(t);
+                for (int k = 0; k < 3; ++k)
+                {
+                    bvh.triangles.block<1, 3>(t, 3 * k) = mesh.V.row(mesh.F(f, k));
+                }
+                bvh.face_ids(t) = static_cast<int>(f);
+            } });
+        bvh.key = bvh_detail::fingerprint(bvh);
+        return bvh;
+    }
+
+    using PackedBvhCache = PackedCache<PackedBvh>;
+
+    // Runs query(i, stack) for i in [0, count) on the shared pool, with one traversal stack per chunk.
+    template <typename QueryFn>
+    void for_each_bvh_query(size_t count, QueryFn &&query)
+    {
+        parallel_for(0, count, [&](size_t begin, size_t end)
+                     {
+            std::vector<uint32_t> stack;
+            stack.reserve(64);
+            for (size_t i = begin; i < end; ++i)
+            {
+                query(i, stack);
+            } }, 256);
+    }
+
+} // namespace MITSU_Domoe
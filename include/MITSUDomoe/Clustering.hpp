@@ -0,0 +1,361 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "DerivedData.hpp"
+#include "KdTree.hpp"
+#include "MeshTopology.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace cluster_detail
+    {
+        // Sums are reduced over fixed blocks of faces, so results do not depend on the number of threads.
+        constexpr size_t MIN_BLOCK_SIZE = 1 << 16;
+
+        inline void check_triangle_mesh(const Polygon_mesh &mesh)
+        {
+            if (mesh.F.rows() > 0 && (mesh.F.cols() != 3 || mesh.V.cols() != 3))
+            {
+                throw std::invalid_argument("Expected a triangle mesh with 3D vertices.");
+            }
+            if (mesh.F.size() > 0 && (mesh.F.minCoeff() < 0 || mesh.F.maxCoeff() >= mesh.V.rows()))
+            {
+                throw std::invalid_argument("Face index out of range.");
+            }
+        }
+
+        // Concurrent union-find. Roots are linked from the larger to the smaller index with a CAS,
+        // so the root of every set ends up being its smallest element whatever the order of unions.
+        class UnionFind
+        {
+        public:
+            explicit UnionFind(size_t size) : parent_(size)
+            {
+                parallel_for(0, size, [&](size_t begin, size_t end)
+                             {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        parent_[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+                    } });
+            }
+
+            uint32_t find(uint32_t x)
+            {
+                while (true)
+                {
+                    uint32_t parent = parent_[x].load();
+                    if (parent == x)
+                    {
+                        return x;
+                    }
+                    // Path halving; losing the race only skips the shortcut.
+                    const uint32_t grandparent = parent_[parent].load();
+                    parent_[x].compare_exchange_weak(parent, grandparent);
+                    x = grandparent;
+                }
+            }
+
+            void unite(uint32_t a, uint32_t b)
+            {
+                while (true)
+                {
+                    a = find(a);
+                    b = find(b);
+                    if (a == b)
+                    {
+                        return;
+                    }
+                    if (a < b)
+                    {
+                        std::swap(a, b);
+                    }
+                    uint32_t expected = a;
+                    if (parent_[a].compare_exchange_strong(expected, b))
+                    {
+                        return;
+                    }
+                }
+            }
+
+        private:
+            std::vector<std::atomic<uint32_t>> parent_;
+        };
+
+        // make_polygon_clusters without the argument checks, for callers that already have the geometry.
+        inline Polygon_clusters build_clusters(const Polygon_mesh &mesh, const FaceGeometry &geometry, Eigen::VectorXi face_clusters, int num_clusters)
+        {
+            const Eigen::Index num_faces = mesh.F.rows();
+            Polygon_clusters clusters;
+            // Counting sort by cluster; filling in face order keeps every list ascending.
+            clusters.offsets = Eigen::VectorXi::Zero(num_clusters + 1);
+            for (Eigen::Index f = 0; f < num_faces; ++f)
+            {
+                ++clusters.offsets(face_clusters(f) + 1);
+            }
+            for (int c = 0; c < num_clusters; ++c)
+            {
+                clusters.offsets(c + 1) += clusters.offsets(c);
+            }
+            clusters.faces.resize(num_faces);
+            {
+                std::vector<int> cursor(clusters.offsets.data(), clusters.offsets.data() + num_clusters);
+                for (Eigen::Index f = 0; f < num_faces; ++f)
+                {
+                    clusters.faces(cursor[face_clusters(f)]++) = static_cast<int>(f);
+                }
+            }
+
+            clusters.areas.resize(num_clusters);
+            clusters.centroids.resize(num_clusters, 3);
+            clusters.normals.resize(num_clusters, 3);
+            clusters.bounds.resize(num_clusters, 6);
+            parallel_for(0, static_cast<size_t>(num_clusters), [&](size_t begin, size_t end)
+                         {
+                for (size_t c = begin; c < end; ++c)
+                {
+                    double area = 0.0;
+                    Eigen::RowVector3d centroid = Eigen::RowVector3d::Zero();
+                    Eigen::RowVector3d normal = Eigen::RowVector3d::Zero();
+                    Eigen::RowVector3d lo = Eigen::RowVector3d::Constant(std::numeric_limits<double>::infinity());
+                    Eigen::RowVector3d hi = -lo;
+                    for (int i = clusters.offsets(c); i < clusters.offsets(c + 1); ++i)
+                    {
+                        const int f = clusters.faces(i);
+                        area += geometry.areas(f);
+                        centroid += geometry.areas(f) * geometry.centroids.row(f);
+                        normal += geometry.areas(f) * geometry.normals.row(f);
+                        for (int j = 0; j < 3; ++j)
+                        {
+                            lo = lo.cwiseMin(mesh.V.row(mesh.F(f, j)));
+                            hi = hi.cwiseMax(mesh.V.row(mesh.F(f, j)));
+                        }
+                    }
+                    clusters.areas(c) = area;
+                    clusters.centroids.row(c) = area > 0.0 ? Eigen::RowVector3d(centroid / area) : centroid;
+                    clusters.normals.row(c) = normal.stableNormalized();
+                    clusters.bounds.row(c) << lo, hi;
+                } }, 64);
+
+            clusters.face_clusters = std::move(face_clusters);
+            return clusters;
+        }
+    } // namespace cluster_detail
+
+    // Builds the membership lists and statistics for the given per-face cluster ids, which must lie in
+    // [0, num_clusters). Empty clusters keep zero area, centroid and normal and inverted bounds.
+    inline Polygon_clusters make_polygon_clusters(const Polygon_mesh &mesh, Eigen::VectorXi face_clusters, int num_clusters)
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        if (face_clusters.size() != mesh.F.rows())
+        {
+            throw std::invalid_argument("face_clusters must have one entry per face.");
+        }
+        if (face_clusters.size() > 0 && (face_clusters.minCoeff() < 0 || face_clusters.maxCoeff() >= num_clusters))
+        {
+            throw std::invalid_argument("Cluster id out of range.");
+        }
+        return cluster_detail::build_clusters(mesh, *MeshDerivedData(mesh).face_geometry(), std::move(face_clusters), num_clusters);
+    }
+
+    struct KMeansClustering
+    {
+        Polygon_clusters clusters;
+        int iterations = 0;
+        bool converged = false;
+    };
+
+    // Lloyd's k-means on the face centroids, weighted by face area. The initial centers are faces
+    // evenly spaced along the Morton order of the centroids. Every iteration assigns the faces to
+    // their nearest center through a KD-tree over the centers, visiting them in Morton order, and then
+    // moves each center to the area-weighted mean of its faces. Iteration stops when no face changes
+    // cluster or after max_iterations. Clusters that end up empty are dropped, so there may be fewer
+    // than k. The result does not depend on the number of threads.
+    inline KMeansClustering cluster_faces_kmeans(const Polygon_mesh &mesh, int k, int max_iterations = 50)
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        if (k < 1 || max_iterations < 1)
+        {
+            throw std::invalid_argument("k and max_iterations must be at least 1.");
+        }
+        const size_t num_faces = static_cast<size_t>(mesh.F.rows());
+        KMeansClustering result;
+        if (num_faces == 0)
+        {
+            result.clusters = cluster_detail::build_clusters(mesh, FaceGeometry(), Eigen::VectorXi(), 0);
+            result.converged = true;
+            return result;
+        }
+
+        const std::shared_ptr<const FaceGeometry> geometry_data = MeshDerivedData(mesh).face_geometry();
+        const FaceGeometry &geometry = *geometry_data;
+        const std::vector<uint32_t> order = morton_order(geometry.centroids);
+        const size_t num_centers = std::min<size_t>(static_cast<size_t>(k), num_faces);
+        Eigen::MatrixXd centers(num_centers, 3);
+        for (size_t c = 0; c < num_centers; ++c)
+        {
+            centers.row(c) = geometry.centroids.row(order[(2 * c + 1) * num_faces / (2 * num_centers)]);
+        }
+
+        const size_t block_size = std::max(cluster_detail::MIN_BLOCK_SIZE, 16 * num_centers);
+        const size_t num_blocks = (num_faces + block_size - 1) / block_size;
+        // Per block and center: area-weighted centroid sum (x, y, z) and area.
+        std::vector<double> block_sums(num_blocks * num_centers * 4);
+        Eigen::VectorXi face_clusters = Eigen::VectorXi::Constant(num_faces, -1);
+
+        while (result.iterations < max_iterations)
+        {
+            ++result.iterations;
+            const PackedKdTree tree(build_kd_tree(centers));
+            std::atomic<size_t> changed{0};
+            parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                         {
+                std::vector<PackedKdTree::Neighbour> nearest;
+                std::vector<PackedKdTree::StackEntry> stack;
+                size_t local_changed = 0;
+                for (size_t j = begin; j < end; ++j)
+                {
+                    const uint32_t f = order[j];
+                    tree.knn(geometry.centroids.row(f).transpose(), 1, nearest, stack);
+                    if (face_clusters(f) != nearest[0].id)
+                    {
+                        face_clusters(f) = nearest[0].id;
+                        ++local_changed;
+                    }
+                }
+                changed += local_changed; }, 1024);
+            if (changed == 0)
+            {
+                result.converged = true;
+                break;
+            }
+
+            parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                         {
+                for (size_t b = begin; b < end; ++b)
+                {
+                    double *sums = block_sums.data() + b * num_centers * 4;
+                    std::fill(sums, sums + num_centers * 4, 0.0);
+                    for (size_t f = b * block_size; f < std::min(num_faces, (b + 1) * block_size); ++f)
+                    {
+                        double *sum = sums + 4 * face_clusters(f);
+                        const double area = geometry.areas(f);
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            sum[i] += area * geometry.centroids(f, i);
+                        }
+                        sum[3] += area;
+                    }
+                } }, 1);
+            parallel_for(0, num_centers, [&](size_t begin, size_t end)
+                         {
+                for (size_t c = begin; c < end; ++c)
+                {
+                    double sum[4] = {};
+                    for (size_t b = 0; b < num_blocks; ++b)
+                    {
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            sum[i] += block_sums[(b * num_centers + c) * 4 + i];
+                        }
+                    }
+                    // A center without area keeps its place.
+                    if (sum[3] > 0.0)
+                    {
+                        centers.row(c) << sum[0] / sum[3], sum[1] / sum[3], sum[2] / sum[3];
+                    }
+                } });
+        }
+
+        // Drop empty clusters, keeping the others in order.
+        std::vector<int> remap(num_centers, 0);
+        for (Eigen::Index f = 0; f < face_clusters.size(); ++f)
+        {
+            remap[face_clusters(f)] = 1;
+        }
+        int num_clusters = 0;
+        for (int &id : remap)
+        {
+            id = id ? num_clusters++ : -1;
+        }
+        parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                     {
+            for (size_t f = begin; f < end; ++f)
+            {
+                face_clusters(f) = remap[face_clusters(f)];
+            } });
+        result.clusters = cluster_detail::build_clusters(mesh, geometry, std::move(face_clusters), num_clusters);
+        return result;
+    }
+
+    // Splits the faces into regions of edge-connected faces whose normals differ by at most
+    // max_angle_degrees across every joining edge, so regions end at creases, boundaries and
+    // orientation flips. Adjacent pairs are joined concurrently in a lock-free union-find; regions are
+    // numbered in the order of their smallest face, so the result does not depend on the number of
+    // threads.
+    inline Polygon_clusters cluster_faces_by_normal(const Polygon_mesh &mesh, double max_angle_degrees)
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        if (!(max_angle_degrees >= 0.0))
+        {
+            throw std::invalid_argument("max_angle_degrees must not be negative.");
+        }
+        const Eigen::MatrixXi &F = mesh.F;
+        const size_t num_faces = static_cast<size_t>(F.rows());
+        MeshDerivedData derived(mesh);
+        const std::shared_ptr<const FaceGeometry> geometry_data = derived.face_geometry();
+        const FaceGeometry &geometry = *geometry_data;
+        const Eigen::MatrixXd &normals = geometry.normals;
+        const double min_cosine = std::cos(std::min(max_angle_degrees, 180.0) * EIGEN_PI / 180.0);
+        const std::shared_ptr<const MeshTopology> topology = derived.topology();
+
+        cluster_detail::UnionFind regions(num_faces);
+        parallel_for(0, topology->edges.size(), [&](size_t begin, size_t end)
+                     {
+            for (size_t e = begin; e < end; ++e)
+            {
+                // Every pair of faces on the edge, whichever direction they use it in.
+                for (int i = topology->edge_offsets[e]; i < topology->edge_offsets[e + 1]; ++i)
+                {
+                    const int f = MeshTopology::face_of(topology->edge_half_edges[i]);
+                    for (int k = i + 1; k < topology->edge_offsets[e + 1]; ++k)
+                    {
+                        const int g = MeshTopology::face_of(topology->edge_half_edges[k]);
+                        if (f != g && normals.row(f).dot(normals.row(g)) >= min_cosine)
+                        {
+                            regions.unite(static_cast<uint32_t>(f), static_cast<uint32_t>(g));
+                        }
+                    }
+                }
+            } }, 1024);
+
+        // Every root is the smallest face of its region, so numbering roots in face order numbers
+        // the regions by their smallest face.
+        std::vector<uint32_t> roots(num_faces);
+        parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                     {
+            for (size_t f = begin; f < end; ++f)
+            {
+                roots[f] = regions.find(static_cast<uint32_t>(f));
+            } });
+        Eigen::VectorXi face_clusters(num_faces);
+        int num_clusters = 0;
+        for (size_t f = 0; f < num_faces; ++f)
+        {
+            face_clusters(f) = roots[f] == f ? num_clusters++ : face_clusters(roots[f]);
+        }
+        return cluster_detail::build_clusters(mesh, geometry, std::move(face_clusters), num_clusters);
+    }
+
+} // namespace MITSU_Domoe
@@ -12,7 +12,10 @@
 #include <iostream>
 #include <map>
 #include <memory>
-#include <queue>
+#include <set>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
 #include <string>
 #include <any>
 #include <regex>
@@ -20,6 +23,8 @@
 #include <mutex>
 #include <condition_variable>
 #include <filesystem>
+#include <optional>
+#include <utility>
 
 #if __has_include(<yyjson.h>)
 #include <yyjson.h>
@@ -34,7 +39,8 @@ namespace MITSU_Domoe
     class CommandProcessor
     {
     public:
-        CommandProcessor(std::shared_ptr<ResultRepository> repo, const std::filesystem::path& log_path);
+        // Commands run on num_workers threads (at least one); see set_worker_count.
+        CommandProcessor(std::shared_ptr<ResultRepository> repo, const std::filesystem::path& log_path, size_t num_workers = 1);
         ~CommandProcessor();
 
         template <Cartridge C>
@@ -49,6 +55,7 @@ namespace MITSU_Domoe
 
 
             cartridge_manager[command_name].description = cartridge.description;
+            cartridge_manager[command_name].cacheable = is_cacheable<C>();
 
             for (const auto &f : rfl::fields<typename C::Input>())
             {
@@ -97,17 +104,57 @@ namespace MITSU_Domoe
             spdlog::info("Cartridge registered: {}", command_name);
         }
 
-        uint64_t add_to_queue(const std::string &command_name, const std::string &input_json);
+        // With reuse_cached, a command whose resolved input matches an existing successful result
+        // of the same command (executed, loaded from a log or restored) reuses that output instead of running.
+        // Cartridges that read or write files (readStl, writePly, streamCentroids, ...) opt out and always run.
+        // With record_timing, the command's timing is kept until take_command_timing collects it.
+        uint64_t add_to_queue(const std::string &command_name, const std::string &input_json, bool reuse_cached = false, bool record_timing = false);
         void load_result_from_log(const std::string& json_content);
+        // Parses a result log without touching the repository. Safe to call from any thread.
+        static std::optional<std::pair<uint64_t, CommandResult>> parse_result_log(const std::string& json_content);
         void start();
         void stop();
 
+        // Rewrites $ref:cmd[old] to $ref:cmd[new] for every old ID in id_map. Other refs are left alone.
+        static std::string remap_command_refs(const std::string &input_json, const std::map<uint64_t, uint64_t> &id_map);
+        // Rewrites $ref:latest and $ref:prev[n] to the explicit ID they would resolve to, given the IDs
+        // (ascending) of the results that precede the command. Refs reaching past earlier_ids are left alone.
+        static std::string pin_relative_refs(const std::string &input_json, const std::vector<uint64_t> &earlier_ids);
+
+        // Commands a request has to wait for. Relative refs (latest, prev[n]) depend on every earlier command.
+        struct CommandDependencies
+        {
+            std::vector<uint64_t> command_ids;
+            bool depends_on_all_earlier = false;
+        };
+        static CommandDependencies collect_dependencies(const std::string &input_json, uint64_t command_id);
+
+        struct CommandTiming
+        {
+            std::chrono::steady_clock::time_point queued;
+            std::chrono::steady_clock::time_point started;
+            std::chrono::steady_clock::time_point finished;
+        };
+        // Available once a command queued with record_timing has finished; removed once taken.
+        std::optional<CommandTiming> take_command_timing(uint64_t command_id);
+        // Blocks until none of the given commands is queued or running. Requires start() to have been called.
+        void wait_for_commands(const std::vector<uint64_t> &command_ids);
+        // Changes the number of commands run at once, e.g. for a replay. Missing workers are started;
+        // surplus ones finish their command and stay parked until the count grows again.
+        void set_worker_count(size_t num_workers);
+        size_t get_worker_count() const;
+
+        uint64_t get_next_command_id() const;
+        // Makes sure new commands get IDs of at least next_id. The counter never moves backwards.
+        void advance_next_command_id(uint64_t next_id);
+
         std::map<std::string, std::string> get_cartridge_schemas() const;
         std::vector<std::string> get_command_names() const;
         std::map<std::string, std::string> get_input_schema(const std::string& command_name) const;
 
     private:
-        void worker_loop();
+        // Worker index takes commands only while index < num_workers_.
+        void worker_loop(size_t index);
         // CommandProcessorの内部クラスとして定義すると良い
         struct Input_Schema
         {
@@ -120,9 +167,13 @@ namespace MITSU_Domoe
             Input_Schema input_schema;
             std::map<std::string, std::string> output_schema;
             std::string description;
+            // False for cartridges that read or write files; see is_cacheable.
+            bool cacheable = true;
         };
 
         std::string resolve_refs(const std::string &input_json, const std::string& command_name_of_current_cmd, uint64_t current_cmd_id);
+        std::optional<std::pair<uint64_t, SuccessResult>> find_cached_result(const std::string &command_name, const std::string &resolved_input_json);
+        void update_request_index();
 
 
         std::map<std::string, Cartridge_info> cartridge_manager;
@@ -131,17 +182,36 @@ namespace MITSU_Domoe
             uint64_t id;
             std::string command_name;
             std::string input_json;
-            std::function<CommandResult()> task;
+            std::function<CommandResult(uint64_t id)> task;
+            CommandDependencies dependencies;
         };
-        std::queue<CommandTask> command_queue_;
+        // Caller holds queue_mutex_. Returns the lowest queued command whose dependencies have finished.
+        std::map<uint64_t, CommandTask>::iterator find_ready_task();
+        void execute_task(CommandTask &task);
+
+        // Commands are taken in ID order, but a command may overtake earlier ones it does not depend on.
+        std::map<uint64_t, CommandTask> pending_commands_;
+        std::set<uint64_t> running_commands_;
+        // Only for commands queued with record_timing.
+        std::map<uint64_t, CommandTiming> command_timings_;
 
         std::atomic<uint64_t> next_command_id_{1};
         std::shared_ptr<ResultRepository> result_repo_;
         std::filesystem::path log_path_;
         std::filesystem::path command_history_path_;
 
-        std::thread worker_thread_;
-        std::mutex queue_mutex_;
+        // Successful results keyed by hash(command name, normalized resolved input) for reuse_cached lookups.
+        // Built lazily, so sessions that never replay incrementally pay nothing for it.
+        std::unordered_map<size_t, std::vector<uint64_t>> request_index_;
+        // Position in the repository's store log up to which request_index_ is built.
+        size_t indexed_position_ = 0;
+        std::mutex request_index_mutex_;
+        std::atomic<uint64_t> reused_result_count_{0};
+        std::atomic<uint64_t> executed_result_count_{0};
+
+        size_t num_workers_;
+        std::vector<std::thread> worker_threads_;
+        mutable std::mutex queue_mutex_;
         std::condition_variable condition_;
         std::atomic<bool> stop_flag_{false};
     };
@@ -21,7 +21,7 @@ private:
     void print_help();
     void run_tests();
     void handle_load(const std::string& path_str);
-    void handle_trace(const std::string& path_str);
+    void handle_trace(const std::string& path_str, bool reuse_cached);
 };
 
 }
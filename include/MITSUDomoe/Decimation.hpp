@@ -0,0 +1,631 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Clustering.hpp"
+#include "MeshNormals.hpp"
+#include "ThreadPool.hpp"
+#include "VertexFaces.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace decimate_detail
+    {
+        // Boundary edges are held in place by planes perpendicular to their face, weighted this much
+        // more than the faces themselves.
+        constexpr double BOUNDARY_WEIGHT = 1000.0;
+        // A collapse is rejected if it turns the normal of a remaining face by more than about 78 degrees.
+        constexpr double MIN_NORMAL_COSINE = 0.2;
+        // Share of the cheapest edges a collapse pass works through before all edges are priced again.
+        constexpr double PASS_FRACTION = 0.25;
+
+        // Symmetric 4x4 error quadric of Garland and Heckbert, sum of w * (n.p + d)^2 over planes.
+        struct Quadric
+        {
+            // Upper triangle: nx nx, nx ny, nx nz, nx d, ny ny, ny nz, ny d, nz nz, nz d, d d.
+            std::array<double, 10> q{};
+            // Total area of the face planes, which normalizes the error to a mean squared distance.
+            double area = 0.0;
+
+            void add_plane(const Eigen::Vector3d &n, double d, double w)
+            {
+                q[0] += w * n.x() * n.x();
+                q[1] += w * n.x() * n.y();
+                q[2] += w * n.x() * n.z();
+                q[3] += w * n.x() * d;
+                q[4] += w * n.y() * n.y();
+                q[5] += w * n.y() * n.z();
+                q[6] += w * n.y() * d;
+                q[7] += w * n.z() * n.z();
+                q[8] += w * n.z() * d;
+                q[9] += w * d * d;
+            }
+
+            Quadric &operator+=(const Quadric &other)
+            {
+                for (int i = 0; i < 10; ++i)
+                {
+                    q[i] += other.q[i];
+                }
+                area += other.area;
+                return *this;
+            }
+
+            // Mean squared distance of p to the planes.
+            double error(const Eigen::Vector3d &p) const
+            {
+                const double x = p.x(), y = p.y(), z = p.z();
+                const double sum = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+                                   q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+                                   q[7] * z * z + 2 * q[8] * z + q[9];
+                return std::max(0.0, sum) / std::max(area, std::numeric_limits<double>::min());
+            }
+
+            // Point of least error, if the planes pin one down.
+            bool minimizer(Eigen::Vector3d &p) const
+            {
+                Eigen::Matrix3d A;
+                A << q[0], q[1], q[2],
+                    q[1], q[4], q[5],
+                    q[2], q[5], q[7];
+                Eigen::Matrix3d inverse;
+                bool invertible = false;
+                A.computeInverseWithCheck(inverse, invertible, 1e-12 * std::max(1.0, A.cwiseAbs().maxCoeff()));
+                if (!invertible)
+                {
+                    return false;
+                }
+                p = -inverse * Eigen::Vector3d(q[3], q[6], q[8]);
+                return p.allFinite();
+            }
+        };
+
+        // Candidate collapse of edge (a, b) in the heap. It is stale once either vertex changes,
+        // which the version stamps detect.
+        struct Collapse
+        {
+            double cost;
+            int a;
+            int b;
+            uint32_t version_a;
+            uint32_t version_b;
+        };
+
+        // Min-heap order: the cheapest collapse on top, ties broken by the vertex ids.
+        inline bool heap_order(const Collapse &x, const Collapse &y)
+        {
+            if (x.cost != y.cost)
+            {
+                return x.cost > y.cost;
+            }
+            return x.a != y.a ? x.a > y.a : x.b > y.b;
+        }
+
+        // Edge collapse state. Faces are kept as a corner table, the compact half-edge form of a
+        // triangle mesh: half-edge 3 f + j runs from corner j of face f to the next corner. Every
+        // vertex lists its faces as a range of one flat array; a collapse appends the merged list
+        // at the end instead of growing lists in place, and the array is compacted when it doubles.
+        class Decimator
+        {
+        public:
+            Decimator(const Polygon_mesh &mesh, double max_error)
+                : V_(mesh.V), F_(mesh.F), max_error_squared_(max_error * max_error)
+            {
+                const size_t num_vertices = static_cast<size_t>(V_.rows());
+                const size_t num_faces = static_cast<size_t>(F_.rows());
+                const VertexFaces incidence = vertex_faces(F_, V_.rows());
+                refs_ = incidence.faces;
+                ref_begin_.assign(incidence.offsets.begin(), incidence.offsets.end() - 1);
+                ref_count_.resize(num_vertices);
+                face_alive_.assign(num_faces, 1);
+                live_faces_ = num_faces;
+                quadrics_.resize(num_vertices);
+                boundary_.assign(num_vertices, 0);
+                locked_.assign(num_vertices, 0);
+                version_.assign(num_vertices, 0);
+                vertex_alive_.assign(num_vertices, 1);
+
+                // Vertex quadrics are summed over the faces in ascending order, so they do not
+                // depend on the number of threads.
+                parallel_for(0, num_vertices, [&](size_t begin, size_t end)
+                             {
+                    std::vector<std::pair<int, int>> edges;
+                    for (size_t v = begin; v < end; ++v)
+                    {
+                        ref_count_[v] = incidence.offsets[v + 1] - incidence.offsets[v];
+                        Quadric &quadric = quadrics_[v];
+                        edges.clear();
+                        for (int i = 0; i < ref_count_[v]; ++i)
+                        {
+                            const int f = refs_[ref_begin_[v] + i];
+                            const Eigen::Vector3d normal = face_normal(f);
+                            const double length = normal.norm();
+                            if (length > 0.0)
+                            {
+                                const Eigen::Vector3d n = normal / length;
+                                quadric.add_plane(n, -n.dot(position(F_(f, 0))), 0.5 * length);
+                                quadric.area += 0.5 * length;
+                            }
+                            for (int j = 0; j < 3; ++j)
+                            {
+                                if (F_(f, j) != static_cast<int>(v))
+                                {
+                                    edges.emplace_back(F_(f, j), f);
+                                }
+                            }
+                        }
+                        // An edge used by one face is on the boundary, by more than two non-manifold.
+                        std::sort(edges.begin(), edges.end());
+                        for (size_t i = 0; i < edges.size();)
+                        {
+                            size_t j = i;
+                            while (j < edges.size() && edges[j].first == edges[i].first)
+                            {
+                                ++j;
+                            }
+                            if (j - i == 1)
+                            {
+                                const int f = edges[i].second;
+                                const Eigen::Vector3d edge = position(edges[i].first) - position(static_cast<int>(v));
+                                const Eigen::Vector3d normal = face_normal(f);
+                                const Eigen::Vector3d perpendicular = edge.cross(normal);
+                                const double length = perpendicular.norm();
+                                if (length > 0.0)
+                                {
+                                    const Eigen::Vector3d n = perpendicular / length;
+                                    quadric.add_plane(n, -n.dot(position(static_cast<int>(v))), BOUNDARY_WEIGHT * edge.squaredNorm());
+                                }
+                                boundary_[v] = 1;
+                            }
+                            else if (j - i > 2)
+                            {
+                                locked_[v] = 1;
+                            }
+                            i = j;
+                        }
+                    } });
+            }
+
+            size_t live_faces() const { return live_faces_; }
+            size_t collapses() const { return collapses_; }
+            double max_collapse_error() const { return std::sqrt(max_collapse_error_); }
+
+            // Collapses edges, cheapest first, until at most target_faces faces remain or every
+            // remaining collapse costs more than the error bound or would damage the mesh. Each pass
+            // prices all edges in parallel and works through a heap of the cheapest share of them; an
+            // edge next to an earlier collapse of the same pass waits for the next pass.
+            void run(size_t target_faces)
+            {
+                double fraction = PASS_FRACTION;
+                while (live_faces_ > target_faces)
+                {
+                    build_heap(fraction);
+                    const size_t before = collapses_;
+                    bool bounded = false;
+                    while (!heap_.empty() && live_faces_ > target_faces)
+                    {
+                        std::pop_heap(heap_.begin(), heap_.end(), heap_order);
+                        const Collapse collapse = heap_.back();
+                        heap_.pop_back();
+                        if (version_[collapse.a] != collapse.version_a || version_[collapse.b] != collapse.version_b)
+                        {
+                            continue;
+                        }
+                        // The heap holds the cheapest edges, so every other collapse costs more as well.
+                        if (collapse.cost > max_error_squared_)
+                        {
+                            bounded = true;
+                            break;
+                        }
+                        try_collapse(collapse);
+                    }
+                    if (bounded)
+                    {
+                        break;
+                    }
+                    // If none of the cheapest edges could go, try all of them once before giving up.
+                    if (collapses_ == before)
+                    {
+                        if (fraction == 1.0)
+                        {
+                            break;
+                        }
+                        fraction = 1.0;
+                    }
+                    else
+                    {
+                        fraction = PASS_FRACTION;
+                    }
+                }
+            }
+
+            // The remaining faces and the vertices they use, in their original order. Normals of the
+            // given kind, if any, are recomputed.
+            Polygon_mesh result(std::optional<Normal_kind> normals) const
+            {
+                std::vector<int> new_index(V_.rows(), -1);
+                int num_vertices = 0;
+                int num_faces = 0;
+                for (Eigen::Index f = 0; f < F_.rows(); ++f)
+                {
+                    if (!face_alive_[f])
+                    {
+                        continue;
+                    }
+                    ++num_faces;
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        new_index[F_(f, j)] = 0;
+                    }
+                }
+                for (int &index : new_index)
+                {
+                    if (index == 0)
+                    {
+                        index = num_vertices++;
+                    }
+                }
+
+                Polygon_mesh mesh;
+                mesh.V.resize(num_vertices, 3);
+                for (Eigen::Index v = 0; v < V_.rows(); ++v)
+                {
+                    if (new_index[v] >= 0)
+                    {
+                        mesh.V.row(new_index[v]) = V_.row(v);
+                    }
+                }
+                mesh.F.resize(num_faces, 3);
+                int row = 0;
+                for (Eigen::Index f = 0; f < F_.rows(); ++f)
+                {
+                    if (face_alive_[f])
+                    {
+                        for (int j = 0; j < 3; ++j)
+                        {
+                            mesh.F(row, j) = new_index[F_(f, j)];
+                        }
+                        ++row;
+                    }
+                }
+                if (normals)
+                {
+                    mesh.N = *normals == Normal_kind::vertex ? compute_vertex_normals(mesh.V, mesh.F) : compute_face_normals(mesh.V, mesh.F);
+                    mesh.normal_kind = normals;
+                }
+                return mesh;
+            }
+
+        private:
+            Eigen::Vector3d position(int v) const { return V_.row(v).transpose(); }
+
+            Eigen::Vector3d face_normal(int f) const
+            {
+                const Eigen::Vector3d v0 = position(F_(f, 0));
+                return (position(F_(f, 1)) - v0).cross(position(F_(f, 2)) - v0);
+            }
+
+            bool has_vertex(int f, int v) const
+            {
+                return F_(f, 0) == v || F_(f, 1) == v || F_(f, 2) == v;
+            }
+
+            void live_faces_of(int v, std::vector<int> &faces) const
+            {
+                faces.clear();
+                for (int i = 0; i < ref_count_[v]; ++i)
+                {
+                    const int f = refs_[ref_begin_[v] + i];
+                    if (face_alive_[f])
+                    {
+                        faces.push_back(f);
+                    }
+                }
+            }
+
+            // Sorted distinct neighbours of v over the given faces of v.
+            void neighbours_of(int v, const std::vector<int> &faces, std::vector<int> &neighbours) const
+            {
+                neighbours.clear();
+                for (const int f : faces)
+                {
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        if (F_(f, j) != v)
+                        {
+                            neighbours.push_back(F_(f, j));
+                        }
+                    }
+                }
+                std::sort(neighbours.begin(), neighbours.end());
+                neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            }
+
+            // Cheapest position for the merged vertex of edge (a, b): the minimizer of the summed
+            // quadric, or the better of the endpoints and the midpoint when it is not unique.
+            double placement(int a, int b, Eigen::Vector3d &p) const
+            {
+                Quadric quadric = quadrics_[a];
+                quadric += quadrics_[b];
+                if (quadric.minimizer(p))
+                {
+                    return quadric.error(p);
+                }
+                const Eigen::Vector3d candidates[3] = {position(a), position(b), 0.5 * (position(a) + position(b))};
+                double best = std::numeric_limits<double>::infinity();
+                for (const Eigen::Vector3d &candidate : candidates)
+                {
+                    const double error = quadric.error(candidate);
+                    if (error < best)
+                    {
+                        best = error;
+                        p = candidate;
+                    }
+                }
+                return best;
+            }
+
+            Collapse make_collapse(int a, int b) const
+            {
+                Eigen::Vector3d p;
+                return Collapse{placement(a, b, p), a, b, version_[a], version_[b]};
+            }
+
+            // Prices every edge between live, unlocked vertices and keeps the cheapest fraction of
+            // them in heap_.
+            void build_heap(double fraction)
+            {
+                const size_t num_vertices = static_cast<size_t>(V_.rows());
+                std::vector<std::vector<Collapse>> per_block((num_vertices + cluster_detail::MIN_BLOCK_SIZE - 1) / cluster_detail::MIN_BLOCK_SIZE);
+                parallel_for(0, per_block.size(), [&](size_t begin, size_t end)
+                             {
+                    std::vector<int> faces;
+                    std::vector<int> neighbours;
+                    for (size_t block = begin; block < end; ++block)
+                    {
+                        const size_t last = std::min(num_vertices, (block + 1) * cluster_detail::MIN_BLOCK_SIZE);
+                        for (size_t v = block * cluster_detail::MIN_BLOCK_SIZE; v < last; ++v)
+                        {
+                            const int a = static_cast<int>(v);
+                            if (!vertex_alive_[v] || locked_[v])
+                            {
+                                continue;
+                            }
+                            live_faces_of(a, faces);
+                            neighbours_of(a, faces, neighbours);
+                            for (const int b : neighbours)
+                            {
+                                if (b > a && !locked_[b])
+                                {
+                                    per_block[block].push_back(make_collapse(a, b));
+                                }
+                            }
+                        }
+                    } }, 1);
+                heap_.clear();
+                for (const std::vector<Collapse> &block : per_block)
+                {
+                    heap_.insert(heap_.end(), block.begin(), block.end());
+                }
+                const size_t kept = std::max<size_t>(1, static_cast<size_t>(fraction * heap_.size()));
+                if (kept < heap_.size())
+                {
+                    std::nth_element(heap_.begin(), heap_.begin() + kept, heap_.end(), [](const Collapse &x, const Collapse &y)
+                                     { return heap_order(y, x); });
+                    heap_.resize(kept);
+                }
+                std::make_heap(heap_.begin(), heap_.end(), heap_order);
+            }
+
+            void try_collapse(const Collapse &collapse)
+            {
+                const int a = collapse.a;
+                const int b = collapse.b;
+                live_faces_of(a, faces_a_);
+                live_faces_of(b, faces_b_);
+                int shared = 0;
+                for (const int f : faces_b_)
+                {
+                    shared += has_vertex(f, a);
+                }
+                // Merging two boundaries across the interior would pinch the surface.
+                if (shared == 0 || shared > 2 || (shared == 2 && boundary_[a] && boundary_[b]))
+                {
+                    return;
+                }
+                // Link condition: a and b may only share the neighbours opposite the edge, or the
+                // collapse would create non-manifold edges or duplicate faces.
+                neighbours_of(a, faces_a_, neighbours_a_);
+                neighbours_of(b, faces_b_, neighbours_b_);
+                int common = 0;
+                for (size_t i = 0, j = 0; i < neighbours_a_.size() && j < neighbours_b_.size();)
+                {
+                    if (neighbours_a_[i] < neighbours_b_[j])
+                    {
+                        ++i;
+                    }
+                    else if (neighbours_b_[j] < neighbours_a_[i])
+                    {
+                        ++j;
+                    }
+                    else
+                    {
+                        ++common;
+                        ++i;
+                        ++j;
+                    }
+                }
+                if (common != shared)
+                {
+                    return;
+                }
+
+                Eigen::Vector3d p;
+                placement(a, b, p);
+                if (flips(a, b, faces_a_, p) || flips(b, a, faces_b_, p))
+                {
+                    return;
+                }
+
+                // Faces on the edge disappear; the others of b are handed over to a.
+                const size_t merged_begin = refs_.size();
+                for (const int f : faces_a_)
+                {
+                    if (has_vertex(f, b))
+                    {
+                        face_alive_[f] = 0;
+                        --live_faces_;
+                    }
+                    else
+                    {
+                        refs_.push_back(f);
+                    }
+                }
+                for (const int f : faces_b_)
+                {
+                    if (!face_alive_[f])
+                    {
+                        continue;
+                    }
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        if (F_(f, j) == b)
+                        {
+                            F_(f, j) = a;
+                        }
+                    }
+                    refs_.push_back(f);
+                }
+                ref_begin_[a] = static_cast<int>(merged_begin);
+                ref_count_[a] = static_cast<int>(refs_.size() - merged_begin);
+                ref_count_[b] = 0;
+                V_.row(a) = p.transpose();
+                quadrics_[a] += quadrics_[b];
+                boundary_[a] |= boundary_[b];
+                vertex_alive_[b] = 0;
+                ++version_[a];
+                ++version_[b];
+                ++collapses_;
+                max_collapse_error_ = std::max(max_collapse_error_, collapse.cost);
+                if (refs_.size() > 2 * static_cast<size_t>(F_.size()))
+                {
+                    compact_refs();
+                }
+            }
+
+            // Whether moving v to p flips or degenerates one of its faces that survive the collapse
+            // of edge (v, other).
+            bool flips(int v, int other, const std::vector<int> &faces, const Eigen::Vector3d &p) const
+            {
+                for (const int f : faces)
+                {
+                    if (has_vertex(f, other))
+                    {
+                        continue;
+                    }
+                    Eigen::Vector3d corners[3];
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        corners[j] = F_(f, j) == v ? p : position(F_(f, j));
+                    }
+                    const Eigen::Vector3d before = face_normal(f);
+                    const Eigen::Vector3d after = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+                    const double lengths = before.norm() * after.norm();
+                    if (!(lengths > 0.0) || before.dot(after) < MIN_NORMAL_COSINE * lengths)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void compact_refs()
+            {
+                std::vector<int> compacted;
+                compacted.reserve(3 * live_faces_);
+                for (Eigen::Index v = 0; v < V_.rows(); ++v)
+                {
+                    const int begin = static_cast<int>(compacted.size());
+                    for (int i = 0; i < ref_count_[v]; ++i)
+                    {
+                        const int f = refs_[ref_begin_[v] + i];
+                        if (face_alive_[f])
+                        {
+                            compacted.push_back(f);
+                        }
+                    }
+                    ref_begin_[v] = begin;
+                    ref_count_[v] = static_cast<int>(compacted.size()) - begin;
+                }
+                refs_ = std::move(compacted);
+            }
+
+            Eigen::MatrixXd V_;
+            Eigen::MatrixXi F_;
+            double max_error_squared_;
+            std::vector<int> refs_;
+            std::vector<int> ref_begin_;
+            std::vector<int> ref_count_;
+            std::vector<char> face_alive_;
+            std::vector<char> vertex_alive_;
+            std::vector<Quadric> quadrics_;
+            std::vector<char> boundary_;
+            // Vertices on non-manifold edges never move.
+            std::vector<char> locked_;
+            std::vector<uint32_t> version_;
+            std::vector<Collapse> heap_;
+            size_t live_faces_ = 0;
+            size_t collapses_ = 0;
+            double max_collapse_error_ = 0.0;
+            // Scratch space for try_collapse.
+            std::vector<int> faces_a_;
+            std::vector<int> faces_b_;
+            std::vector<int> neighbours_a_;
+            std::vector<int> neighbours_b_;
+        };
+    } // namespace decimate_detail
+
+    struct Decimation
+    {
+        Polygon_mesh mesh;
+        size_t collapses = 0;
+        // Largest error of a performed collapse: the RMS distance of the merged vertex from the
+        // planes of the faces it stands for.
+        double max_error = 0.0;
+    };
+
+    // Simplifies a triangle mesh by quadric error edge collapses (Garland and Heckbert), cheapest
+    // first, until at most target_faces faces remain or the next collapse would exceed max_error
+    // (an RMS distance, see Decimation). Boundaries are preserved by constraint planes; collapses
+    // that would flip faces or break manifoldness are skipped, and vertices on non-manifold edges
+    // stay put. The result is compacted; its normals are per face or per vertex like the input's.
+    inline Decimation decimate_mesh(const Polygon_mesh &mesh, size_t target_faces,
+                                    double max_error = std::numeric_limits<double>::infinity())
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        if (!(max_error >= 0.0))
+        {
+            throw std::invalid_argument("max_error must not be negative.");
+        }
+        decimate_detail::Decimator decimator(mesh, max_error);
+        decimator.run(target_faces);
+
+        Decimation result;
+        result.mesh = decimator.result(valid_normal_kind(mesh));
+        result.collapses = decimator.collapses();
+        result.max_error = decimator.max_collapse_error();
+        return result;
+    }
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Hash.hpp"
+#include "MeshNormals.hpp"
+#include "MeshTopology.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    // Centroid, unit normal (zero for degenerate faces) and area of every triangle of a mesh.
+    struct FaceGeometry
+    {
+        Eigen::MatrixXd centroids;
+        Eigen::MatrixXd normals;
+        Eigen::VectorXd areas;
+    };
+
+    inline FaceGeometry compute_face_geometry(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F)
+    {
+        FaceGeometry geometry;
+        geometry.centroids.resize(F.rows(), 3);
+        geometry.normals.resize(F.rows(), 3);
+        geometry.areas.resize(F.rows());
+        parallel_for(0, static_cast<size_t>(F.rows()), [&](size_t begin, size_t end)
+                     {
+            for (size_t f = begin; f < end; ++f)
+            {
+                const Eigen::Vector3d v0 = V.row(F(f, 0)).transpose();
+                const Eigen::Vector3d v1 = V.row(F(f, 1)).transpose();
+                const Eigen::Vector3d v2 = V.row(F(f, 2)).transpose();
+                const Eigen::Vector3d normal = (v1 - v0).cross(v2 - v0);
+                const double length = normal.norm();
+                geometry.centroids.row(f) = ((v0 + v1 + v2) / 3.0).transpose();
+                geometry.normals.row(f) = (length > 0.0 ? Eigen::Vector3d(normal / length) : Eigen::Vector3d::Zero()).transpose();
+                geometry.areas(f) = 0.5 * length;
+            } });
+        return geometry;
+    }
+
+    // Two rows, the per-column minimum and maximum of V. An empty V gives +inf and -inf.
+    inline Eigen::MatrixXd compute_bounding_box(const Eigen::MatrixXd &V)
+    {
+        constexpr size_t block_size = 1 << 16;
+        const size_t num_rows = static_cast<size_t>(V.rows());
+        const size_t num_blocks = (num_rows + block_size - 1) / block_size;
+        std::vector<Eigen::MatrixXd> block_boxes(num_blocks);
+        parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                     {
+            for (size_t b = begin; b < end; ++b)
+            {
+                const Eigen::Index first = static_cast<Eigen::Index>(b * block_size);
+                const Eigen::Index count = static_cast<Eigen::Index>(std::min(num_rows, (b + 1) * block_size)) - first;
+                Eigen::MatrixXd &box = block_boxes[b];
+                box.resize(2, V.cols());
+                box.row(0) = V.middleRows(first, count).colwise().minCoeff();
+                box.row(1) = V.middleRows(first, count).colwise().maxCoeff();
+            } }, 1);
+        Eigen::MatrixXd box(2, V.cols());
+        box.row(0).setConstant(std::numeric_limits<double>::infinity());
+        box.row(1).setConstant(-std::numeric_limits<double>::infinity());
+        for (const Eigen::MatrixXd &block : block_boxes)
+        {
+            box.row(0) = box.row(0).cwiseMin(block.row(0));
+            box.row(1) = box.row(1).cwiseMax(block.row(1));
+        }
+        return box;
+    }
+
+    // Bytes held by a cached quantity, charged against the budget of DerivedDataCache.
+    template <typename Derived>
+    size_t memory_usage(const Eigen::PlainObjectBase<Derived> &matrix)
+    {
+        return sizeof(typename Derived::Scalar) * static_cast<size_t>(matrix.size());
+    }
+
+    inline size_t memory_usage(const FaceGeometry &geometry)
+    {
+        return memory_usage(geometry.centroids) + memory_usage(geometry.normals) + memory_usage(geometry.areas);
+    }
+
+    inline size_t memory_usage(const MeshTopology &topology)
+    {
+        return topology.memory_usage();
+    }
+
+    // Process-wide cache of quantities derived from meshes (bounding box, face geometry, vertex
+    // normals, topology), keyed by a content hash of the arrays they are computed from and the name
+    // of the quantity. Commands receive their inputs as deserialized results, so one mesh often
+    // reaches several of them; the first computes a quantity and the others share it. Every entry is
+    // charged its memory_usage, and the least recently used entries are evicted to stay within the
+    // budget. A value larger than the whole budget is returned but not kept.
+    class DerivedDataCache
+    {
+    public:
+        static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(1) << 30;
+
+        static DerivedDataCache &shared()
+        {
+            static DerivedDataCache cache;
+            return cache;
+        }
+
+        // The value of quantity for the data identified by key, calling compute() on a miss. compute
+        // runs without the lock held; if two threads miss together, both compute and the first stored
+        // value is kept.
+        template <typename T, typename Compute>
+        std::shared_ptr<const T> get(uint64_t key, const std::string &quantity, Compute &&compute)
+        {
+            const EntryKey entry_key(key, quantity, std::type_index(typeid(T)));
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (const auto it = index_.find(entry_key); it != index_.end())
+                {
+                    entries_.splice(entries_.begin(), entries_, it->second);
+                    return std::static_pointer_cast<const T>(it->second->value);
+                }
+            }
+            auto value = std::make_shared<const T>(compute());
+            const size_t bytes = MITSU_Domoe::memory_usage(*value);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (const auto it = index_.find(entry_key); it != index_.end())
+            {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return std::static_pointer_cast<const T>(it->second->value);
+            }
+            // Storing it would only evict every other entry before evicting the value itself.
+            if (bytes > memory_budget_)
+            {
+                return value;
+            }
+            entries_.push_front(Entry{entry_key, value, bytes});
+            index_.emplace(entry_key, entries_.begin());
+            memory_usage_ += bytes;
+            evict();
+            return value;
+        }
+
+        void set_memory_budget(size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            memory_budget_ = bytes;
+            evict();
+        }
+
+        size_t memory_budget() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return memory_budget_;
+        }
+
+        size_t memory_usage() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return memory_usage_;
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_.clear();
+            index_.clear();
+            memory_usage_ = 0;
+        }
+
+    private:
+        using EntryKey = std::tuple<uint64_t, std::string, std::type_index>;
+
+        struct Entry
+        {
+            EntryKey key;
+            std::shared_ptr<const void> value;
+            size_t bytes;
+        };
+
+        DerivedDataCache() = default;
+
+        void evict()
+        {
+            while (memory_usage_ > memory_budget_ && !entries_.empty())
+            {
+                memory_usage_ -= entries_.back().bytes;
+                index_.erase(entries_.back().key);
+                entries_.pop_back();
+            }
+        }
+
+        mutable std::mutex mutex_;
+        std::list<Entry> entries_;
+        std::map<EntryKey, std::list<Entry>::iterator> index_;
+        size_t memory_usage_ = 0;
+        size_t memory_budget_ = DEFAULT_MEMORY_BUDGET;
+    };
+
+    // Derived quantities of one mesh, served from DerivedDataCache::shared(). The content hashes of F
+    // and V are computed on first use and kept, so one object per command hashes the mesh at most
+    // once. The topology depends only on F and the vertex count and is keyed by them alone, so it
+    // survives moving the vertices. The mesh must outlive this object.
+    class MeshDerivedData
+    {
+    public:
+        explicit MeshDerivedData(const Polygon_mesh &mesh) : mesh_(mesh) {}
+
+        uint64_t connectivity_key()
+        {
+            if (!connectivity_key_)
+            {
+                const uint64_t shape[] = {static_cast<uint64_t>(mesh_.V.rows()), static_cast<uint64_t>(mesh_.F.rows()), static_cast<uint64_t>(mesh_.F.cols())};
+                connectivity_key_ = hash_bytes(mesh_.F.data(), sizeof(int) * mesh_.F.size(), xxh64(shape, sizeof(shape), 0));
+            }
+            return *connectivity_key_;
+        }
+
+        uint64_t geometry_key()
+        {
+            if (!geometry_key_)
+            {
+                geometry_key_ = hash_bytes(mesh_.V.data(), sizeof(double) * mesh_.V.size(), connectivity_key() ^ static_cast<uint64_t>(mesh_.V.cols()));
+            }
+            return *geometry_key_;
+        }
+
+        std::shared_ptr<const Eigen::MatrixXd> bounding_box()
+        {
+            return DerivedDataCache::shared().get<Eigen::MatrixXd>(geometry_key(), "bounding_box", [&]
+                                                                   { return compute_bounding_box(mesh_.V); });
+        }
+
+        // Requires a triangle mesh with 3D vertices.
+        std::shared_ptr<const FaceGeometry> face_geometry()
+        {
+            return DerivedDataCache::shared().get<FaceGeometry>(geometry_key(), "face_geometry", [&]
+                                                                { return compute_face_geometry(mesh_.V, mesh_.F); });
+        }
+
+        std::shared_ptr<const Eigen::MatrixXd> vertex_normals(NormalWeighting weighting = NormalWeighting::area)
+        {
+            return DerivedDataCache::shared().get<Eigen::MatrixXd>(geometry_key(), weighting == NormalWeighting::angle ? "vertex_normals_angle" : "vertex_normals_area", [&]
+                                                                   { return compute_vertex_normals(mesh_.V, mesh_.F, weighting); });
+        }
+
+        // All indices of F must be in [0, V.rows()).
+        std::shared_ptr<const MeshTopology> topology()
+        {
+            return DerivedDataCache::shared().get<MeshTopology>(connectivity_key(), "topology", [&]
+                                                                { return MeshTopology(mesh_.F, mesh_.V.rows()); });
+        }
+
+    private:
+        const Polygon_mesh &mesh_;
+        std::optional<uint64_t> connectivity_key_;
+        std::optional<uint64_t> geometry_key_;
+    };
+
+} // namespace MITSU_Domoe
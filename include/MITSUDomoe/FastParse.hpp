@@ -0,0 +1,82 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+#include <system_error>
+
+namespace MITSU_Domoe
+{
+
+    // Allocation-free helpers for scanning text formats (ASCII STL, OBJ, PLY headers) in a
+    // [p, end) buffer, usually a memory-mapped file. Numbers go through std::from_chars, which is
+    // locale-independent and much faster than iostreams or strtod.
+    namespace fast_parse
+    {
+        inline bool is_space(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+        }
+
+        inline const char *skip_whitespace(const char *p, const char *end)
+        {
+            while (p < end && is_space(*p))
+            {
+                ++p;
+            }
+            return p;
+        }
+
+        // Skips spaces and tabs but stops at the end of the line.
+        inline const char *skip_blanks(const char *p, const char *end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            {
+                ++p;
+            }
+            return p;
+        }
+
+        // Returns the position just after the next '\n', or end.
+        inline const char *skip_line(const char *p, const char *end)
+        {
+            while (p < end && *p != '\n')
+            {
+                ++p;
+            }
+            return p < end ? p + 1 : end;
+        }
+
+        // Reads the next whitespace-separated token and advances p past it.
+        inline std::string_view next_token(const char *&p, const char *end)
+        {
+            p = skip_whitespace(p, end);
+            const char *start = p;
+            while (p < end && !is_space(*p))
+            {
+                ++p;
+            }
+            return std::string_view(start, static_cast<size_t>(p - start));
+        }
+
+        inline bool starts_with(const char *p, const char *end, std::string_view prefix)
+        {
+            return static_cast<size_t>(end - p) >= prefix.size() && std::string_view(p, prefix.size()) == prefix;
+        }
+
+        // Skips leading whitespace and parses one number into value.
+        // Returns the position after the number, or nullptr if there is no valid number.
+        template <typename T>
+        const char *parse_number(const char *p, const char *end, T &value)
+        {
+            p = skip_whitespace(p, end);
+            if (p < end && *p == '+')
+            {
+                ++p;
+            }
+            const auto [next, ec] = std::from_chars(p, end, value);
+            return ec == std::errc() ? next : nullptr;
+        }
+    } // namespace fast_parse
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace MITSU_Domoe
+{
+
+    // Closest point to p on triangle (a, b, c), from Ericson, "Real-Time Collision Detection", 5.1.5.
+    inline Eigen::Vector3d closest_point_on_triangle(const Eigen::Vector3d &p, const Eigen::Vector3d &a,
+                                                     const Eigen::Vector3d &b, const Eigen::Vector3d &c)
+    {
+        const Eigen::Vector3d ab = b - a;
+        const Eigen::Vector3d ac = c - a;
+        const Eigen::Vector3d ap = p - a;
+        const double d1 = ab.dot(ap);
+        const double d2 = ac.dot(ap);
+        if (d1 <= 0.0 && d2 <= 0.0)
+        {
+            return a;
+        }
+        const Eigen::Vector3d bp = p - b;
+        const double d3 = ab.dot(bp);
+        const double d4 = ac.dot(bp);
+        if (d3 >= 0.0 && d4 <= d3)
+        {
+            return b;
+        }
+        const double vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        {
+            return a + d1 / (d1 - d3) * ab;
+        }
+        const Eigen::Vector3d cp = p - c;
+        const double d5 = ab.dot(cp);
+        const double d6 = ac.dot(cp);
+        if (d6 >= 0.0 && d5 <= d6)
+        {
+            return c;
+        }
+        const double vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        {
+            return a + d2 / (d2 - d6) * ac;
+        }
+        const double va = d3 * d6 - d5 * d4;
+        if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+        {
+            return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+        }
+        const double denominator = 1.0 / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+
+    // Distance along the ray origin + t * direction to triangle (a, b, c) (Moller-Trumbore), or
+    // infinity if the ray misses it or hits it outside (t_min, t_max). Both sides of the triangle count.
+    inline double ray_triangle_distance(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction,
+                                        const Eigen::Vector3d &a, const Eigen::Vector3d &b, const Eigen::Vector3d &c,
+                                        double t_min = 0.0, double t_max = std::numeric_limits<double>::infinity())
+    {
+        constexpr double miss = std::numeric_limits<double>::infinity();
+        const Eigen::Vector3d e1 = b - a;
+        const Eigen::Vector3d e2 = c - a;
+        const Eigen::Vector3d p = direction.cross(e2);
+        const double determinant = e1.dot(p);
+        if (determinant == 0.0)
+        {
+            return miss;
+        }
+        const double inverse = 1.0 / determinant;
+        const Eigen::Vector3d s = origin - a;
+        const double u = s.dot(p) * inverse;
+        if (u < 0.0 || u > 1.0)
+        {
+            return miss;
+        }
+        const Eigen::Vector3d q = s.cross(e1);
+        const double v = direction.dot(q) * inverse;
+        if (v < 0.0 || u + v > 1.0)
+        {
+            return miss;
+        }
+        const double t = e2.dot(q) * inverse;
+        return t > t_min && t < t_max ? t : miss;
+    }
+
+    // Slab test. inverse_direction holds 1 / direction per axis (infinite for zero components).
+    // Returns the entry distance, or infinity if the ray misses the box within [0, t_max).
+    inline double ray_box_distance(const Eigen::Vector3d &origin, const Eigen::Vector3d &inverse_direction,
+                                   const Eigen::Vector3d &box_min, const Eigen::Vector3d &box_max, double t_max)
+    {
+        double t_near = 0.0;
+        double t_far = t_max;
+        for (int k = 0; k < 3; ++k)
+        {
+            double t0 = (box_min(k) - origin(k)) * inverse_direction(k);
+            double t1 = (box_max(k) - origin(k)) * inverse_direction(k);
+            if (t0 > t1)
+            {
+                std::swap(t0, t1);
+            }
+            // std::max/min return their first argument when comparing with NaN (0 * inf when the
+            // origin lies on a slab boundary), so NaN leaves the interval unchanged.
+            t_near = std::max(t_near, t0);
+            t_far = std::min(t_far, t1);
+            if (t_near > t_far)
+            {
+                return std::numeric_limits<double>::infinity();
+            }
+        }
+        return t_near;
+    }
+
+    inline double point_box_squared_distance(const Eigen::Vector3d &p, const Eigen::Vector3d &box_min, const Eigen::Vector3d &box_max)
+    {
+        return (box_min - p).cwiseMax(p - box_max).cwiseMax(0.0).squaredNorm();
+    }
+
+    // Separating axis test between triangle (a, b, c) and the axis-aligned box with the given center
+    // and half extents (Akenine-Moller, "Fast 3D Triangle-Box Overlap Testing"). Touching counts as overlap.
+    inline bool triangle_box_overlap(const Eigen::Vector3d &center, const Eigen::Vector3d &half_extent,
+                                     const Eigen::Vector3d &a, const Eigen::Vector3d &b, const Eigen::Vector3d &c)
+    {
+        const Eigen::Vector3d v[3] = {a - center, b - center, c - center};
+
+        // Box face normals.
+        for (int k = 0; k < 3; ++k)
+        {
+            const double lo = std::min({v[0](k), v[1](k), v[2](k)});
+            const double hi = std::max({v[0](k), v[1](k), v[2](k)});
+            if (lo > half_extent(k) || hi < -half_extent(k))
+            {
+                return false;
+            }
+        }
+
+        // Triangle normal.
+        const Eigen::Vector3d edges[3] = {v[1] - v[0], v[2] - v[1], v[0] - v[2]};
+        const Eigen::Vector3d normal = edges[0].cross(edges[1]);
+        if (std::abs(normal.dot(v[0])) > half_extent.dot(normal.cwiseAbs()))
+        {
+            return false;
+        }
+
+        // Cross products of the box axes with the triangle edges.
+        for (const Eigen::Vector3d &edge : edges)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                const Eigen::Vector3d axis = Eigen::Vector3d::Unit(k).cross(edge);
+                const double p0 = axis.dot(v[0]);
+                const double p1 = axis.dot(v[1]);
+                const double p2 = axis.dot(v[2]);
+                const double radius = half_extent.dot(axis.cwiseAbs());
+                if (std::min({p0, p1, p2}) > radius || std::max({p0, p1, p2}) < -radius)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+} // namespace MITSU_Domoe
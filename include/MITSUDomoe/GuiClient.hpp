@@ -6,8 +6,11 @@
 #include "3D_objects.hpp"
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <utility>
 
 struct yyjson_val;
@@ -44,13 +47,51 @@ private:
     void handle_load(const std::string& path_str);
     void handle_trace(const std::string& path_str);
     void handle_trace_history(const std::string& path_str);
+    void handle_save_snapshot(const std::string& path_str);
+    void handle_restore_snapshot(const std::string& path_str);
+    std::map<std::string, std::string> get_snapshot_attachments() override;
+    void restore_snapshot_attachments(const std::map<std::string, std::string>& attachments) override;
+    // Runs a log load/trace on a background thread so the render loop keeps going.
+    // The returned text is appended to loaded_log_content when the job finishes.
+    void start_log_job(const std::string& label, std::function<std::string(LogLoadProgress&)> job);
+    void poll_log_job();
+    bool is_log_job_running() const;
 
     ShaderManager shader_manager;
     std::map<std::pair<uint64_t, std::string>, MeshRenderState> mesh_render_states;
 
+    // Render settings restored from a snapshot, applied when the matching mesh is first processed.
+    // Filled from the log job thread, hence the mutex.
+    struct SavedRenderState
+    {
+        uint64_t result_id;
+        std::string output_name;
+        bool is_visible;
+        std::string selected_shader_name;
+        std::vector<float> camera_target;
+        float distance;
+        float yaw;
+        float pitch;
+        float near_clip;
+        float far_clip;
+    };
+    // Render states read from a snapshot travel in three steps: restore_snapshot_attachments parses
+    // them into snapshot_render_states, handle_restore_snapshot publishes them together with the
+    // reset flag once the results are stored, and the render thread takes them into
+    // saved_render_states when it performs the reset.
+    std::map<std::pair<uint64_t, std::string>, SavedRenderState> snapshot_render_states;
+    std::map<std::pair<uint64_t, std::string>, SavedRenderState> restored_render_states;
+    std::map<std::pair<uint64_t, std::string>, SavedRenderState> saved_render_states;
+    std::mutex restored_render_states_mutex;
+    bool reset_render_states = false;
+
     // UI State for Log Loader
     char log_path_buffer[256] = {0};
+    bool trace_reuse_cached = false;
     std::string loaded_log_content;
+    std::future<std::string> log_job;
+    std::shared_ptr<LogLoadProgress> log_job_progress;
+    std::string log_job_label;
 };
 
 }
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace hash_detail
+    {
+        constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+        constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+        inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+        inline uint64_t read64(const unsigned char *p)
+        {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            return word;
+        }
+
+        inline uint64_t round(uint64_t acc, uint64_t input)
+        {
+            return rotl(acc + input * PRIME2, 31) * PRIME1;
+        }
+
+        inline uint64_t merge_round(uint64_t acc, uint64_t value)
+        {
+            return (acc ^ round(0, value)) * PRIME1 + PRIME4;
+        }
+    } // namespace hash_detail
+
+    // XXH64 of a byte range (little-endian reads), single-threaded.
+    inline uint64_t xxh64(const void *data, size_t size, uint64_t seed)
+    {
+        using namespace hash_detail;
+        const auto *p = static_cast<const unsigned char *>(data);
+        const unsigned char *const last = p + size;
+        uint64_t h;
+        if (size >= 32)
+        {
+            uint64_t v1 = seed + PRIME1 + PRIME2;
+            uint64_t v2 = seed + PRIME2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - PRIME1;
+            for (; p + 32 <= last; p += 32)
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+            }
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge_round(h, v1);
+            h = merge_round(h, v2);
+            h = merge_round(h, v3);
+            h = merge_round(h, v4);
+        }
+        else
+        {
+            h = seed + PRIME5;
+        }
+        h += static_cast<uint64_t>(size);
+        for (; p + 8 <= last; p += 8)
+        {
+            h = rotl(h ^ round(0, read64(p)), 27) * PRIME1 + PRIME4;
+        }
+        if (p + 4 <= last)
+        {
+            uint32_t word;
+            std::memcpy(&word, p, sizeof(word));
+            h = rotl(h ^ (word * PRIME1), 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        for (; p < last; ++p)
+        {
+            h = rotl(h ^ (*p * PRIME5), 11) * PRIME1;
+        }
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    // 64-bit hash of a byte range: XXH64 of 1 MiB blocks computed on the pool, combined in order, so
+    // the value does not depend on the number of threads. Chaining calls through seed fingerprints
+    // several arrays at once.
+    inline uint64_t hash_bytes(const void *data, size_t size, uint64_t seed)
+    {
+        constexpr size_t block_size = 1 << 20;
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        const size_t num_blocks = (size + block_size - 1) / block_size;
+        std::vector<uint64_t> block_hashes(num_blocks);
+        parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                     {
+            for (size_t b = begin; b < end; ++b)
+            {
+                const size_t first = b * block_size;
+                block_hashes[b] = xxh64(bytes + first, std::min(size, first + block_size) - first, 0);
+            } }, 1);
+        uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ull);
+        for (const uint64_t block : block_hashes)
+        {
+            h = (h ^ block) * 0xBF58476D1CE4E5B9ull;
+            h ^= h >> 31;
+        }
+        return h;
+    }
+
+} // namespace MITSU_Domoe
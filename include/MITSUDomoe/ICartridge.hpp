@@ -23,6 +23,18 @@ concept Cartridge = requires(T cartridge, const typename T::Input& input) {
 
 };
 
+// A cartridge whose result depends on more than its input (it reads or writes a file) declares
+// `static constexpr bool cacheable = false;`, so that replays never reuse an earlier result of it.
+template<typename T>
+constexpr bool is_cacheable()
+{
+    if constexpr (requires { T::cacheable; }) {
+        return T::cacheable;
+    } else {
+        return true;
+    }
+}
+
 // コマンド実行結果の汎用的な表現
 // 成功時はシリアライズされたOutput(JSON文字列)を、失敗時はエラー情報を保持
 struct SuccessResult {
@@ -0,0 +1,519 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Hash.hpp"
+#include "PackedCache.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace kd_detail
+    {
+        // Ranges larger than this have their two halves built on separate threads.
+        constexpr size_t PARALLEL_RANGE = 1 << 15;
+        // Grid cells per axis of the Morton order used to sort queries (21 bits each).
+        constexpr double MORTON_CELLS = (1 << 21) - 1;
+
+        // Same layout as the BVH node: bounds and links of a node share one cache line.
+        struct alignas(64) Node
+        {
+            double min[3];
+            uint32_t offset;
+            uint32_t count;
+            double max[3];
+            uint32_t axis;
+        };
+        static_assert(sizeof(Node) == 64);
+
+        struct Point
+        {
+            double p[3];
+            uint32_t id;
+        };
+
+        // Number of leaves of the median-split tree over n points: a range is halved (the first
+        // half getting n / 2) until it holds at most leaf_size points. The sizes at one depth differ
+        // by at most one, so the pair (leaves(n), leaves(n + 1)) is carried down instead of
+        // recursing into both halves.
+        inline std::pair<size_t, size_t> leaf_counts(size_t n, size_t leaf_size)
+        {
+            if (n + 1 <= leaf_size)
+            {
+                return {1, 1};
+            }
+            if (n <= leaf_size)
+            {
+                return {1, 2};
+            }
+            const auto [half, half_plus_one] = leaf_counts(n / 2, leaf_size);
+            return n % 2 == 0 ? std::make_pair(2 * half, half + half_plus_one)
+                              : std::make_pair(half + half_plus_one, 2 * half_plus_one);
+        }
+
+        inline size_t subtree_size(size_t n, size_t leaf_size)
+        {
+            return 2 * leaf_counts(n, leaf_size).first - 1;
+        }
+
+        // Builds the subtree over points[begin, end) into nodes[index, index + subtree_size). Every
+        // subtree knows its place in the final depth-first array up front, so both halves of a large
+        // range are built concurrently straight into it.
+        inline void build(std::vector<Point> &points, std::vector<Node> &nodes, size_t begin, size_t end, size_t index, size_t leaf_size)
+        {
+            Node &node = nodes[index];
+            for (int k = 0; k < 3; ++k)
+            {
+                node.min[k] = std::numeric_limits<double>::infinity();
+                node.max[k] = -std::numeric_limits<double>::infinity();
+            }
+            for (size_t i = begin; i < end; ++i)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    node.min[k] = std::min(node.min[k], points[i].p[k]);
+                    node.max[k] = std::max(node.max[k], points[i].p[k]);
+                }
+            }
+            const size_t count = end - begin;
+            node.axis = 0;
+            if (count <= leaf_size)
+            {
+                node.offset = static_cast<uint32_t>(begin);
+                node.count = static_cast<uint32_t>(count);
+                return;
+            }
+
+            // Median split along the widest extent of the points.
+            int axis = 0;
+            for (int k = 1; k < 3; ++k)
+            {
+                if (node.max[k] - node.min[k] > node.max[axis] - node.min[axis])
+                {
+                    axis = k;
+                }
+            }
+            const size_t middle = begin + count / 2;
+            std::nth_element(points.begin() + begin, points.begin() + middle, points.begin() + end, [axis](const Point &a, const Point &b)
+                             { return a.p[axis] < b.p[axis]; });
+            node.axis = static_cast<uint32_t>(axis);
+            node.count = 0;
+            node.offset = static_cast<uint32_t>(index + 1 + subtree_size(middle - begin, leaf_size));
+
+            const size_t second = node.offset;
+            if (count <= PARALLEL_RANGE)
+            {
+                build(points, nodes, begin, middle, index + 1, leaf_size);
+                build(points, nodes, middle, end, second, leaf_size);
+                return;
+            }
+            parallel_for(0, 2, [&](size_t first, size_t last)
+                         {
+                for (size_t child = first; child < last; ++child)
+                {
+                    if (child == 0)
+                    {
+                        build(points, nodes, begin, middle, index + 1, leaf_size);
+                    }
+                    else
+                    {
+                        build(points, nodes, middle, end, second, leaf_size);
+                    }
+                } }, 1);
+        }
+
+        // Moves the low 21 bits of v to every third bit, for interleaving three coordinates.
+        inline uint64_t spread_bits(uint64_t v)
+        {
+            v &= 0x1fffff;
+            v = (v | v << 32) & 0x1f00000000ffffull;
+            v = (v | v << 16) & 0x1f0000ff0000ffull;
+            v = (v | v << 8) & 0x100f00f00f00f00full;
+            v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+            v = (v | v << 2) & 0x1249249249249249ull;
+            return v;
+        }
+
+        inline uint64_t fingerprint(const Point_kd_tree &tree)
+        {
+            uint64_t h = hash_bytes(tree.node_bounds.data(), sizeof(double) * tree.node_bounds.size(), 2);
+            h = hash_bytes(tree.node_links.data(), sizeof(int) * tree.node_links.size(), h);
+            h = hash_bytes(tree.points.data(), sizeof(double) * tree.points.size(), h);
+            return hash_bytes(tree.point_ids.data(), sizeof(int) * tree.point_ids.size(), h);
+        }
+    } // namespace kd_detail
+
+    // In-memory form of a Point_kd_tree used by the queries: cache-line nodes and interleaved points.
+    class PackedKdTree
+    {
+    public:
+        struct Neighbour
+        {
+            int id;
+            double squared_distance;
+
+            // Equally distant points are ordered by id, so results do not depend on the traversal.
+            bool operator<(const Neighbour &other) const
+            {
+                return squared_distance < other.squared_distance ||
+                       (squared_distance == other.squared_distance && id < other.id);
+            }
+        };
+
+        // Content hash of the arrays of tree, recomputed rather than read from tree.key.
+        static uint64_t fingerprint(const Point_kd_tree &tree) { return kd_detail::fingerprint(tree); }
+
+        // Throws std::invalid_argument if the arrays of tree are inconsistent.
+        explicit PackedKdTree(const Point_kd_tree &tree)
+            : PackedKdTree(tree, fingerprint(tree)) {}
+
+        // key must be fingerprint(tree).
+        PackedKdTree(const Point_kd_tree &tree, uint64_t key)
+            : key_(key)
+        {
+            const Eigen::Index num_nodes = tree.node_bounds.rows();
+            const Eigen::Index num_points = tree.points.rows();
+            if (tree.node_links.rows() != num_nodes || (num_nodes > 0 && (tree.node_bounds.cols() != 6 || tree.node_links.cols() != 3)) ||
+                (num_points > 0 && tree.points.cols() != 3) || tree.point_ids.size() != num_points)
+            {
+                throw std::invalid_argument("Inconsistent KD-tree arrays.");
+            }
+
+            nodes_.resize(num_nodes);
+            std::vector<char> valid(num_nodes, 1);
+            parallel_for(0, static_cast<size_t>(num_nodes), [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    kd_detail::Node &node = nodes_[i];
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        node.min[k] = tree.node_bounds(i, k);
+                        node.max[k] = tree.node_bounds(i, 3 + k);
+                    }
+                    const int offset = tree.node_links(i, 0);
+                    const int count = tree.node_links(i, 1);
+                    node.offset = static_cast<uint32_t>(offset);
+                    node.count = static_cast<uint32_t>(count);
+                    node.axis = static_cast<uint32_t>(std::clamp(tree.node_links(i, 2), 0, 2));
+                    // Children must come after their parent, which also rules out cycles.
+                    valid[i] = offset >= 0 && count >= 0 &&
+                               (count > 0 ? static_cast<Eigen::Index>(offset) + count <= num_points
+                                          : static_cast<Eigen::Index>(i) + 1 < num_nodes && offset > static_cast<int>(i) + 1 && offset < num_nodes);
+                } });
+            if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+            {
+                throw std::invalid_argument("KD-tree node links are out of range.");
+            }
+
+            points_.resize(num_points);
+            parallel_for(0, static_cast<size_t>(num_points), [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    points_[i] = kd_detail::Point{{tree.points(i, 0), tree.points(i, 1), tree.points(i, 2)}, static_cast<uint32_t>(tree.point_ids(i))};
+                } });
+        }
+
+        // A node waiting on the traversal stack with the squared distance from the query to its box.
+        struct StackEntry
+        {
+            uint32_t node;
+            double squared_distance;
+        };
+
+        // Replaces neighbours with the k points nearest to q, nearest first (fewer if the tree has
+        // fewer than k points).
+        void knn(const Eigen::Vector3d &q, size_t k, std::vector<Neighbour> &neighbours, std::vector<StackEntry> &stack) const
+        {
+            neighbours.clear();
+            if (nodes_.empty() || k == 0)
+            {
+                return;
+            }
+            double bound = std::numeric_limits<double>::infinity();
+            stack.clear();
+            uint32_t index = 0;
+            while (true)
+            {
+                // Descend to a leaf, always into the nearer child, leaving the farther one on the stack.
+                const kd_detail::Node *node = &nodes_[index];
+                while (node->count == 0)
+                {
+                    StackEntry near{index + 1, box_squared_distance(q, nodes_[index + 1])};
+                    StackEntry far{node->offset, box_squared_distance(q, nodes_[node->offset])};
+                    if (far.squared_distance < near.squared_distance)
+                    {
+                        std::swap(near, far);
+                    }
+                    if (far.squared_distance <= bound)
+                    {
+                        stack.push_back(far);
+                    }
+                    index = near.node;
+                    node = &nodes_[index];
+                }
+
+                for (uint32_t i = node->offset; i < node->offset + node->count; ++i)
+                {
+                    const Neighbour candidate{static_cast<int>(points_[i].id), squared_distance(q, points_[i])};
+                    if (neighbours.size() < k)
+                    {
+                        neighbours.push_back(candidate);
+                    }
+                    else if (candidate < neighbours.back())
+                    {
+                        neighbours.back() = candidate;
+                    }
+                    else
+                    {
+                        continue;
+                    }
+                    // Insertion sort of the new entry; k is small.
+                    for (size_t j = neighbours.size() - 1; j > 0 && neighbours[j] < neighbours[j - 1]; --j)
+                    {
+                        std::swap(neighbours[j], neighbours[j - 1]);
+                    }
+                    if (neighbours.size() == k)
+                    {
+                        bound = neighbours.back().squared_distance;
+                    }
+                }
+
+                // Boxes at exactly the bound may still hold a tie with a smaller id.
+                while (!stack.empty() && stack.back().squared_distance > bound)
+                {
+                    stack.pop_back();
+                }
+                if (stack.empty())
+                {
+                    return;
+                }
+                index = stack.back().node;
+                stack.pop_back();
+            }
+        }
+
+        // Appends the points within radius of q (inclusive), nearest first.
+        void radius_search(const Eigen::Vector3d &q, double radius, std::vector<Neighbour> &neighbours, std::vector<StackEntry> &stack) const
+        {
+            if (nodes_.empty() || !(radius >= 0.0))
+            {
+                return;
+            }
+            const size_t first_result = neighbours.size();
+            const double squared_radius = radius * radius;
+            stack.clear();
+            if (box_squared_distance(q, nodes_[0]) <= squared_radius)
+            {
+                stack.push_back(StackEntry{0, 0.0});
+            }
+            while (!stack.empty())
+            {
+                const kd_detail::Node &node = nodes_[stack.back().node];
+                const uint32_t index = stack.back().node;
+                stack.pop_back();
+                if (node.count > 0)
+                {
+                    for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+                    {
+                        const double d = squared_distance(q, points_[i]);
+                        if (d <= squared_radius)
+                        {
+                            neighbours.push_back(Neighbour{static_cast<int>(points_[i].id), d});
+                        }
+                    }
+                    continue;
+                }
+                for (const uint32_t child : {node.offset, index + 1})
+                {
+                    if (box_squared_distance(q, nodes_[child]) <= squared_radius)
+                    {
+                        stack.push_back(StackEntry{child, 0.0});
+                    }
+                }
+            }
+            std::sort(neighbours.begin() + first_result, neighbours.end());
+        }
+
+        uint64_t key() const { return key_; }
+
+        // Whether this was packed from tree, given its fingerprint.
+        bool matches(const Point_kd_tree &tree, uint64_t key) const
+        {
+            return key_ == key && nodes_.size() == static_cast<size_t>(tree.node_bounds.rows()) &&
+                   points_.size() == static_cast<size_t>(tree.points.rows());
+        }
+
+        size_t memory_usage() const
+        {
+            return sizeof(kd_detail::Node) * nodes_.capacity() + sizeof(kd_detail::Point) * points_.capacity();
+        }
+
+        size_t node_count() const { return nodes_.size(); }
+        size_t point_count() const { return points_.size(); }
+
+    private:
+        static double squared_distance(const Eigen::Vector3d &q, const kd_detail::Point &point)
+        {
+            const double dx = point.p[0] - q.x();
+            const double dy = point.p[1] - q.y();
+            const double dz = point.p[2] - q.z();
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        static double box_squared_distance(const Eigen::Vector3d &q, const kd_detail::Node &node)
+        {
+            double d = 0.0;
+            for (int k = 0; k < 3; ++k)
+            {
+                const double outside = std::max({node.min[k] - q(k), q(k) - node.max[k], 0.0});
+                d += outside * outside;
+            }
+            return d;
+        }
+
+        std::vector<kd_detail::Node> nodes_;
+        std::vector<kd_detail::Point> points_;
+        uint64_t key_;
+    };
+
+    using PackedKdTreeCache = PackedCache<PackedKdTree>;
+
+    // Builds a balanced KD-tree over the rows of positions (n x 3) by median splits along the widest
+    // extent, down to leaves of at most leaf_size points. Large ranges have their halves built
+    // concurrently; the result is independent of the number of threads.
+    // Throws std::invalid_argument if positions is not n x 3.
+    inline Point_kd_tree build_kd_tree(const Eigen::MatrixXd &positions, size_t leaf_size = 8)
+    {
+        if (positions.rows() > 0 && positions.cols() != 3)
+        {
+            throw std::invalid_argument("A KD-tree can only be built over 3D points.");
+        }
+        if (positions.rows() > std::numeric_limits<int>::max())
+        {
+            throw std::invalid_argument("Too many points for a KD-tree.");
+        }
+        leaf_size = std::max<size_t>(1, leaf_size);
+        const size_t num_points = static_cast<size_t>(positions.rows());
+
+        std::vector<kd_detail::Point> points(num_points);
+        parallel_for(0, num_points, [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                points[i] = kd_detail::Point{{positions(i, 0), positions(i, 1), positions(i, 2)}, static_cast<uint32_t>(i)};
+            } });
+        std::vector<kd_detail::Node> nodes(num_points > 0 ? kd_detail::subtree_size(num_points, leaf_size) : 0);
+        if (num_points > 0)
+        {
+            kd_detail::build(points, nodes, 0, num_points, 0, leaf_size);
+        }
+
+        Point_kd_tree tree;
+        tree.node_bounds.resize(nodes.size(), 6);
+        tree.node_links.resize(nodes.size(), 3);
+        parallel_for(0, nodes.size(), [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                tree.node_bounds.row(i) << nodes[i].min[0], nodes[i].min[1], nodes[i].min[2], nodes[i].max[0], nodes[i].max[1], nodes[i].max[2];
+                tree.node_links.row(i) << static_cast<int>(nodes[i].offset), static_cast<int>(nodes[i].count), static_cast<int>(nodes[i].axis);
+            } });
+        tree.points.resize(num_points, 3);
+        tree.point_ids.resize(num_points);
+        parallel_for(0, num_points, [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                tree.points.row(i) << points[i].p[0], points[i].p[1], points[i].p[2];
+                tree.point_ids(i) = static_cast<int>(points[i].id);
+            } });
+        tree.key = kd_detail::fingerprint(tree);
+        return tree;
+    }
+
+    // Permutation of the rows of points (n x 3) that sorts them along a Morton (Z-order) curve over
+    // their bounding box, so that points close in the order are close in space.
+    inline std::vector<uint32_t> morton_order(const Eigen::MatrixXd &points)
+    {
+        const size_t n = static_cast<size_t>(points.rows());
+        std::vector<uint32_t> order(n);
+        if (n == 0)
+        {
+            return order;
+        }
+
+        const Eigen::RowVector3d lo = points.colwise().minCoeff();
+        const Eigen::RowVector3d extent = points.colwise().maxCoeff() - lo;
+        Eigen::RowVector3d scale;
+        for (int k = 0; k < 3; ++k)
+        {
+            scale(k) = extent(k) > 0.0 && std::isfinite(extent(k)) ? kd_detail::MORTON_CELLS / extent(k) : 0.0;
+        }
+        std::vector<std::pair<uint64_t, uint32_t>> keys(n);
+        parallel_for(0, n, [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                uint64_t code = 0;
+                for (int k = 0; k < 3; ++k)
+                {
+                    // NaN lands in cell 0.
+                    const double cell = (points(i, k) - lo(k)) * scale(k);
+                    code |= kd_detail::spread_bits(static_cast<uint64_t>(cell >= 0.0 ? std::min(cell, kd_detail::MORTON_CELLS) : 0.0)) << k;
+                }
+                keys[i] = {code, static_cast<uint32_t>(i)};
+            } });
+        std::sort(keys.begin(), keys.end());
+        for (size_t i = 0; i < n; ++i)
+        {
+            order[i] = keys[i].second;
+        }
+        return order;
+    }
+
+    // Order in which to answer queries at the rows of points: the Morton order, so that consecutive
+    // queries visit the same nodes and points while they are still in cache. Pays off for scattered
+    // query sets; small sets keep their own order.
+    inline std::vector<uint32_t> spatial_query_order(const Eigen::MatrixXd &points)
+    {
+        constexpr size_t min_sorted = 1 << 12;
+        if (points.rows() >= static_cast<Eigen::Index>(min_sorted) && points.cols() == 3)
+        {
+            return morton_order(points);
+        }
+        std::vector<uint32_t> order(points.rows());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = static_cast<uint32_t>(i);
+        }
+        return order;
+    }
+
+    // Runs query(i, neighbours, stack) for every i in order on the shared pool, with one neighbour
+    // buffer and traversal stack per chunk.
+    template <typename QueryFn>
+    void for_each_kd_query(const std::vector<uint32_t> &order, QueryFn &&query)
+    {
+        parallel_for(0, order.size(), [&](size_t begin, size_t end)
+                     {
+            std::vector<PackedKdTree::Neighbour> neighbours;
+            std::vector<PackedKdTree::StackEntry> stack;
+            stack.reserve(64);
+            for (size_t j = begin; j < end; ++j)
+            {
+                query(order[j], neighbours, stack);
+            } }, 256);
+    }
+
+} // namespace MITSU_Domoe
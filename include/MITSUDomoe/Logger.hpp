@@ -1,19 +1,92 @@
 #pragma once
 
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <iomanip>
 #include <sstream>
+#include <string>
 
 namespace MITSU_Domoe {
 
 constexpr int LOG_ID_PADDING = 4;
 
-inline std::filesystem::path initialize_logger() {
+struct LoggerOptions {
+    // Log through a background thread instead of writing on the calling thread.
+    bool async = true;
+    // Number of messages pre-allocated in the async ring buffer. At least one is always allocated.
+    size_t queue_size = 8192;
+    // What to do when the ring buffer is full: block the caller or drop the oldest message.
+    spdlog::async_overflow_policy overflow_policy = spdlog::async_overflow_policy::block;
+    // Period of the background flusher. Zero disables periodic flushing.
+    std::chrono::seconds flush_interval{1};
+    // Messages at or above this level are flushed immediately.
+    spdlog::level::level_enum flush_level = spdlog::level::warn;
+    // Messages below this level are discarded before any formatting happens.
+    spdlog::level::level_enum level = spdlog::level::info;
+
+    // Defaults overridden by the MITSUDOMOE_LOG_* environment variables:
+    //   MITSUDOMOE_LOG_ASYNC=0|1, MITSUDOMOE_LOG_QUEUE_SIZE=<messages>,
+    //   MITSUDOMOE_LOG_OVERFLOW=block|overrun_oldest, MITSUDOMOE_LOG_FLUSH_INTERVAL=<seconds>,
+    //   MITSUDOMOE_LOG_FLUSH_LEVEL=<level>, MITSUDOMOE_LOG_LEVEL=<level>
+    static LoggerOptions from_env() {
+        LoggerOptions options;
+        auto env = [](const char* name) -> std::string {
+            const char* value = std::getenv(name);
+            return value ? value : "";
+        };
+        // spdlog::level::from_str returns off for any name it does not know, so off is only taken when asked for.
+        auto level = [](const std::string& name, spdlog::level::level_enum fallback) {
+            const auto parsed = spdlog::level::from_str(name);
+            if (parsed == spdlog::level::off && name != "off") {
+                std::cout << "Ignoring unknown log level '" << name << "'." << std::endl;
+                return fallback;
+            }
+            return parsed;
+        };
+        try {
+            if (auto value = env("MITSUDOMOE_LOG_ASYNC"); !value.empty()) {
+                options.async = (value != "0" && value != "false");
+            }
+            if (auto value = env("MITSUDOMOE_LOG_QUEUE_SIZE"); !value.empty()) {
+                if (const auto queue_size = std::stoul(value); queue_size > 0) {
+                    options.queue_size = queue_size;
+                } else {
+                    std::cout << "Ignoring log queue size 0; the queue must hold at least one message." << std::endl;
+                }
+            }
+            if (auto value = env("MITSUDOMOE_LOG_OVERFLOW"); !value.empty()) {
+                if (value == "block") {
+                    options.overflow_policy = spdlog::async_overflow_policy::block;
+                } else if (value == "overrun_oldest") {
+                    options.overflow_policy = spdlog::async_overflow_policy::overrun_oldest;
+                } else {
+                    std::cout << "Ignoring unknown log overflow policy '" << value << "'." << std::endl;
+                }
+            }
+            if (auto value = env("MITSUDOMOE_LOG_FLUSH_INTERVAL"); !value.empty()) {
+                options.flush_interval = std::chrono::seconds(std::stol(value));
+            }
+            if (auto value = env("MITSUDOMOE_LOG_FLUSH_LEVEL"); !value.empty()) {
+                options.flush_level = level(value, options.flush_level);
+            }
+            if (auto value = env("MITSUDOMOE_LOG_LEVEL"); !value.empty()) {
+                options.level = level(value, options.level);
+            }
+        } catch (const std::exception& ex) {
+            std::cout << "Ignoring invalid MITSUDOMOE_LOG_* setting: " << ex.what() << std::endl;
+        }
+        return options;
+    }
+};
+
+inline std::filesystem::path initialize_logger(const LoggerOptions& options = {}) {
     try {
         // Get current time
         auto now = std::chrono::system_clock::now();
@@ -33,22 +106,36 @@ inline std::filesystem::path initialize_logger() {
 
         // Create sinks
         auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-        console_sink->set_level(spdlog::level::info);
+        console_sink->set_level(std::max(options.level, spdlog::level::info));
 
         auto file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(log_file.string(), true);
-        file_sink->set_level(spdlog::level::trace);
+        file_sink->set_level(options.level);
 
         // Create logger
         std::vector<spdlog::sink_ptr> sinks{console_sink, file_sink};
-        auto logger = std::make_shared<spdlog::logger>("mitsudomoe_logger", sinks.begin(), sinks.end());
-        logger->set_level(spdlog::level::trace);
-        logger->flush_on(spdlog::level::trace);
+        std::shared_ptr<spdlog::logger> logger;
+        if (options.async) {
+            // A single background thread keeps messages in order.
+            // spdlog cannot run with an empty queue.
+            spdlog::init_thread_pool(std::max<size_t>(options.queue_size, 1), 1);
+            logger = std::make_shared<spdlog::async_logger>("mitsudomoe_logger", sinks.begin(), sinks.end(),
+                                                            spdlog::thread_pool(), options.overflow_policy);
+        } else {
+            logger = std::make_shared<spdlog::logger>("mitsudomoe_logger", sinks.begin(), sinks.end());
+        }
+        logger->set_level(options.level);
+        logger->flush_on(options.flush_level);
 
         // Register logger
         spdlog::register_logger(logger);
         spdlog::set_default_logger(logger);
+        if (options.flush_interval.count() > 0) {
+            spdlog::flush_every(options.flush_interval);
+        }
 
-        spdlog::info("Logger initialized. Log files will be saved to: {}", result_dir.string());
+        spdlog::info("Logger initialized ({}, level {}). Log files will be saved to: {}",
+                     options.async ? "async" : "sync",
+                     spdlog::level::to_string_view(options.level), result_dir.string());
         return result_dir;
     } catch (const spdlog::spdlog_ex& ex) {
         std::cout << "Log initialization failed: " << ex.what() << std::endl;
@@ -56,4 +143,9 @@ inline std::filesystem::path initialize_logger() {
     }
 }
 
+// Drains the async queue and stops the flusher. Call once before the process exits.
+inline void shutdown_logger() {
+    spdlog::shutdown();
+}
+
 } // namespace MITSU_Domoe
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MITSU_Domoe
+{
+
+    // Read-only memory mapping of a whole file. Throws std::runtime_error if the file cannot be mapped.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(const std::filesystem::path &path)
+        {
+#ifdef _WIN32
+            file_handle_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file_handle_ == INVALID_HANDLE_VALUE)
+            {
+                throw std::runtime_error("Failed to open file for mapping: " + path.string());
+            }
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file_handle_, &file_size))
+            {
+                close();
+                throw std::runtime_error("Failed to query file size: " + path.string());
+            }
+            size_ = static_cast<size_t>(file_size.QuadPart);
+            if (size_ == 0)
+            {
+                return;
+            }
+            mapping_handle_ = CreateFileMappingW(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping_handle_)
+            {
+                close();
+                throw std::runtime_error("Failed to create file mapping: " + path.string());
+            }
+            data_ = static_cast<const char *>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+            if (!data_)
+            {
+                close();
+                throw std::runtime_error("Failed to map file: " + path.string());
+            }
+#else
+            fd_ = ::open(path.c_str(), O_RDONLY);
+            if (fd_ < 0)
+            {
+                throw std::runtime_error("Failed to open file for mapping: " + path.string());
+            }
+            struct stat st;
+            if (::fstat(fd_, &st) != 0)
+            {
+                close();
+                throw std::runtime_error("Failed to query file size: " + path.string());
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ == 0)
+            {
+                return;
+            }
+            void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (addr == MAP_FAILED)
+            {
+                close();
+                throw std::runtime_error("Failed to map file: " + path.string());
+            }
+            data_ = static_cast<const char *>(addr);
+#endif
+        }
+
+        ~MappedFile()
+        {
+            close();
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        MappedFile(MappedFile &&other) noexcept
+        {
+            swap(other);
+        }
+
+        MappedFile &operator=(MappedFile &&other) noexcept
+        {
+            if (this != &other)
+            {
+                close();
+                swap(other);
+            }
+            return *this;
+        }
+
+        const char *data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+    private:
+        void swap(MappedFile &other) noexcept
+        {
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+#ifdef _WIN32
+            std::swap(file_handle_, other.file_handle_);
+            std::swap(mapping_handle_, other.mapping_handle_);
+#else
+            std::swap(fd_, other.fd_);
+#endif
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (data_)
+            {
+                UnmapViewOfFile(data_);
+            }
+            if (mapping_handle_)
+            {
+                CloseHandle(mapping_handle_);
+            }
+            if (file_handle_ != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file_handle_);
+            }
+            mapping_handle_ = nullptr;
+            file_handle_ = INVALID_HANDLE_VALUE;
+#else
+            if (data_)
+            {
+                ::munmap(const_cast<char *>(data_), size_);
+            }
+            if (fd_ >= 0)
+            {
+                ::close(fd_);
+            }
+            fd_ = -1;
+#endif
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+#ifdef _WIN32
+        HANDLE file_handle_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_handle_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+    };
+
+} // namespace MITSU_Domoe
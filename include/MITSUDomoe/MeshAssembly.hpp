@@ -0,0 +1,259 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Clustering.hpp"
+#include "MeshCleaning.hpp"
+#include "ThreadPool.hpp"
+#include "VertexWelder.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace assembly_detail
+    {
+        // Rows handed to a task at once by the copy and transform kernels.
+        constexpr size_t BLOCK_SIZE = 1 << 14;
+
+        // out = in M^T + t for rows of 3D points. Every output column is a sum of whole input columns,
+        // so a block of rows is a few contiguous, vectorized multiply-adds over the column-major data.
+        inline Eigen::MatrixXd transform_rows(const Eigen::MatrixXd &in, const Eigen::Matrix3d &M, const Eigen::Vector3d &t)
+        {
+            Eigen::MatrixXd out(in.rows(), 3);
+            parallel_for(0, static_cast<size_t>(in.rows()), [&](size_t begin, size_t end)
+                         {
+                const Eigen::Index first = static_cast<Eigen::Index>(begin);
+                const Eigen::Index count = static_cast<Eigen::Index>(end - begin);
+                for (int i = 0; i < 3; ++i)
+                {
+                    out.col(i).segment(first, count).array() = M(i, 0) * in.col(0).segment(first, count).array() +
+                                                               M(i, 1) * in.col(1).segment(first, count).array() +
+                                                               M(i, 2) * in.col(2).segment(first, count).array() + t(i);
+                } }, BLOCK_SIZE);
+            return out;
+        }
+
+        // Calls fn(part, first, count, row) for every part overlapping the rows [begin, end) of a
+        // concatenation, where part p holds the rows [offsets[p], offsets[p + 1]): its rows
+        // [first, first + count) go to the rows [row, row + count).
+        template <typename Fn>
+        void for_each_part(const std::vector<size_t> &offsets, size_t begin, size_t end, Fn &&fn)
+        {
+            size_t part = static_cast<size_t>(std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin()) - 1;
+            while (begin < end)
+            {
+                const size_t last = std::min(end, offsets[part + 1]);
+                if (begin < last)
+                {
+                    fn(part, static_cast<Eigen::Index>(begin - offsets[part]), static_cast<Eigen::Index>(last - begin), static_cast<Eigen::Index>(begin));
+                }
+                begin = last;
+                ++part;
+            }
+        }
+    } // namespace assembly_detail
+
+    // Applies an affine transform, given as a 4x4 matrix whose last row is (0, 0, 0, 1), to the
+    // vertices of mesh. Normals are transformed by the inverse transpose and renormalized, or dropped
+    // if the transform is singular. A mirroring transform (negative determinant) also reverses the
+    // faces, so that their winding still agrees with their normals.
+    inline Polygon_mesh transform_mesh(const Polygon_mesh &mesh, const Eigen::Matrix4d &transform)
+    {
+        if (transform.row(3) != Eigen::RowVector4d(0.0, 0.0, 0.0, 1.0))
+        {
+            throw std::invalid_argument("The transform must be affine: its last row must be (0, 0, 0, 1).");
+        }
+        if (mesh.V.rows() > 0 && mesh.V.cols() != 3)
+        {
+            throw std::invalid_argument("Expected 3D vertices.");
+        }
+        const Eigen::Matrix3d linear = transform.topLeftCorner<3, 3>();
+        const double determinant = linear.determinant();
+
+        Polygon_mesh result;
+        result.V = assembly_detail::transform_rows(mesh.V, linear, transform.topRightCorner<3, 1>());
+        result.F = mesh.F;
+        if (determinant < 0.0 && result.F.cols() == 3)
+        {
+            result.F.col(1).swap(result.F.col(2));
+        }
+        const std::optional<Normal_kind> normals = valid_normal_kind(mesh);
+        if (normals && determinant != 0.0)
+        {
+            result.N = assembly_detail::transform_rows(mesh.N, linear.inverse().transpose(), Eigen::Vector3d::Zero());
+            result.normal_kind = normals;
+            parallel_for(0, static_cast<size_t>(result.N.rows()), [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const double norm = result.N.row(i).norm();
+                    if (norm > 0.0)
+                    {
+                        result.N.row(i) /= norm;
+                    }
+                } }, assembly_detail::BLOCK_SIZE);
+        }
+        return result;
+    }
+
+    // Concatenates triangle meshes into one. Offsets come from a prefix sum over the parts, and the
+    // vertices, faces and normals are copied in parallel straight into the preallocated result, in
+    // blocks that may span several parts. Normals are kept if every non-empty part has them of the
+    // same kind (per vertex or per face).
+    //
+    // With weld_tolerance >= 0 the parts are also welded at their seams: vertices on boundary edges
+    // (edges used by one face of their part) that coincide or lie within the tolerance are merged,
+    // and the result is then compacted as by clean_mesh, which also drops degenerate and duplicate
+    // faces and unused vertices; the result counts them. Only boundary vertices are ever merged.
+    inline MeshCleanup merge_meshes(const std::vector<Polygon_mesh> &meshes, double weld_tolerance = -1.0)
+    {
+        const size_t num_parts = meshes.size();
+        std::vector<size_t> vertex_offsets(num_parts + 1, 0);
+        std::vector<size_t> face_offsets(num_parts + 1, 0);
+        std::optional<Normal_kind> normals;
+        bool first_part = true;
+        for (size_t p = 0; p < num_parts; ++p)
+        {
+            const Polygon_mesh &mesh = meshes[p];
+            cluster_detail::check_triangle_mesh(mesh);
+            if (mesh.V.rows() > 0 && mesh.V.cols() != 3)
+            {
+                throw std::invalid_argument("Expected 3D vertices.");
+            }
+            vertex_offsets[p + 1] = vertex_offsets[p] + static_cast<size_t>(mesh.V.rows());
+            face_offsets[p + 1] = face_offsets[p] + static_cast<size_t>(mesh.F.rows());
+            if (mesh.V.rows() == 0 && mesh.F.rows() == 0)
+            {
+                continue;
+            }
+            const std::optional<Normal_kind> kind = valid_normal_kind(mesh);
+            normals = first_part || kind == normals ? kind : std::nullopt;
+            first_part = false;
+        }
+        if (vertex_offsets.back() > static_cast<size_t>(INT_MAX))
+        {
+            throw std::invalid_argument("The merged mesh has too many vertices.");
+        }
+
+        Polygon_mesh merged;
+        merged.V.resize(static_cast<Eigen::Index>(vertex_offsets.back()), 3);
+        merged.F.resize(static_cast<Eigen::Index>(face_offsets.back()), 3);
+        if (normals)
+        {
+            merged.N.resize(*normals == Normal_kind::vertex ? merged.V.rows() : merged.F.rows(), 3);
+            merged.normal_kind = normals;
+        }
+        parallel_for(0, vertex_offsets.back(), [&](size_t begin, size_t end)
+                     {
+            assembly_detail::for_each_part(vertex_offsets, begin, end, [&](size_t p, Eigen::Index first, Eigen::Index count, Eigen::Index row)
+                                           {
+                merged.V.middleRows(row, count) = meshes[p].V.middleRows(first, count);
+                if (normals == Normal_kind::vertex)
+                {
+                    merged.N.middleRows(row, count) = meshes[p].N.middleRows(first, count);
+                } }); }, assembly_detail::BLOCK_SIZE);
+        parallel_for(0, face_offsets.back(), [&](size_t begin, size_t end)
+                     {
+            assembly_detail::for_each_part(face_offsets, begin, end, [&](size_t p, Eigen::Index first, Eigen::Index count, Eigen::Index row)
+                                           {
+                merged.F.middleRows(row, count) = (meshes[p].F.middleRows(first, count).array() + static_cast<int>(vertex_offsets[p])).matrix();
+                if (normals == Normal_kind::face)
+                {
+                    merged.N.middleRows(row, count) = meshes[p].N.middleRows(first, count);
+                } }); }, assembly_detail::BLOCK_SIZE);
+
+        if (weld_tolerance < 0.0)
+        {
+            MeshCleanup result;
+            result.mesh = std::move(merged);
+            return result;
+        }
+
+        // Boundary edges are those used by a single face. Parts share no vertices yet, so counting the
+        // uses of every edge of the merged faces finds the boundaries of all parts at once.
+        const size_t num_edges = 3 * static_cast<size_t>(merged.F.rows());
+        std::vector<uint64_t> edge_keys(num_edges);
+        parallel_for(0, num_edges, [&](size_t begin, size_t end)
+                     {
+            for (size_t e = begin; e < end; ++e)
+            {
+                const int a = merged.F(e / 3, e % 3);
+                const int b = merged.F(e / 3, (e + 1) % 3);
+                edge_keys[e] = (static_cast<uint64_t>(std::min(a, b)) << 32) | static_cast<uint64_t>(std::max(a, b));
+            } });
+        const std::vector<uint32_t> first_use = detail::first_occurrences(num_edges, [&edge_keys](size_t e)
+                                                                          { return std::array<uint64_t, 3>{edge_keys[e], 0, 0}; });
+        std::vector<uint32_t> uses(num_edges, 0);
+        parallel_for(0, num_edges, [&](size_t begin, size_t end)
+                     {
+            for (size_t e = begin; e < end; ++e)
+            {
+                std::atomic_ref<uint32_t>(uses[first_use[e]]).fetch_add(1, std::memory_order_relaxed);
+            } });
+        std::vector<char> on_boundary(vertex_offsets.back(), 0);
+        parallel_for(0, num_edges, [&](size_t begin, size_t end)
+                     {
+            for (size_t e = begin; e < end; ++e)
+            {
+                if (uses[first_use[e]] == 1)
+                {
+                    std::atomic_ref<char>(on_boundary[merged.F(e / 3, e % 3)]).store(1, std::memory_order_relaxed);
+                    std::atomic_ref<char>(on_boundary[merged.F(e / 3, (e + 1) % 3)]).store(1, std::memory_order_relaxed);
+                }
+            } });
+
+        // Boundary vertices of every part, in ascending merged index.
+        std::vector<size_t> seam;
+        for (size_t v = 0; v < on_boundary.size(); ++v)
+        {
+            if (on_boundary[v])
+            {
+                seam.push_back(v);
+            }
+        }
+        const WeldResult seam_weld = weld_vertices(seam.size(), [&](size_t i)
+                                                   { return Eigen::Vector3d(merged.V.row(seam[i]).transpose()); }, weld_tolerance);
+
+        // Every vertex off the seam stays on its own. Seam vertices join the lowest vertex of their
+        // cluster, which comes first in merged order since seam is ascending.
+        std::vector<size_t> root(merged.V.rows());
+        parallel_for(0, root.size(), [&](size_t begin, size_t end)
+                     {
+            for (size_t v = begin; v < end; ++v)
+            {
+                root[v] = v;
+            } });
+        parallel_for(0, seam.size(), [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                root[seam[i]] = seam[seam_weld.representatives[seam_weld.remap[i]]];
+            } });
+        WeldResult weld;
+        weld.remap.resize(root.size());
+        for (size_t v = 0; v < root.size(); ++v)
+        {
+            if (root[v] == v)
+            {
+                weld.remap[v] = static_cast<int>(weld.representatives.size());
+                weld.representatives.push_back(v);
+            }
+            else
+            {
+                weld.remap[v] = weld.remap[root[v]];
+            }
+        }
+        return cleaning_detail::rebuild(merged, weld);
+    }
+
+} // namespace MITSU_Domoe
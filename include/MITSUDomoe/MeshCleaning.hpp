@@ -0,0 +1,190 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Clustering.hpp"
+#include "MeshNormals.hpp"
+#include "ThreadPool.hpp"
+#include "VertexWelder.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    struct MeshCleanup
+    {
+        Polygon_mesh mesh;
+        // Vertices merged into others by welding.
+        size_t welded_vertices = 0;
+        // Vertices dropped because no remaining face uses them.
+        size_t unreferenced_vertices = 0;
+        // Faces of zero area after welding, including those that repeat a vertex.
+        size_t degenerate_faces = 0;
+        // Faces with the same three vertices as an earlier face, in either orientation.
+        size_t duplicate_faces = 0;
+    };
+
+    namespace cleaning_detail
+    {
+        // Rebuilds mesh over the vertices given by weld, without degenerate faces, duplicate faces
+        // and vertices no face uses (see clean_mesh).
+        inline MeshCleanup rebuild(const Polygon_mesh &mesh, const WeldResult &weld)
+        {
+            const size_t num_vertices = static_cast<size_t>(mesh.V.rows());
+            const size_t num_faces = static_cast<size_t>(mesh.F.rows());
+            MeshCleanup result;
+            result.welded_vertices = num_vertices - weld.representatives.size();
+
+            // Faces over the welded vertices, each with its corners sorted so that a face and its
+            // duplicates share a key.
+            Eigen::MatrixXi welded(num_faces, 3);
+            std::vector<std::array<uint64_t, 3>> keys(num_faces);
+            std::vector<char> degenerate(num_faces);
+            parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                         {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    std::array<int, 3> corners;
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        corners[j] = weld.remap[mesh.F(f, j)];
+                        welded(f, j) = corners[j];
+                    }
+                    std::sort(corners.begin(), corners.end());
+                    keys[f] = {static_cast<uint64_t>(corners[0]), static_cast<uint64_t>(corners[1]), static_cast<uint64_t>(corners[2])};
+                    if (corners[0] == corners[1] || corners[1] == corners[2])
+                    {
+                        degenerate[f] = 1;
+                        continue;
+                    }
+                    const Eigen::Vector3d p0 = mesh.V.row(weld.representatives[welded(f, 0)]).transpose();
+                    const Eigen::Vector3d p1 = mesh.V.row(weld.representatives[welded(f, 1)]).transpose();
+                    const Eigen::Vector3d p2 = mesh.V.row(weld.representatives[welded(f, 2)]).transpose();
+                    degenerate[f] = (p1 - p0).cross(p2 - p0).squaredNorm() == 0.0;
+                } });
+
+            // A degenerate face repeats a vertex or has zero area, so it never shares a key with a kept
+            // face and cannot make one a duplicate.
+            const std::vector<uint32_t> first = detail::first_occurrences(num_faces, [&keys](size_t f)
+                                                                          { return keys[f]; });
+            keys = {};
+            std::vector<char> used(weld.representatives.size(), 0);
+            parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                         {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    if (degenerate[f] || first[f] != f)
+                    {
+                        continue;
+                    }
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        std::atomic_ref<char>(used[welded(f, j)]).store(1, std::memory_order_relaxed);
+                    }
+                } });
+
+            // Number the remaining faces and vertices in order.
+            std::vector<int> face_row(num_faces, -1);
+            int num_kept_faces = 0;
+            for (size_t f = 0; f < num_faces; ++f)
+            {
+                if (degenerate[f])
+                {
+                    ++result.degenerate_faces;
+                }
+                else if (first[f] != f)
+                {
+                    ++result.duplicate_faces;
+                }
+                else
+                {
+                    face_row[f] = num_kept_faces++;
+                }
+            }
+            std::vector<int> new_index(used.size(), -1);
+            std::vector<size_t> sources;
+            for (size_t v = 0; v < used.size(); ++v)
+            {
+                if (used[v])
+                {
+                    new_index[v] = static_cast<int>(sources.size());
+                    sources.push_back(weld.representatives[v]);
+                }
+            }
+            result.unreferenced_vertices = used.size() - sources.size();
+
+            Polygon_mesh &cleaned = result.mesh;
+            cleaned.V.resize(static_cast<Eigen::Index>(sources.size()), 3);
+            parallel_for(0, sources.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t v = begin; v < end; ++v)
+                {
+                    cleaned.V.row(v) = mesh.V.row(sources[v]);
+                } });
+            cleaned.F.resize(num_kept_faces, 3);
+            const bool face_normals = has_face_normals(mesh);
+            if (face_normals)
+            {
+                cleaned.N.resize(num_kept_faces, 3);
+                cleaned.normal_kind = Normal_kind::face;
+            }
+            parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                         {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    if (face_row[f] < 0)
+                    {
+                        continue;
+                    }
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        cleaned.F(face_row[f], j) = new_index[welded(f, j)];
+                    }
+                    if (face_normals)
+                    {
+                        cleaned.N.row(face_row[f]) = mesh.N.row(f);
+                    }
+                } });
+            if (has_vertex_normals(mesh))
+            {
+                cleaned.N = compute_vertex_normals(cleaned.V, cleaned.F);
+                cleaned.normal_kind = Normal_kind::vertex;
+            }
+            return result;
+        }
+    } // namespace cleaning_detail
+
+    // Cleans up a triangle mesh in a fixed number of parallel passes, each linear in its size:
+    // vertices that coincide, or lie within weld_tolerance of each other, are welded (see
+    // weld_vertices; a negative tolerance skips welding), then degenerate faces and all but the first
+    // of duplicate faces are dropped, and finally vertices no face uses are removed. Remaining
+    // vertices and faces keep their order. Per-face normals are carried over, per-vertex normals are
+    // recomputed for the welded vertices.
+    inline MeshCleanup clean_mesh(const Polygon_mesh &mesh, double weld_tolerance = 0.0)
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        const size_t num_vertices = static_cast<size_t>(mesh.V.rows());
+        WeldResult weld;
+        if (weld_tolerance >= 0.0)
+        {
+            weld = weld_vertices(num_vertices, [&mesh](size_t v)
+                                 { return Eigen::Vector3d(mesh.V.row(v).transpose()); }, weld_tolerance);
+        }
+        else
+        {
+            weld.remap.resize(num_vertices);
+            std::iota(weld.remap.begin(), weld.remap.end(), 0);
+            weld.representatives.resize(num_vertices);
+            std::iota(weld.representatives.begin(), weld.representatives.end(), size_t{0});
+        }
+        return cleaning_detail::rebuild(mesh, weld);
+    }
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+#include "VertexFaces.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+
+namespace MITSU_Domoe
+{
+
+    // Unit normal of every triangle of (V, F), following the corner order; zero for degenerate faces.
+    inline Eigen::MatrixXd compute_face_normals(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F)
+    {
+        Eigen::MatrixXd N(F.rows(), 3);
+        parallel_for(0, static_cast<size_t>(F.rows()), [&](size_t begin, size_t end)
+                     {
+            for (size_t f = begin; f < end; ++f)
+            {
+                const Eigen::Vector3d v0 = V.row(F(f, 0)).transpose();
+                const Eigen::Vector3d v1 = V.row(F(f, 1)).transpose();
+                const Eigen::Vector3d v2 = V.row(F(f, 2)).transpose();
+                const Eigen::Vector3d normal = (v1 - v0).cross(v2 - v0);
+                const double length = normal.norm();
+                N.row(f) = (length > 0.0 ? Eigen::Vector3d(normal / length) : Eigen::Vector3d::Zero()).transpose();
+            } });
+        return N;
+    }
+
+    enum class NormalWeighting
+    {
+        // Each face counts in proportion to its area.
+        area,
+        // Each face counts in proportion to its corner angle at the vertex, which does not depend on
+        // how the surface around the vertex is triangulated.
+        angle,
+    };
+
+    // Unit normal of every vertex of (V, F), the weighted mean of the normals of the faces around it;
+    // zero for vertices without faces or whose face normals cancel out. Every vertex gathers over its
+    // own faces, so the work splits across threads without shared writes and the sums do not depend
+    // on the number of threads. All indices of F must be in [0, V.rows()).
+    inline Eigen::MatrixXd compute_vertex_normals(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
+                                                  NormalWeighting weighting = NormalWeighting::area)
+    {
+        const VertexFaces incidence = vertex_faces(F, V.rows());
+        Eigen::MatrixXd N(V.rows(), 3);
+        parallel_for(0, static_cast<size_t>(V.rows()), [&](size_t begin, size_t end)
+                     {
+            for (size_t v = begin; v < end; ++v)
+            {
+                Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+                for (int i = incidence.offsets[v]; i < incidence.offsets[v + 1]; ++i)
+                {
+                    const int f = incidence.faces[i];
+                    // Corners rotated so that v comes first.
+                    const int j = F(f, 0) == static_cast<int>(v) ? 0 : F(f, 1) == static_cast<int>(v) ? 1 : 2;
+                    const Eigen::Vector3d p = V.row(v).transpose();
+                    const Eigen::Vector3d e1 = V.row(F(f, (j + 1) % 3)).transpose() - p;
+                    const Eigen::Vector3d e2 = V.row(F(f, (j + 2) % 3)).transpose() - p;
+                    // Twice the area times the unit normal.
+                    const Eigen::Vector3d normal = e1.cross(e2);
+                    if (weighting == NormalWeighting::area)
+                    {
+                        sum += normal;
+                        continue;
+                    }
+                    const double length = normal.norm();
+                    if (length > 0.0)
+                    {
+                        sum += std::atan2(length, e1.dot(e2)) / length * normal;
+                    }
+                }
+                const double length = sum.norm();
+                N.row(v) = (length > 0.0 ? Eigen::Vector3d(sum / length) : Eigen::Vector3d::Zero()).transpose();
+            } });
+        return N;
+    }
+
+} // namespace MITSU_Domoe
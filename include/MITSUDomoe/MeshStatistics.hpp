@@ -0,0 +1,277 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    // Summary of one quantity measured over a mesh, with a histogram of its values.
+    struct Value_distribution
+    {
+        uint64_t count = 0;
+        double min = 0.0;
+        double max = 0.0;
+        double mean = 0.0;
+        // Bin i counts the values in [bin_edges(i), bin_edges(i + 1)). Only the bins from the first
+        // to the last non-empty one are kept, and the first is widened over the empty bins after it.
+        Eigen::VectorXd bin_edges;
+        std::vector<uint64_t> bin_counts;
+    };
+
+    struct Mesh_statistics
+    {
+        uint64_t face_count = 0;
+        // Faces of zero area, including those that repeat a vertex.
+        uint64_t degenerate_count = 0;
+        double total_area = 0.0;
+        Value_distribution face_areas;
+        // Every edge of every face, so an edge shared by two faces counts twice.
+        Value_distribution edge_lengths;
+        // Longest edge times perimeter over 4 sqrt(3) area: 1 for an equilateral triangle, growing as
+        // the triangle gets thinner. Degenerate faces are left out.
+        Value_distribution aspect_ratios;
+        // Smallest corner angle in degrees, in [0, 60]. Degenerate faces are left out.
+        Value_distribution min_angles;
+        // Largest distance from the centroid to a corner, the quantity subdividePolygon bounds by r.
+        Value_distribution centroid_radii;
+    };
+
+    namespace statistics_detail
+    {
+        // Faces are reduced in fixed blocks, so sums do not depend on the number of threads.
+        constexpr size_t BLOCK_SIZE = 1 << 16;
+
+        // Logarithmic bins, four per octave from 2^MIN_OCTAVE to 2^MAX_OCTAVE, after an underflow bin
+        // that also holds zero and before an overflow bin. The layout is fixed, so a single pass
+        // fills it without knowing the range of the values first.
+        constexpr int MIN_OCTAVE = -64;
+        constexpr int MAX_OCTAVE = 64;
+        constexpr int BINS_PER_OCTAVE = 4;
+        constexpr int LOG_BINS = (MAX_OCTAVE - MIN_OCTAVE) * BINS_PER_OCTAVE + 2;
+        // 2^(k / 4) for k = 0..3.
+        constexpr double OCTAVE_STEPS[BINS_PER_OCTAVE] = {1.0, 1.189207115002721, 1.4142135623730951, 1.6817928305074290};
+        // One-degree bins over [0, 60] for the smallest angle; 60 itself falls in the last bin.
+        constexpr int ANGLE_BINS = 60;
+
+        inline int log_bin(double value)
+        {
+            if (!(value >= std::ldexp(1.0, MIN_OCTAVE)))
+            {
+                return 0;
+            }
+            if (value >= std::ldexp(1.0, MAX_OCTAVE))
+            {
+                return LOG_BINS - 1;
+            }
+            int exponent;
+            const double mantissa = 2.0 * std::frexp(value, &exponent);
+            const int step = (mantissa >= OCTAVE_STEPS[1]) + (mantissa >= OCTAVE_STEPS[2]) + (mantissa >= OCTAVE_STEPS[3]);
+            return 1 + (exponent - 1 - MIN_OCTAVE) * BINS_PER_OCTAVE + step;
+        }
+
+        inline double log_bin_edge(int bin)
+        {
+            if (bin == 0)
+            {
+                return 0.0;
+            }
+            if (bin == LOG_BINS)
+            {
+                return std::numeric_limits<double>::infinity();
+            }
+            return std::ldexp(OCTAVE_STEPS[(bin - 1) % BINS_PER_OCTAVE], MIN_OCTAVE + (bin - 1) / BINS_PER_OCTAVE);
+        }
+
+        inline int angle_bin(double degrees)
+        {
+            return std::clamp(static_cast<int>(degrees), 0, ANGLE_BINS - 1);
+        }
+
+        inline double angle_bin_edge(int bin)
+        {
+            return static_cast<double>(bin);
+        }
+
+        class Accumulator
+        {
+        public:
+            explicit Accumulator(int num_bins) : bins_(num_bins, 0) {}
+
+            void add(double value, int bin)
+            {
+                ++count_;
+                sum_ += value;
+                min_ = std::min(min_, value);
+                max_ = std::max(max_, value);
+                ++bins_[bin];
+            }
+
+            void merge(const Accumulator &other)
+            {
+                count_ += other.count_;
+                sum_ += other.sum_;
+                min_ = std::min(min_, other.min_);
+                max_ = std::max(max_, other.max_);
+                for (size_t i = 0; i < bins_.size(); ++i)
+                {
+                    bins_[i] += other.bins_[i];
+                }
+            }
+
+            double sum() const { return sum_; }
+
+            template <typename BinEdge>
+            Value_distribution distribution(BinEdge &&bin_edge) const
+            {
+                Value_distribution result;
+                result.count = count_;
+                if (count_ == 0)
+                {
+                    return result;
+                }
+                result.min = min_;
+                result.max = max_;
+                result.mean = sum_ / static_cast<double>(count_);
+                const auto nonzero = [](uint64_t count)
+                { return count != 0; };
+                int first = static_cast<int>(std::find_if(bins_.begin(), bins_.end(), nonzero) - bins_.begin());
+                const int last = static_cast<int>(bins_.rend() - std::find_if(bins_.rbegin(), bins_.rend(), nonzero));
+                // A few zeros (e.g. degenerate faces) would otherwise stretch the histogram over every
+                // empty bin up to the other values, so the first bin is widened over them instead.
+                const int next = static_cast<int>(std::find_if(bins_.begin() + first + 1, bins_.begin() + last, nonzero) - bins_.begin());
+                result.bin_counts.push_back(bins_[first]);
+                result.bin_counts.insert(result.bin_counts.end(), bins_.begin() + next, bins_.begin() + last);
+                result.bin_edges.resize(static_cast<Eigen::Index>(result.bin_counts.size()) + 1);
+                result.bin_edges(0) = bin_edge(first);
+                for (int i = next; i <= last; ++i)
+                {
+                    result.bin_edges(i - next + 1) = bin_edge(i);
+                }
+                return result;
+            }
+
+        private:
+            uint64_t count_ = 0;
+            double sum_ = 0.0;
+            double min_ = std::numeric_limits<double>::infinity();
+            double max_ = -std::numeric_limits<double>::infinity();
+            std::vector<uint64_t> bins_;
+        };
+
+        struct Accumulators
+        {
+            uint64_t degenerate_count = 0;
+            Accumulator face_areas{LOG_BINS};
+            Accumulator edge_lengths{LOG_BINS};
+            Accumulator aspect_ratios{LOG_BINS};
+            Accumulator min_angles{ANGLE_BINS};
+            Accumulator centroid_radii{LOG_BINS};
+
+            void merge(const Accumulators &other)
+            {
+                degenerate_count += other.degenerate_count;
+                face_areas.merge(other.face_areas);
+                edge_lengths.merge(other.edge_lengths);
+                aspect_ratios.merge(other.aspect_ratios);
+                min_angles.merge(other.min_angles);
+                centroid_radii.merge(other.centroid_radii);
+            }
+        };
+    } // namespace statistics_detail
+
+    // Mesh_statistics gathered over one or more batches of triangles (e.g. the chunks of a
+    // Mesh_stream). Every batch is read once: each face is loaded, measured for all quantities and
+    // binned in the same step, in parallel over fixed blocks that are merged in order, so the result
+    // depends on the batches but not on the number of threads.
+    class MeshStatisticsAccumulator
+    {
+    public:
+        // F must index rows of V, which must have 3 columns.
+        void add(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F)
+        {
+            using namespace statistics_detail;
+            const size_t num_faces = static_cast<size_t>(F.rows());
+            const size_t num_blocks = (num_faces + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            std::vector<Accumulators> blocks(num_blocks);
+            parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                         {
+                for (size_t b = begin; b < end; ++b)
+                {
+                    Accumulators &block = blocks[b];
+                    for (size_t f = b * BLOCK_SIZE; f < std::min(num_faces, (b + 1) * BLOCK_SIZE); ++f)
+                    {
+                        const Eigen::Vector3d p[3] = {V.row(F(f, 0)).transpose(), V.row(F(f, 1)).transpose(), V.row(F(f, 2)).transpose()};
+                        // Edge j is opposite corner j.
+                        const Eigen::Vector3d edges[3] = {p[2] - p[1], p[0] - p[2], p[1] - p[0]};
+                        const double lengths[3] = {edges[0].norm(), edges[1].norm(), edges[2].norm()};
+                        const double twice_area = edges[1].cross(edges[2]).norm();
+                        const double area = 0.5 * twice_area;
+                        const Eigen::Vector3d centroid = (p[0] + p[1] + p[2]) / 3.0;
+                        const double radius = std::sqrt(std::max({(p[0] - centroid).squaredNorm(), (p[1] - centroid).squaredNorm(), (p[2] - centroid).squaredNorm()}));
+
+                        block.face_areas.add(area, log_bin(area));
+                        for (const double length : lengths)
+                        {
+                            block.edge_lengths.add(length, log_bin(length));
+                        }
+                        block.centroid_radii.add(radius, log_bin(radius));
+                        if (area == 0.0)
+                        {
+                            ++block.degenerate_count;
+                            continue;
+                        }
+                        const double longest = std::max({lengths[0], lengths[1], lengths[2]});
+                        const double aspect = longest * (lengths[0] + lengths[1] + lengths[2]) / (4.0 * std::sqrt(3.0) * area);
+                        block.aspect_ratios.add(aspect, log_bin(aspect));
+                        // The smallest angle is the one opposite the shortest edge.
+                        const int shortest = static_cast<int>(std::min_element(lengths, lengths + 3) - lengths);
+                        const Eigen::Vector3d &a = edges[(shortest + 1) % 3];
+                        const Eigen::Vector3d &c = edges[(shortest + 2) % 3];
+                        const double degrees = std::atan2(twice_area, -a.dot(c)) * (180.0 / std::numbers::pi);
+                        block.min_angles.add(degrees, angle_bin(degrees));
+                    }
+                } }, 1);
+            face_count_ += num_faces;
+            for (const auto &block : blocks)
+            {
+                totals_.merge(block);
+            }
+        }
+
+        Mesh_statistics result() const
+        {
+            using namespace statistics_detail;
+            Mesh_statistics statistics;
+            statistics.face_count = face_count_;
+            statistics.degenerate_count = totals_.degenerate_count;
+            statistics.total_area = totals_.face_areas.sum();
+            statistics.face_areas = totals_.face_areas.distribution(log_bin_edge);
+            statistics.edge_lengths = totals_.edge_lengths.distribution(log_bin_edge);
+            statistics.aspect_ratios = totals_.aspect_ratios.distribution(log_bin_edge);
+            statistics.min_angles = totals_.min_angles.distribution(angle_bin_edge);
+            statistics.centroid_radii = totals_.centroid_radii.distribution(log_bin_edge);
+            return statistics;
+        }
+
+    private:
+        uint64_t face_count_ = 0;
+        statistics_detail::Accumulators totals_;
+    };
+
+    inline Mesh_statistics mesh_statistics(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F)
+    {
+        MeshStatisticsAccumulator accumulator;
+        accumulator.add(V, F);
+        return accumulator.result();
+    }
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "FastParse.hpp"
+#include "StlReader.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    constexpr uint64_t DEFAULT_CHUNK_TRIANGLES = 1 << 18;
+
+    // A run of consecutive triangles from a Mesh_stream, as an unwelded soup:
+    // V has three rows per triangle and F(i) = (3i, 3i + 1, 3i + 2).
+    struct MeshChunk
+    {
+        uint64_t first_triangle = 0;
+        Eigen::MatrixXd V;
+        Eigen::MatrixXi F;
+    };
+
+    // Inspects the file header without reading the triangles. Throws std::runtime_error on failure,
+    // including for a file that is neither a binary nor an ASCII STL.
+    inline Mesh_stream open_mesh_stream(const std::filesystem::path &path, uint64_t chunk_triangles = DEFAULT_CHUNK_TRIANGLES)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open mesh file: " + path.string());
+        }
+        const uint64_t file_size = std::filesystem::file_size(path);
+
+        Mesh_stream stream;
+        stream.filepath = path.string();
+        stream.chunk_triangles = std::max<uint64_t>(1, chunk_triangles);
+
+        // Enough for the binary header, or for the "solid" line of an ASCII file and the token after it.
+        std::vector<char> head(static_cast<size_t>(std::min<uint64_t>(file_size, 1 << 16)));
+        if (!file.read(head.data(), static_cast<std::streamsize>(head.size())))
+        {
+            throw std::runtime_error("Failed to read mesh file: " + path.string());
+        }
+        if (head.size() >= stl_detail::HEADER_SIZE + 4 && stl_detail::is_binary(head.data(), file_size))
+        {
+            stream.format = "stl_binary";
+            stream.triangle_count = stl_detail::load_uint32_le(head.data() + stl_detail::HEADER_SIZE);
+            return stream;
+        }
+        if (!stl_detail::starts_like_ascii(head.data(), head.data() + head.size()))
+        {
+            throw std::runtime_error("Not a binary or ASCII STL file: " + path.string());
+        }
+        stream.format = "stl_ascii";
+        return stream;
+    }
+
+    // Reads a Mesh_stream one chunk at a time. Memory use is bounded by the chunk size, not the file size.
+    class MeshStreamReader
+    {
+    public:
+        explicit MeshStreamReader(const Mesh_stream &stream)
+            : stream_(stream), file_(stream.filepath, std::ios::binary)
+        {
+            if (!file_)
+            {
+                throw std::runtime_error("Failed to open mesh stream: " + stream.filepath);
+            }
+            if (stream_.chunk_triangles == 0)
+            {
+                stream_.chunk_triangles = DEFAULT_CHUNK_TRIANGLES;
+            }
+            if (stream_.format == "stl_binary")
+            {
+                file_.seekg(stl_detail::HEADER_SIZE + 4);
+            }
+            else if (stream_.format != "stl_ascii")
+            {
+                throw std::runtime_error("Unsupported mesh stream format: " + stream_.format);
+            }
+        }
+
+        // Fills chunk with the next triangles. Returns false once the stream is exhausted.
+        bool next(MeshChunk &chunk)
+        {
+            const size_t count = stream_.format == "stl_binary" ? read_binary() : read_ascii();
+            if (count == 0)
+            {
+                return false;
+            }
+
+            chunk.first_triangle = triangles_read_;
+            triangles_read_ += count;
+            chunk.V.resize(3 * count, 3);
+            chunk.F.resize(count, 3);
+            parallel_for(0, count, [&](size_t begin, size_t end)
+                         {
+                for (size_t t = begin; t < end; ++t)
+                {
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        const size_t c = 3 * t + k;
+                        chunk.V.row(c) << coordinates_[3 * c], coordinates_[3 * c + 1], coordinates_[3 * c + 2];
+                        chunk.F(t, k) = static_cast<int>(c);
+                    }
+                } });
+            return true;
+        }
+
+        uint64_t triangles_read() const { return triangles_read_; }
+
+    private:
+        size_t read_binary()
+        {
+            const uint64_t remaining = stream_.triangle_count - triangles_read_;
+            const size_t count = static_cast<size_t>(std::min(remaining, stream_.chunk_triangles));
+            if (count == 0)
+            {
+                return 0;
+            }
+            buffer_.resize(count * stl_detail::TRIANGLE_SIZE);
+            if (!file_.read(buffer_.data(), buffer_.size()))
+            {
+                throw std::runtime_error("Mesh stream ended early: " + stream_.filepath);
+            }
+            coordinates_.resize(9 * count);
+            parallel_for(0, count, [&](size_t begin, size_t end)
+                         {
+                for (size_t t = begin; t < end; ++t)
+                {
+                    const char *vertices = buffer_.data() + t * stl_detail::TRIANGLE_SIZE + 12;
+                    for (size_t k = 0; k < 9; ++k)
+                    {
+                        coordinates_[9 * t + k] = stl_detail::load_float_le(vertices + 4 * k);
+                    }
+                } });
+            return count;
+        }
+
+        size_t read_ascii()
+        {
+            namespace fp = fast_parse;
+            coordinates_.clear();
+            std::string line;
+            while (coordinates_.size() < 9 * stream_.chunk_triangles && std::getline(file_, line))
+            {
+                const char *p = line.data();
+                const char *end = p + line.size();
+                if (fp::next_token(p, end) != "vertex")
+                {
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    float value;
+                    p = fp::parse_number(p, end, value);
+                    if (!p)
+                    {
+                        throw std::runtime_error("Malformed vertex in ASCII STL stream: " + stream_.filepath);
+                    }
+                    coordinates_.push_back(value);
+                }
+            }
+            if (coordinates_.size() % 9 != 0)
+            {
+                throw std::runtime_error("ASCII STL vertex count is not a multiple of three: " + stream_.filepath);
+            }
+            return coordinates_.size() / 9;
+        }
+
+        Mesh_stream stream_;
+        std::ifstream file_;
+        std::vector<char> buffer_;
+        std::vector<float> coordinates_;
+        uint64_t triangles_read_ = 0;
+    };
+
+    // Calls fn(const MeshChunk&) for every chunk of the stream, in order. Returns the number of triangles read.
+    template <typename Fn>
+    uint64_t for_each_mesh_chunk(const Mesh_stream &stream, Fn &&fn)
+    {
+        MeshStreamReader reader(stream);
+        MeshChunk chunk;
+        while (reader.next(chunk))
+        {
+            fn(static_cast<const MeshChunk &>(chunk));
+        }
+        return reader.triangles_read();
+    }
+
+} // namespace MITSU_Domoe
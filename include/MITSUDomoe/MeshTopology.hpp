@@ -0,0 +1,177 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+#include "VertexFaces.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    // Connectivity of a triangle mesh, built in parallel from its faces alone. Half-edge 3 f + j runs
+    // from corner j of face f to corner (j + 1) % 3. Everything is ordered by index, so the result does
+    // not depend on the number of threads.
+    class MeshTopology
+    {
+    public:
+        // Faces around every vertex.
+        VertexFaces vertex_faces;
+        // Every edge once, as (lower, higher) vertex index, sorted. Half-edges whose ends coincide
+        // (degenerate faces) have no edge.
+        std::vector<std::array<int, 2>> edges;
+        // The edges whose lower vertex is v are edges[lower_edge_offsets[v], lower_edge_offsets[v + 1]).
+        std::vector<int> lower_edge_offsets;
+        // Edge of every half-edge, or -1.
+        std::vector<int> half_edge_edges;
+        // Half-edges on edge e, ascending: edge_half_edges[edge_offsets[e], edge_offsets[e + 1]).
+        // One means a boundary edge, more than two a non-manifold one.
+        std::vector<int> edge_offsets;
+        std::vector<int> edge_half_edges;
+        // The other half-edge of a manifold interior edge, or -1.
+        std::vector<int> twins;
+
+        // Cached per mesh by MeshDerivedData::topology (see DerivedData.hpp).
+        MeshTopology(const Eigen::MatrixXi &F, Eigen::Index vertex_count)
+            : vertex_faces(MITSU_Domoe::vertex_faces(F, vertex_count)), num_faces_(F.rows())
+        {
+            const size_t num_vertices = static_cast<size_t>(vertex_count);
+            const size_t num_half_edges = 3 * static_cast<size_t>(F.rows());
+
+            // Every half-edge is handled by its lower end, so the passes below write without conflicts.
+            auto for_each_upper_half_edge = [&](int v, auto &&fn)
+            {
+                int previous = -1;
+                for (int i = vertex_faces.offsets[v]; i < vertex_faces.offsets[v + 1]; ++i)
+                {
+                    const int f = vertex_faces.faces[i];
+                    // A face that uses v twice is listed twice.
+                    if (f == previous)
+                    {
+                        continue;
+                    }
+                    previous = f;
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        const int a = F(f, j);
+                        const int b = F(f, (j + 1) % 3);
+                        if (std::min(a, b) == v && a != b)
+                        {
+                            fn(std::max(a, b), 3 * f + j);
+                        }
+                    }
+                }
+            };
+
+            // The half-edges of every vertex, as (higher end, half-edge) sorted. Read in vertex
+            // order, they are grouped by edge in edge order, which is edge_half_edges itself.
+            std::vector<int> half_edge_offsets(num_vertices + 1, 0);
+            parallel_for(0, num_vertices, [&](size_t begin, size_t end)
+                         {
+                for (size_t v = begin; v < end; ++v)
+                {
+                    for_each_upper_half_edge(static_cast<int>(v), [&](int, int) { ++half_edge_offsets[v + 1]; });
+                } });
+            for (size_t v = 0; v < num_vertices; ++v)
+            {
+                half_edge_offsets[v + 1] += half_edge_offsets[v];
+            }
+            std::vector<std::pair<int, int>> upper_half_edges(half_edge_offsets.back());
+            lower_edge_offsets.assign(num_vertices + 1, 0);
+            parallel_for(0, num_vertices, [&](size_t begin, size_t end)
+                         {
+                for (size_t v = begin; v < end; ++v)
+                {
+                    const auto first = upper_half_edges.begin() + half_edge_offsets[v];
+                    const auto last = upper_half_edges.begin() + half_edge_offsets[v + 1];
+                    auto slot = first;
+                    for_each_upper_half_edge(static_cast<int>(v), [&](int w, int h) { *slot++ = {w, h}; });
+                    std::sort(first, last);
+                    for (auto it = first; it != last; ++it)
+                    {
+                        lower_edge_offsets[v + 1] += it == first || it->first != (it - 1)->first;
+                    }
+                } });
+            for (size_t v = 0; v < num_vertices; ++v)
+            {
+                lower_edge_offsets[v + 1] += lower_edge_offsets[v];
+            }
+
+            edges.resize(lower_edge_offsets.back());
+            edge_offsets.resize(edges.size() + 1);
+            edge_offsets.back() = half_edge_offsets.back();
+            edge_half_edges.resize(upper_half_edges.size());
+            half_edge_edges.assign(num_half_edges, -1);
+            twins.assign(num_half_edges, -1);
+            parallel_for(0, num_vertices, [&](size_t begin, size_t end)
+                         {
+                for (size_t v = begin; v < end; ++v)
+                {
+                    int e = lower_edge_offsets[v] - 1;
+                    for (int i = half_edge_offsets[v]; i < half_edge_offsets[v + 1]; ++i)
+                    {
+                        if (i == half_edge_offsets[v] || upper_half_edges[i].first != upper_half_edges[i - 1].first)
+                        {
+                            edges[++e] = {static_cast<int>(v), upper_half_edges[i].first};
+                            edge_offsets[e] = i;
+                        }
+                        half_edge_edges[upper_half_edges[i].second] = e;
+                        edge_half_edges[i] = upper_half_edges[i].second;
+                    }
+                } });
+            parallel_for(0, edges.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t e = begin; e < end; ++e)
+                {
+                    if (edge_offsets[e + 1] - edge_offsets[e] == 2)
+                    {
+                        twins[edge_half_edges[edge_offsets[e]]] = edge_half_edges[edge_offsets[e] + 1];
+                        twins[edge_half_edges[edge_offsets[e] + 1]] = edge_half_edges[edge_offsets[e]];
+                    }
+                } });
+        }
+
+        size_t num_vertices() const { return vertex_faces.offsets.size() - 1; }
+        size_t num_faces() const { return static_cast<size_t>(num_faces_); }
+
+        // Index of the edge between a and b, or -1.
+        int find_edge(int a, int b) const
+        {
+            if (a > b)
+            {
+                std::swap(a, b);
+            }
+            if (a == b)
+            {
+                return -1;
+            }
+            const auto first = edges.begin() + lower_edge_offsets[a];
+            const auto last = edges.begin() + lower_edge_offsets[a + 1];
+            const auto it = std::lower_bound(first, last, b, [](const std::array<int, 2> &edge, int v)
+                                             { return edge[1] < v; });
+            return it != last && (*it)[1] == b ? static_cast<int>(it - edges.begin()) : -1;
+        }
+
+        int edge_face_count(int e) const { return edge_offsets[e + 1] - edge_offsets[e]; }
+        bool is_boundary_edge(int e) const { return edge_face_count(e) == 1; }
+
+        static int face_of(int h) { return h / 3; }
+        static int next_half_edge(int h) { return h - h % 3 + (h % 3 + 1) % 3; }
+        static int previous_half_edge(int h) { return h - h % 3 + (h % 3 + 2) % 3; }
+
+        size_t memory_usage() const
+        {
+            return sizeof(int) * (vertex_faces.offsets.size() + vertex_faces.faces.size() + 2 * edges.size() +
+                                  lower_edge_offsets.size() + half_edge_edges.size() + edge_offsets.size() +
+                                  edge_half_edges.size() + twins.size());
+        }
+
+    private:
+        Eigen::Index num_faces_;
+    };
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace writer_detail
+    {
+        constexpr size_t CHUNK_BYTES = 16 << 20;
+
+        // Stores an arithmetic value in little-endian byte order.
+        template <typename T>
+        void store_le(char *p, T value)
+        {
+            if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+            {
+                auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+                std::reverse(bytes.begin(), bytes.end());
+                std::memcpy(p, bytes.data(), sizeof(T));
+            }
+            else
+            {
+                std::memcpy(p, &value, sizeof(T));
+            }
+        }
+
+        inline std::ofstream open_output(const std::filesystem::path &path)
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                throw std::runtime_error("Failed to open file for writing: " + path.string());
+            }
+            return out;
+        }
+
+        inline void finish_output(std::ofstream &out, const std::filesystem::path &path)
+        {
+            out.close();
+            if (!out)
+            {
+                throw std::runtime_error("Failed to write file: " + path.string());
+            }
+        }
+
+        // Writes count fixed-size records. encode(first, last, out) fills the records [first, last)
+        // into out. Records are encoded in chunks of about CHUNK_BYTES on the shared pool while the
+        // previous chunk is written by a separate thread, so encoding overlaps with the disk write.
+        template <typename EncodeFn>
+        void write_records(std::ofstream &out, size_t count, size_t record_size, EncodeFn &&encode)
+        {
+            const size_t chunk_records = std::max<size_t>(1, CHUNK_BYTES / record_size);
+            std::vector<char> buffers[2];
+            std::future<void> pending;
+            for (size_t first = 0, chunk = 0; first < count; first += chunk_records, ++chunk)
+            {
+                const size_t last = std::min(count, first + chunk_records);
+                // The write of chunk - 2 from this buffer finished before chunk - 1 was handed over.
+                std::vector<char> &buffer = buffers[chunk % 2];
+                buffer.resize((last - first) * record_size);
+                parallel_for(first, last, [&](size_t begin, size_t end)
+                             { encode(begin, end, buffer.data() + (begin - first) * record_size); }, 1 << 12);
+                if (pending.valid())
+                {
+                    pending.get();
+                }
+                pending = std::async(std::launch::async, [&out, &buffer]
+                                     { out.write(buffer.data(), static_cast<std::streamsize>(buffer.size())); });
+            }
+            if (pending.valid())
+            {
+                pending.get();
+            }
+        }
+
+        inline void check_triangle_mesh(const Polygon_mesh &mesh)
+        {
+            if (mesh.V.cols() != 3 || (mesh.F.rows() > 0 && mesh.F.cols() != 3))
+            {
+                throw std::invalid_argument("Only triangle meshes with 3D vertices can be written.");
+            }
+            if (mesh.F.size() > 0 && (mesh.F.minCoeff() < 0 || mesh.F.maxCoeff() >= mesh.V.rows()))
+            {
+                throw std::invalid_argument("Face index out of range.");
+            }
+        }
+    } // namespace writer_detail
+
+    // Writes a binary STL file. Facet normals are computed from the vertices.
+    // Returns the number of bytes written; throws if the mesh is invalid or the file cannot be written.
+    inline uint64_t write_stl(const std::filesystem::path &path, const Polygon_mesh &mesh)
+    {
+        using namespace writer_detail;
+        constexpr size_t HEADER_SIZE = 80;
+        constexpr size_t TRIANGLE_SIZE = 50;
+
+        check_triangle_mesh(mesh);
+        const size_t num_faces = static_cast<size_t>(mesh.F.rows());
+        if (num_faces > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::invalid_argument("Binary STL cannot hold more than 2^32 - 1 triangles.");
+        }
+
+        std::ofstream out = open_output(path);
+        char header[HEADER_SIZE + 4] = "binary STL written by MITSUDomoe";
+        store_le<uint32_t>(header + HEADER_SIZE, static_cast<uint32_t>(num_faces));
+        out.write(header, sizeof(header));
+
+        write_records(out, num_faces, TRIANGLE_SIZE, [&](size_t begin, size_t end, char *p)
+                      {
+            for (size_t f = begin; f < end; ++f, p += TRIANGLE_SIZE)
+            {
+                const Eigen::Vector3d v[3] = {mesh.V.row(mesh.F(f, 0)).transpose(), mesh.V.row(mesh.F(f, 1)).transpose(),
+                                              mesh.V.row(mesh.F(f, 2)).transpose()};
+                const Eigen::Vector3d normal = (v[1] - v[0]).cross(v[2] - v[0]).stableNormalized();
+                for (int k = 0; k < 3; ++k)
+                {
+                    store_le<float>(p + 4 * k, static_cast<float>(normal(k)));
+                }
+                for (int c = 0; c < 3; ++c)
+                {
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        store_le<float>(p + 12 + 12 * c + 4 * k, static_cast<float>(v[c](k)));
+                    }
+                }
+                store_le<uint16_t>(p + 48, 0);
+            } });
+
+        finish_output(out, path);
+        return HEADER_SIZE + 4 + num_faces * TRIANGLE_SIZE;
+    }
+
+    // Writes a binary little-endian PLY file with vertex positions (float, or double if
+    // double_precision is set) and triangle faces. Returns the number of bytes written; throws if the
+    // mesh is invalid or the file cannot be written.
+    inline uint64_t write_ply(const std::filesystem::path &path, const Polygon_mesh &mesh, bool double_precision = false)
+    {
+        using namespace writer_detail;
+        constexpr size_t FACE_SIZE = 1 + 3 * sizeof(int32_t);
+
+        check_triangle_mesh(mesh);
+        const size_t num_vertices = static_cast<size_t>(mesh.V.rows());
+        const size_t num_faces = static_cast<size_t>(mesh.F.rows());
+        const std::string scalar = double_precision ? "double" : "float";
+        const size_t vertex_size = 3 * (double_precision ? sizeof(double) : sizeof(float));
+
+        std::ofstream out = open_output(path);
+        const std::string header = "ply\nformat binary_little_endian 1.0\ncomment written by MITSUDomoe\n"
+                                   "element vertex " + std::to_string(num_vertices) + "\n"
+                                   "property " + scalar + " x\nproperty " + scalar + " y\nproperty " + scalar + " z\n"
+                                   "element face " + std::to_string(num_faces) + "\n"
+                                   "property list uchar int vertex_indices\nend_header\n";
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+        write_records(out, num_vertices, vertex_size, [&](size_t begin, size_t end, char *p)
+                      {
+            for (size_t v = begin; v < end; ++v)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (double_precision)
+                    {
+                        store_le<double>(p, mesh.V(v, k));
+                        p += sizeof(double);
+                    }
+                    else
+                    {
+                        store_le<float>(p, static_cast<float>(mesh.V(v, k)));
+                        p += sizeof(float);
+                    }
+                }
+            } });
+        write_records(out, num_faces, FACE_SIZE, [&](size_t begin, size_t end, char *p)
+                      {
+            for (size_t f = begin; f < end; ++f, p += FACE_SIZE)
+            {
+                *p = 3;
+                for (int k = 0; k < 3; ++k)
+                {
+                    store_le<int32_t>(p + 1 + 4 * k, mesh.F(f, k));
+                }
+            } });
+
+        finish_output(out, path);
+        return header.size() + num_vertices * vertex_size + num_faces * FACE_SIZE;
+    }
+
+} // namespace MITSU_Domoe
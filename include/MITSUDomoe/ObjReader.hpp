@@ -0,0 +1,206 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "FastParse.hpp"
+#include "MappedFile.hpp"
+#include "MeshNormals.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace obj_detail
+    {
+        constexpr size_t MIN_BLOCK_SIZE = 1 << 20;
+
+        enum class LineKind
+        {
+            Other,
+            Vertex,
+            Face
+        };
+
+        inline const char *line_end(const char *p, const char *end)
+        {
+            const void *newline = std::memchr(p, '\n', static_cast<size_t>(end - p));
+            return newline ? static_cast<const char *>(newline) : end;
+        }
+
+        // Recognizes "v" and "f" lines and moves p past the keyword. Texture coordinates ("vt"),
+        // normals ("vn"), groups, materials and comments are Other.
+        inline LineKind classify(const char *&p, const char *end)
+        {
+            p = fast_parse::skip_blanks(p, end);
+            if (p == end || (*p != 'v' && *p != 'f'))
+            {
+                return LineKind::Other;
+            }
+            if (p + 1 != end && !fast_parse::is_space(p[1]))
+            {
+                return LineKind::Other;
+            }
+            return *p++ == 'v' ? LineKind::Vertex : LineKind::Face;
+        }
+
+        // Next face corner token ("i", "i/t", "i//n" or "i/t/n"), or an empty view at the end of
+        // the line or at a trailing comment.
+        inline std::string_view next_corner(const char *&p, const char *end)
+        {
+            const std::string_view token = fast_parse::next_token(p, end);
+            return !token.empty() && token.front() == '#' ? std::string_view() : token;
+        }
+
+        // Splits [data, data + size) into up to max_blocks ranges that each start at a line beginning.
+        inline std::vector<const char *> split_at_lines(const char *data, size_t size, size_t max_blocks)
+        {
+            const size_t num_blocks = std::clamp<size_t>(size / MIN_BLOCK_SIZE, 1, max_blocks);
+            const char *end = data + size;
+            std::vector<const char *> bounds{data};
+            for (size_t b = 1; b < num_blocks; ++b)
+            {
+                const char *cut = std::max(data + size / num_blocks * b, bounds.back());
+                cut = cut < end ? line_end(cut, end) : end;
+                bounds.push_back(cut < end ? cut + 1 : end);
+            }
+            bounds.push_back(end);
+            return bounds;
+        }
+    } // namespace obj_detail
+
+    // Reads the vertices and faces of a Wavefront OBJ file through a memory mapping.
+    // The file is cut into blocks at line boundaries that are parsed on the shared thread pool in
+    // two passes: the first counts vertices and triangles per block, the second writes them straight
+    // into the preallocated V and F at the offsets given by the prefix sums of those counts.
+    // Polygons are fan-triangulated; negative (relative) indices are resolved against the vertices
+    // defined before the face. Texture coordinates, normals and groups are ignored, and N receives
+    // the unit normal of every triangle.
+    // Throws std::runtime_error if the file cannot be read or an index is out of range.
+    inline Polygon_mesh read_obj(const std::filesystem::path &path)
+    {
+        namespace fp = fast_parse;
+        using obj_detail::LineKind;
+
+        const MappedFile file(path);
+        const char *end = file.data() + file.size();
+        const std::vector<const char *> bounds = obj_detail::split_at_lines(file.data(), file.size(), ThreadPool::shared().size() * 4);
+        const size_t num_blocks = bounds.size() - 1;
+
+        // 1. Count vertices and triangles per block.
+        std::vector<size_t> vertex_offset(num_blocks + 1, 0);
+        std::vector<size_t> triangle_offset(num_blocks + 1, 0);
+        parallel_for(0, num_blocks, [&](size_t begin, size_t last)
+                     {
+            for (size_t b = begin; b < last; ++b)
+            {
+                size_t vertices = 0;
+                size_t triangles = 0;
+                for (const char *p = bounds[b]; p < bounds[b + 1];)
+                {
+                    const char *eol = obj_detail::line_end(p, end);
+                    const LineKind kind = obj_detail::classify(p, eol);
+                    if (kind == LineKind::Vertex)
+                    {
+                        ++vertices;
+                    }
+                    else if (kind == LineKind::Face)
+                    {
+                        size_t corners = 0;
+                        while (!obj_detail::next_corner(p, eol).empty())
+                        {
+                            ++corners;
+                        }
+                        triangles += corners >= 3 ? corners - 2 : 0;
+                    }
+                    p = eol < end ? eol + 1 : end;
+                }
+                vertex_offset[b + 1] = vertices;
+                triangle_offset[b + 1] = triangles;
+            } }, 1);
+        for (size_t b = 0; b < num_blocks; ++b)
+        {
+            vertex_offset[b + 1] += vertex_offset[b];
+            triangle_offset[b + 1] += triangle_offset[b];
+        }
+
+        const size_t num_vertices = vertex_offset.back();
+        Polygon_mesh mesh;
+        mesh.V.resize(num_vertices, 3);
+        mesh.F.resize(triangle_offset.back(), 3);
+
+        // 2. Parse into place.
+        parallel_for(0, num_blocks, [&](size_t begin, size_t last)
+                     {
+            for (size_t b = begin; b < last; ++b)
+            {
+                size_t v = vertex_offset[b];
+                size_t t = triangle_offset[b];
+                auto resolve = [&](std::string_view corner)
+                {
+                    long long index = 0;
+                    if (!fp::parse_number(corner.data(), corner.data() + corner.size(), index) || index == 0)
+                    {
+                        throw std::runtime_error("Malformed face in OBJ file: " + path.string());
+                    }
+                    // Relative indices count back from the last vertex defined so far.
+                    const long long resolved = index > 0 ? index - 1 : static_cast<long long>(v) + index;
+                    if (resolved < 0 || resolved >= static_cast<long long>(num_vertices))
+                    {
+                        throw std::runtime_error("Face index out of range in OBJ file: " + path.string());
+                    }
+                    return static_cast<int>(resolved);
+                };
+
+                for (const char *p = bounds[b]; p < bounds[b + 1];)
+                {
+                    const char *eol = obj_detail::line_end(p, end);
+                    const LineKind kind = obj_detail::classify(p, eol);
+                    if (kind == LineKind::Vertex)
+                    {
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            double value;
+                            p = fp::parse_number(p, eol, value);
+                            if (!p)
+                            {
+                                throw std::runtime_error("Malformed vertex in OBJ file: " + path.string());
+                            }
+                            mesh.V(v, k) = value;
+                        }
+                        ++v;
+                    }
+                    else if (kind == LineKind::Face)
+                    {
+                        std::string_view corner = obj_detail::next_corner(p, eol);
+                        if (!corner.empty())
+                        {
+                            const int first = resolve(corner);
+                            int previous = -1;
+                            while (!(corner = obj_detail::next_corner(p, eol)).empty())
+                            {
+                                const int current = resolve(corner);
+                                if (previous >= 0)
+                                {
+                                    mesh.F.row(t++) << first, previous, current;
+                                }
+                                previous = current;
+                            }
+                        }
+                    }
+                    p = eol < end ? eol + 1 : end;
+                }
+            } }, 1);
+
+        mesh.N = compute_face_normals(mesh.V, mesh.F);
+        mesh.normal_kind = Normal_kind::face;
+        return mesh;
+    }
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace MITSU_Domoe
+{
+
+    // Process-wide cache of unpacked acceleration structures (PackedBvh, PackedKdTree). Query
+    // commands receive the structure as a deserialized result; the cache saves them from validating
+    // and repacking it on every call. Packed must provide a static fingerprint(const Source &) that
+    // hashes the serialized arrays, a constructor from the Source and its fingerprint, key(),
+    // matches(const Source &, uint64_t fingerprint), which also compares the array sizes, and
+    // memory_usage(). Entries are found by the fingerprint of the data itself, never by the key
+    // field a result carries, and the least recently used ones are evicted to stay within a memory
+    // budget. A structure larger than the whole budget is returned but not kept. Quantities derived
+    // from meshes live in DerivedDataCache instead (see DerivedData.hpp).
+    template <typename Packed>
+    class PackedCache
+    {
+    public:
+        static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(1) << 30;
+
+        static PackedCache &shared()
+        {
+            static PackedCache cache;
+            return cache;
+        }
+
+        template <typename Source>
+        std::shared_ptr<const Packed> get(const Source &source)
+        {
+            const uint64_t key = Packed::fingerprint(source);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto it = entries_.begin(); it != entries_.end(); ++it)
+                {
+                    if (it->packed->matches(source, key))
+                    {
+                        entries_.splice(entries_.begin(), entries_, it);
+                        return entries_.front().packed;
+                    }
+                }
+            }
+            auto packed = std::make_shared<const Packed>(source, key);
+            insert(packed);
+            return packed;
+        }
+
+        void insert(std::shared_ptr<const Packed> packed)
+        {
+            const size_t bytes = packed->memory_usage();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (bytes > memory_budget_)
+            {
+                return;
+            }
+            entries_.push_front(Entry{std::move(packed), bytes});
+            memory_usage_ += bytes;
+            evict();
+        }
+
+        void set_memory_budget(size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            memory_budget_ = bytes;
+            evict();
+        }
+
+        size_t memory_usage() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return memory_usage_;
+        }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<const Packed> packed;
+            size_t bytes;
+        };
+
+        PackedCache() = default;
+
+        void evict()
+        {
+            while (memory_usage_ > memory_budget_ && !entries_.empty())
+            {
+                memory_usage_ -= entries_.back().bytes;
+                entries_.pop_back();
+            }
+        }
+
+        mutable std::mutex mutex_;
+        std::list<Entry> entries_;
+        size_t memory_usage_ = 0;
+        size_t memory_budget_ = DEFAULT_MEMORY_BUDGET;
+    };
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,533 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Clustering.hpp"
+#include "DerivedData.hpp"
+#include "MeshTopology.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef MITSUDOMOE_USE_METIS
+#include <metis.h>
+#endif
+
+namespace MITSU_Domoe
+{
+
+    namespace partition_detail
+    {
+        // Coarsening stops at about this many nodes per part.
+        constexpr size_t COARSE_NODES_PER_PART = 16;
+        constexpr size_t MIN_COARSE_NODES = 256;
+        constexpr int REFINEMENT_PASSES = 6;
+
+        // Weighted undirected graph in CSR form. Each node also carries the weighted sum of the
+        // positions it stands for, which the initial geometric partition uses.
+        struct Graph
+        {
+            std::vector<int> offsets;
+            std::vector<int> adjacency;
+            std::vector<int> edge_weights;
+            std::vector<double> weights;
+            std::vector<Eigen::Vector3d> position_sums;
+
+            size_t size() const { return weights.size(); }
+        };
+
+        // Dual graph of a triangle mesh: one node per face, weighted by its area, and an edge of
+        // weight 1 between faces that share an edge. Neighbour lists are sorted.
+        inline Graph dual_graph(const MeshTopology &topology, const FaceGeometry &geometry)
+        {
+            const size_t num_faces = topology.num_faces();
+            auto for_each_neighbour = [&](size_t f, auto &&fn)
+            {
+                for (size_t h = 3 * f; h < 3 * f + 3; ++h)
+                {
+                    const int e = topology.half_edge_edges[h];
+                    if (e < 0)
+                    {
+                        continue;
+                    }
+                    for (int i = topology.edge_offsets[e]; i < topology.edge_offsets[e + 1]; ++i)
+                    {
+                        const int g = MeshTopology::face_of(topology.edge_half_edges[i]);
+                        if (g != static_cast<int>(f))
+                        {
+                            fn(g);
+                        }
+                    }
+                }
+            };
+
+            Graph graph;
+            graph.offsets.assign(num_faces + 1, 0);
+            parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                         {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    for_each_neighbour(f, [&](int) { ++graph.offsets[f + 1]; });
+                } });
+            for (size_t f = 0; f < num_faces; ++f)
+            {
+                graph.offsets[f + 1] += graph.offsets[f];
+            }
+            graph.adjacency.resize(graph.offsets.back());
+            graph.edge_weights.assign(graph.offsets.back(), 1);
+            graph.weights.resize(num_faces);
+            graph.position_sums.resize(num_faces);
+            parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                         {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    int slot = graph.offsets[f];
+                    for_each_neighbour(f, [&](int g) { graph.adjacency[slot++] = g; });
+                    std::sort(graph.adjacency.begin() + graph.offsets[f], graph.adjacency.begin() + graph.offsets[f + 1]);
+                    graph.weights[f] = geometry.areas(f);
+                    graph.position_sums[f] = geometry.areas(f) * geometry.centroids.row(f).transpose();
+                } });
+            return graph;
+        }
+
+        // Heavy-edge matching: every node in turn is paired with the unmatched neighbour it shares the
+        // heaviest edge with, unless the pair would outweigh max_weight. Nodes that find no partner
+        // stay single. Returns the coarse graph and fills coarse_of with the coarse node of every node.
+        inline Graph coarsen(const Graph &graph, double max_weight, std::vector<int> &coarse_of)
+        {
+            const size_t n = graph.size();
+            std::vector<int> match(n, -1);
+            coarse_of.assign(n, -1);
+            int num_coarse = 0;
+            for (size_t v = 0; v < n; ++v)
+            {
+                if (match[v] >= 0)
+                {
+                    continue;
+                }
+                int partner = static_cast<int>(v);
+                int best_weight = 0;
+                for (int i = graph.offsets[v]; i < graph.offsets[v + 1]; ++i)
+                {
+                    const int u = graph.adjacency[i];
+                    if (match[u] < 0 && u != static_cast<int>(v) && graph.edge_weights[i] > best_weight &&
+                        graph.weights[v] + graph.weights[u] <= max_weight)
+                    {
+                        partner = u;
+                        best_weight = graph.edge_weights[i];
+                    }
+                }
+                match[v] = partner;
+                match[partner] = static_cast<int>(v);
+                coarse_of[v] = coarse_of[partner] = num_coarse++;
+            }
+
+            Graph coarse;
+            coarse.offsets.assign(num_coarse + 1, 0);
+            coarse.weights.assign(num_coarse, 0.0);
+            coarse.position_sums.assign(num_coarse, Eigen::Vector3d::Zero());
+            coarse.adjacency.reserve(graph.adjacency.size() / 2);
+            coarse.edge_weights.reserve(graph.adjacency.size() / 2);
+            // slot_of[c] is the position of the edge to coarse node c in the list being built.
+            std::vector<int> slot_of(num_coarse, -1);
+            for (size_t v = 0; v < n; ++v)
+            {
+                const int u = match[v];
+                if (u < static_cast<int>(v))
+                {
+                    continue;
+                }
+                const int c = coarse_of[v];
+                const int first = static_cast<int>(coarse.adjacency.size());
+                for (const int member : {static_cast<int>(v), u})
+                {
+                    for (int i = graph.offsets[member]; i < graph.offsets[member + 1]; ++i)
+                    {
+                        const int target = coarse_of[graph.adjacency[i]];
+                        if (target == c)
+                        {
+                            continue;
+                        }
+                        if (slot_of[target] < first)
+                        {
+                            slot_of[target] = static_cast<int>(coarse.adjacency.size());
+                            coarse.adjacency.push_back(target);
+                            coarse.edge_weights.push_back(0);
+                        }
+                        coarse.edge_weights[slot_of[target]] += graph.edge_weights[i];
+                    }
+                    coarse.weights[c] += graph.weights[member];
+                    coarse.position_sums[c] += graph.position_sums[member];
+                    if (u == static_cast<int>(v))
+                    {
+                        break;
+                    }
+                }
+                coarse.offsets[c + 1] = static_cast<int>(coarse.adjacency.size());
+            }
+            return coarse;
+        }
+
+        // Recursive coordinate bisection of nodes[begin, end) into parts [first_part, first_part +
+        // num_parts): the nodes are split across the widest axis of their centroids so that each side
+        // gets a share of the weight proportional to its number of parts.
+        inline void bisect(const Graph &graph, std::vector<int> &nodes, size_t begin, size_t end, int first_part, int num_parts, std::vector<int> &part)
+        {
+            if (num_parts == 1 || end - begin <= 1)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    part[nodes[i]] = first_part;
+                }
+                return;
+            }
+            auto centroid = [&](int v)
+            {
+                return graph.weights[v] > 0.0 ? Eigen::Vector3d(graph.position_sums[v] / graph.weights[v]) : graph.position_sums[v];
+            };
+            Eigen::Vector3d lo = Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity());
+            Eigen::Vector3d hi = -lo;
+            double total = 0.0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                lo = lo.cwiseMin(centroid(nodes[i]));
+                hi = hi.cwiseMax(centroid(nodes[i]));
+                total += graph.weights[nodes[i]];
+            }
+            int axis;
+            (hi - lo).maxCoeff(&axis);
+            std::sort(nodes.begin() + begin, nodes.begin() + end, [&](int a, int b)
+                      {
+                const double ca = centroid(a)(axis);
+                const double cb = centroid(b)(axis);
+                return ca < cb || (ca == cb && a < b); });
+
+            const int left_parts = num_parts / 2;
+            const double target = total * left_parts / num_parts;
+            // Both sides keep at least as many nodes as parts, so that no part ends up empty.
+            const size_t min_split = begin + std::min<size_t>(left_parts, end - begin - 1);
+            const size_t max_split = end - std::min<size_t>(num_parts - left_parts, end - min_split);
+            size_t split = begin;
+            double left = 0.0;
+            while (split < max_split && (split < min_split || left + 0.5 * graph.weights[nodes[split]] < target))
+            {
+                left += graph.weights[nodes[split++]];
+            }
+            bisect(graph, nodes, begin, split, first_part, left_parts, part);
+            bisect(graph, nodes, split, end, first_part + left_parts, num_parts - left_parts, part);
+        }
+
+        // Greedy boundary refinement: nodes move to the adjacent part they are most connected to when
+        // that cuts fewer edges (or as many, while evening out the weights) and keeps the target part
+        // within max_part_weight. Nodes of overweight parts may also move at a loss. No part is emptied.
+        inline void refine(const Graph &graph, int num_parts, double max_part_weight, std::vector<int> &part)
+        {
+            std::vector<double> part_weights(num_parts, 0.0);
+            std::vector<size_t> part_sizes(num_parts, 0);
+            for (size_t v = 0; v < graph.size(); ++v)
+            {
+                part_weights[part[v]] += graph.weights[v];
+                ++part_sizes[part[v]];
+            }
+            std::vector<std::pair<int, int>> connections;
+            for (int pass = 0; pass < REFINEMENT_PASSES; ++pass)
+            {
+                size_t moves = 0;
+                for (size_t v = 0; v < graph.size(); ++v)
+                {
+                    const int own = part[v];
+                    if (part_sizes[own] == 1)
+                    {
+                        continue;
+                    }
+                    int internal = 0;
+                    connections.clear();
+                    for (int i = graph.offsets[v]; i < graph.offsets[v + 1]; ++i)
+                    {
+                        const int p = part[graph.adjacency[i]];
+                        if (p == own)
+                        {
+                            internal += graph.edge_weights[i];
+                            continue;
+                        }
+                        auto it = std::find_if(connections.begin(), connections.end(), [p](const auto &c)
+                                               { return c.first == p; });
+                        if (it == connections.end())
+                        {
+                            connections.emplace_back(p, graph.edge_weights[i]);
+                        }
+                        else
+                        {
+                            it->second += graph.edge_weights[i];
+                        }
+                    }
+                    if (connections.empty())
+                    {
+                        continue;
+                    }
+
+                    const double w = graph.weights[v];
+                    const bool overweight = part_weights[own] > max_part_weight;
+                    int best_part = -1;
+                    int best_gain = 0;
+                    for (const auto &[p, external] : connections)
+                    {
+                        if (part_weights[p] + w > max_part_weight)
+                        {
+                            continue;
+                        }
+                        const int gain = external - internal;
+                        const bool evens_out = gain == 0 && part_weights[p] + w < part_weights[own];
+                        if (best_part < 0 ? (gain > 0 || evens_out || overweight) : gain > best_gain)
+                        {
+                            best_part = p;
+                            best_gain = gain;
+                        }
+                    }
+                    if (best_part >= 0)
+                    {
+                        part[v] = best_part;
+                        part_weights[own] -= w;
+                        part_weights[best_part] += w;
+                        --part_sizes[own];
+                        ++part_sizes[best_part];
+                        ++moves;
+                    }
+                }
+                if (moves == 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        // Multilevel k-way partition: coarsen by heavy-edge matching, split the coarsest graph by
+        // recursive coordinate bisection, then project back level by level with boundary refinement.
+        inline std::vector<int> partition_multilevel(const Graph &graph, int num_parts, double imbalance)
+        {
+            double total = 0.0;
+            for (const double w : graph.weights)
+            {
+                total += w;
+            }
+            const double max_part_weight = (1.0 + imbalance) * total / num_parts;
+            const size_t coarse_target = std::max(MIN_COARSE_NODES, COARSE_NODES_PER_PART * static_cast<size_t>(num_parts));
+
+            std::vector<Graph> levels;
+            std::vector<std::vector<int>> coarse_of;
+            const Graph *current = &graph;
+            while (current->size() > coarse_target)
+            {
+                std::vector<int> map;
+                Graph coarse = coarsen(*current, max_part_weight / 4.0, map);
+                if (coarse.size() > current->size() * 95 / 100)
+                {
+                    break;
+                }
+                coarse_of.push_back(std::move(map));
+                levels.push_back(std::move(coarse));
+                current = &levels.back();
+            }
+
+            std::vector<int> part(current->size());
+            std::vector<int> nodes(current->size());
+            std::iota(nodes.begin(), nodes.end(), 0);
+            bisect(*current, nodes, 0, nodes.size(), 0, num_parts, part);
+            refine(*current, num_parts, max_part_weight, part);
+
+            for (size_t level = levels.size(); level-- > 0;)
+            {
+                const Graph &finer = level == 0 ? graph : levels[level - 1];
+                std::vector<int> finer_part(finer.size());
+                for (size_t v = 0; v < finer.size(); ++v)
+                {
+                    finer_part[v] = part[coarse_of[level][v]];
+                }
+                part = std::move(finer_part);
+                refine(finer, num_parts, max_part_weight, part);
+            }
+            return part;
+        }
+
+#ifdef MITSUDOMOE_USE_METIS
+        inline std::vector<int> partition_metis(const Graph &graph, int num_parts, double imbalance)
+        {
+            idx_t num_nodes = static_cast<idx_t>(graph.size());
+            idx_t num_constraints = 1;
+            idx_t parts = num_parts;
+            std::vector<idx_t> offsets(graph.offsets.begin(), graph.offsets.end());
+            std::vector<idx_t> adjacency(graph.adjacency.begin(), graph.adjacency.end());
+            std::vector<idx_t> edge_weights(graph.edge_weights.begin(), graph.edge_weights.end());
+            // METIS balances integer weights; areas are scaled so that the total is about 2^30.
+            const double total = std::accumulate(graph.weights.begin(), graph.weights.end(), 0.0);
+            const double scale = total > 0.0 ? double(1 << 30) / total : 0.0;
+            std::vector<idx_t> weights(graph.size());
+            for (size_t v = 0; v < graph.size(); ++v)
+            {
+                weights[v] = std::max<idx_t>(1, static_cast<idx_t>(std::llround(graph.weights[v] * scale)));
+            }
+            real_t tolerance = static_cast<real_t>(1.0 + imbalance);
+            idx_t options[METIS_NOPTIONS];
+            METIS_SetDefaultOptions(options);
+            options[METIS_OPTION_SEED] = 0;
+            idx_t cut = 0;
+            std::vector<idx_t> part(graph.size(), 0);
+            if (num_parts > 1 &&
+                METIS_PartGraphKway(&num_nodes, &num_constraints, offsets.data(), adjacency.data(), weights.data(), nullptr,
+                                    edge_weights.data(), &parts, nullptr, &tolerance, options, &cut, part.data()) != METIS_OK)
+            {
+                throw std::runtime_error("METIS failed to partition the mesh.");
+            }
+            return std::vector<int>(part.begin(), part.end());
+        }
+#endif
+
+        // Rows of M selected by indices.
+        template <typename Matrix>
+        Matrix gather_rows(const Matrix &M, const std::vector<int> &indices)
+        {
+            Matrix result(indices.size(), M.cols());
+            for (size_t i = 0; i < indices.size(); ++i)
+            {
+                result.row(i) = M.row(indices[i]);
+            }
+            return result;
+        }
+    } // namespace partition_detail
+
+    struct MeshPartitioning
+    {
+        // Part of every face, with the membership lists and per-part statistics.
+        Polygon_clusters parts;
+        std::vector<Mesh_partition> partitions;
+        // Number of mesh edges between faces of different parts.
+        size_t cut_edges = 0;
+        // Heaviest part area divided by the mean part area.
+        double imbalance = 0.0;
+    };
+
+    // Splits the faces of a triangle mesh into num_parts parts of about equal area with few edges
+    // between them, by partitioning the face adjacency graph (with METIS when built with
+    // MITSUDOMOE_USE_METIS, otherwise with the built-in multilevel partitioner). imbalance is the
+    // allowed excess of a part over the mean area. Every part is extracted as a compact submesh
+    // with maps back to the source faces and vertices and its vertices shared with other parts.
+    // Throws std::invalid_argument unless 1 <= num_parts <= number of faces.
+    inline MeshPartitioning partition_mesh(const Polygon_mesh &mesh, int num_parts, double imbalance = 0.03)
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        const size_t num_faces = static_cast<size_t>(mesh.F.rows());
+        if (num_parts < 1 || static_cast<size_t>(num_parts) > num_faces)
+        {
+            throw std::invalid_argument("num_parts must be between 1 and the number of faces.");
+        }
+        if (!(imbalance >= 0.0))
+        {
+            throw std::invalid_argument("imbalance must not be negative.");
+        }
+
+        MeshDerivedData derived(mesh);
+        const std::shared_ptr<const FaceGeometry> geometry_data = derived.face_geometry();
+        const FaceGeometry &geometry = *geometry_data;
+        const partition_detail::Graph graph = partition_detail::dual_graph(*derived.topology(), geometry);
+#ifdef MITSUDOMOE_USE_METIS
+        const std::vector<int> part = partition_detail::partition_metis(graph, num_parts, imbalance);
+#else
+        const std::vector<int> part = partition_detail::partition_multilevel(graph, num_parts, imbalance);
+#endif
+
+        MeshPartitioning result;
+        result.parts = cluster_detail::build_clusters(mesh, geometry, Eigen::Map<const Eigen::VectorXi>(part.data(), num_faces), num_parts);
+        for (size_t f = 0; f < num_faces; ++f)
+        {
+            for (int i = graph.offsets[f]; i < graph.offsets[f + 1]; ++i)
+            {
+                result.cut_edges += graph.adjacency[i] > static_cast<int>(f) && part[graph.adjacency[i]] != part[f];
+            }
+        }
+        const double total_area = result.parts.areas.sum();
+        result.imbalance = total_area > 0.0 ? result.parts.areas.maxCoeff() * num_parts / total_area : 1.0;
+
+        // A vertex is on a boundary when faces of more than one part use it.
+        const Eigen::MatrixXi &F = mesh.F;
+        std::vector<int> vertex_part(mesh.V.rows(), -1);
+        std::vector<char> shared(mesh.V.rows(), 0);
+        parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                     {
+            for (size_t f = begin; f < end; ++f)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    int expected = -1;
+                    if (!std::atomic_ref<int>(vertex_part[F(f, j)]).compare_exchange_strong(expected, part[f]) && expected != part[f])
+                    {
+                        std::atomic_ref<char>(shared[F(f, j)]).store(1, std::memory_order_relaxed);
+                    }
+                }
+            } });
+
+        const bool face_normals = has_face_normals(mesh);
+        const bool vertex_normals = has_vertex_normals(mesh);
+        result.partitions.resize(num_parts);
+        parallel_for(0, static_cast<size_t>(num_parts), [&](size_t begin, size_t end)
+                     {
+            for (size_t p = begin; p < end; ++p)
+            {
+                Mesh_partition &partition = result.partitions[p];
+                const int first = result.parts.offsets(p);
+                const int count = result.parts.offsets(p + 1) - first;
+                partition.face_ids = result.parts.faces.segment(first, count);
+
+                std::vector<int> vertices(3 * static_cast<size_t>(count));
+                for (int i = 0; i < count; ++i)
+                {
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        vertices[3 * i + j] = F(partition.face_ids(i), j);
+                    }
+                }
+                std::sort(vertices.begin(), vertices.end());
+                vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+                partition.vertex_ids = Eigen::Map<const Eigen::VectorXi>(vertices.data(), vertices.size());
+                partition.mesh.V = partition_detail::gather_rows(mesh.V, vertices);
+                partition.mesh.F.resize(count, 3);
+                for (int i = 0; i < count; ++i)
+                {
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        partition.mesh.F(i, j) = static_cast<int>(std::lower_bound(vertices.begin(), vertices.end(), F(partition.face_ids(i), j)) - vertices.begin());
+                    }
+                }
+                if (face_normals)
+                {
+                    partition.mesh.N = partition_detail::gather_rows(mesh.N, std::vector<int>(partition.face_ids.data(), partition.face_ids.data() + count));
+                    partition.mesh.normal_kind = Normal_kind::face;
+                }
+                else if (vertex_normals)
+                {
+                    partition.mesh.N = partition_detail::gather_rows(mesh.N, vertices);
+                    partition.mesh.normal_kind = Normal_kind::vertex;
+                }
+
+                std::vector<int> boundary;
+                for (size_t i = 0; i < vertices.size(); ++i)
+                {
+                    if (shared[vertices[i]])
+                    {
+                        boundary.push_back(static_cast<int>(i));
+                    }
+                }
+                partition.boundary_vertices = Eigen::Map<const Eigen::VectorXi>(boundary.data(), boundary.size());
+            } }, 1);
+        return result;
+    }
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,708 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "FastParse.hpp"
+#include "MappedFile.hpp"
+#include "MeshNormals.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace ply_detail
+    {
+        enum class Format
+        {
+            Ascii,
+            BinaryLittleEndian,
+            BinaryBigEndian
+        };
+
+        enum class Type
+        {
+            Int8,
+            UInt8,
+            Int16,
+            UInt16,
+            Int32,
+            UInt32,
+            Float32,
+            Float64
+        };
+
+        struct Property
+        {
+            std::string name;
+            Type type = Type::Float32;
+            bool is_list = false;
+            Type count_type = Type::UInt8; // only for lists
+        };
+
+        struct Element
+        {
+            std::string name;
+            size_t count = 0;
+            std::vector<Property> properties;
+
+            bool has_lists() const
+            {
+                return std::any_of(properties.begin(), properties.end(), [](const Property &p)
+                                   { return p.is_list; });
+            }
+
+            std::optional<size_t> find(std::initializer_list<std::string_view> names) const
+            {
+                for (size_t i = 0; i < properties.size(); ++i)
+                {
+                    if (std::find(names.begin(), names.end(), properties[i].name) != names.end())
+                    {
+                        return i;
+                    }
+                }
+                return std::nullopt;
+            }
+        };
+
+        struct Header
+        {
+            Format format = Format::Ascii;
+            std::vector<Element> elements;
+            size_t data_offset = 0;
+        };
+
+        inline size_t type_size(Type type)
+        {
+            switch (type)
+            {
+            case Type::Int8:
+            case Type::UInt8:
+                return 1;
+            case Type::Int16:
+            case Type::UInt16:
+                return 2;
+            case Type::Int32:
+            case Type::UInt32:
+            case Type::Float32:
+                return 4;
+            case Type::Float64:
+                return 8;
+            }
+            return 0;
+        }
+
+        inline Type parse_type(std::string_view name)
+        {
+            if (name == "char" || name == "int8")
+            {
+                return Type::Int8;
+            }
+            if (name == "uchar" || name == "uint8")
+            {
+                return Type::UInt8;
+            }
+            if (name == "short" || name == "int16")
+            {
+                return Type::Int16;
+            }
+            if (name == "ushort" || name == "uint16")
+            {
+                return Type::UInt16;
+            }
+            if (name == "int" || name == "int32")
+            {
+                return Type::Int32;
+            }
+            if (name == "uint" || name == "uint32")
+            {
+                return Type::UInt32;
+            }
+            if (name == "float" || name == "float32")
+            {
+                return Type::Float32;
+            }
+            if (name == "double" || name == "float64")
+            {
+                return Type::Float64;
+            }
+            throw std::runtime_error("Unknown PLY property type: " + std::string(name));
+        }
+
+        template <typename T>
+        T load_raw(const char *p, bool swap)
+        {
+            T value;
+            std::memcpy(&value, p, sizeof(T));
+            if constexpr (sizeof(T) > 1)
+            {
+                if (swap)
+                {
+                    auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+                    std::reverse(bytes.begin(), bytes.end());
+                    value = std::bit_cast<T>(bytes);
+                }
+            }
+            return value;
+        }
+
+        // Reads one binary scalar of the given type and converts it to T.
+        template <typename T>
+        T load(const char *p, Type type, bool swap)
+        {
+            switch (type)
+            {
+            case Type::Int8:
+                return static_cast<T>(load_raw<int8_t>(p, swap));
+            case Type::UInt8:
+                return static_cast<T>(load_raw<uint8_t>(p, swap));
+            case Type::Int16:
+                return static_cast<T>(load_raw<int16_t>(p, swap));
+            case Type::UInt16:
+                return static_cast<T>(load_raw<uint16_t>(p, swap));
+            case Type::Int32:
+                return static_cast<T>(load_raw<int32_t>(p, swap));
+            case Type::UInt32:
+                return static_cast<T>(load_raw<uint32_t>(p, swap));
+            case Type::Float32:
+                return static_cast<T>(load_raw<float>(p, swap));
+            case Type::Float64:
+                return static_cast<T>(load_raw<double>(p, swap));
+            }
+            return T();
+        }
+
+        inline Header parse_header(const char *data, size_t size)
+        {
+            namespace fp = fast_parse;
+            const char *end = data + size;
+            const char *p = data;
+            if (fp::next_token(p, end) != "ply")
+            {
+                throw std::runtime_error("Not a PLY file.");
+            }
+
+            Header header;
+            bool has_format = false;
+            while (p < end)
+            {
+                const char *line = p;
+                p = fp::skip_line(p, end);
+                const char *cursor = line;
+                const std::string_view keyword = fp::next_token(cursor, p);
+                if (keyword == "format")
+                {
+                    const std::string_view format = fp::next_token(cursor, p);
+                    if (format == "ascii")
+                    {
+                        header.format = Format::Ascii;
+                    }
+                    else if (format == "binary_little_endian")
+                    {
+                        header.format = Format::BinaryLittleEndian;
+                    }
+                    else if (format == "binary_big_endian")
+                    {
+                        header.format = Format::BinaryBigEndian;
+                    }
+                    else
+                    {
+                        throw std::runtime_error("Unknown PLY format: " + std::string(format));
+                    }
+                    has_format = true;
+                }
+                else if (keyword == "element")
+                {
+                    Element element;
+                    element.name = fp::next_token(cursor, p);
+                    if (!fp::parse_number(cursor, p, element.count))
+                    {
+                        throw std::runtime_error("Malformed PLY element count for " + element.name);
+                    }
+                    header.elements.push_back(std::move(element));
+                }
+                else if (keyword == "property")
+                {
+                    if (header.elements.empty())
+                    {
+                        throw std::runtime_error("PLY property declared before any element.");
+                    }
+                    Property property;
+                    const std::string_view type = fp::next_token(cursor, p);
+                    if (type == "list")
+                    {
+                        property.is_list = true;
+                        property.count_type = parse_type(fp::next_token(cursor, p));
+                        property.type = parse_type(fp::next_token(cursor, p));
+                    }
+                    else
+                    {
+                        property.type = parse_type(type);
+                    }
+                    property.name = fp::next_token(cursor, p);
+                    header.elements.back().properties.push_back(std::move(property));
+                }
+                else if (keyword == "end_header")
+                {
+                    if (!has_format)
+                    {
+                        throw std::runtime_error("PLY header has no format line.");
+                    }
+                    header.data_offset = static_cast<size_t>(p - data);
+                    return header;
+                }
+                // comment and obj_info lines are ignored
+            }
+            throw std::runtime_error("PLY header is not terminated by end_header.");
+        }
+
+        // Byte offset of every property within a record that has no lists.
+        inline std::vector<size_t> fixed_offsets(const Element &element)
+        {
+            std::vector<size_t> offsets;
+            size_t offset = 0;
+            for (const Property &property : element.properties)
+            {
+                offsets.push_back(offset);
+                offset += type_size(property.type);
+            }
+            offsets.push_back(offset);
+            return offsets;
+        }
+
+        inline int checked_index(long long index, size_t num_vertices)
+        {
+            if (index < 0 || static_cast<size_t>(index) >= num_vertices)
+            {
+                throw std::runtime_error("Face index out of range in PLY file.");
+            }
+            return static_cast<int>(index);
+        }
+
+        inline size_t checked_length(long long length)
+        {
+            if (length < 0)
+            {
+                throw std::runtime_error("Negative list length in PLY file.");
+            }
+            return static_cast<size_t>(length);
+        }
+
+        // Reads a list length; signed count types (char, short, int) are read as signed.
+        inline size_t load_length(const char *p, Type type, bool swap)
+        {
+            return checked_length(load<int64_t>(p, type, swap));
+        }
+
+        class BinaryReader
+        {
+        public:
+            BinaryReader(const char *data, size_t size, bool swap)
+                : data_(data), size_(size), swap_(swap) {}
+
+            void read_vertices(const Element &element, size_t offset, Eigen::MatrixXd &V) const
+            {
+                const auto x = element.find({"x"});
+                const auto y = element.find({"y"});
+                const auto z = element.find({"z"});
+                if (!x || !y || !z || element.has_lists())
+                {
+                    throw std::runtime_error("PLY vertex element needs scalar x, y and z properties.");
+                }
+                const std::vector<size_t> offsets = fixed_offsets(element);
+                const size_t stride = offsets.back();
+                require_records(offset, element.count, stride);
+
+                const size_t columns[3] = {*x, *y, *z};
+                V.resize(element.count, 3);
+                parallel_for(0, element.count, [&](size_t begin, size_t end)
+                             {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        const char *record = data_ + offset + i * stride;
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            const Property &property = element.properties[columns[k]];
+                            V(i, k) = load<double>(record + offsets[columns[k]], property.type, swap_);
+                        }
+                    } }, 1 << 14);
+            }
+
+            // Returns the offset just past the element.
+            size_t read_faces(const Element &element, size_t offset, size_t num_vertices, Eigen::MatrixXi &F) const
+            {
+                const auto list = element.find({"vertex_indices", "vertex_index"});
+                if (!list || !element.properties[*list].is_list)
+                {
+                    throw std::runtime_error("PLY face element needs a vertex_indices list.");
+                }
+                const Property &indices = element.properties[*list];
+                const size_t count_size = type_size(indices.count_type);
+                const size_t index_size = type_size(indices.type);
+
+                // Bytes before the index list, and the whole record, if every other property is a
+                // scalar and every face is a triangle.
+                size_t lead = 0;
+                size_t triangle_stride = count_size + 3 * index_size;
+                bool fixed = true;
+                for (size_t i = 0; i < element.properties.size(); ++i)
+                {
+                    if (i == *list)
+                    {
+                        continue;
+                    }
+                    fixed = fixed && !element.properties[i].is_list;
+                    (i < *list ? lead : triangle_stride) += type_size(element.properties[i].type);
+                }
+                triangle_stride += lead;
+
+                // Fast path: check in parallel that all faces are triangles, then decode at a fixed stride.
+                if (fixed && offset <= size_ && element.count <= (size_ - offset) / triangle_stride)
+                {
+                    std::atomic<bool> all_triangles{true};
+                    parallel_for(0, element.count, [&](size_t begin, size_t end)
+                                 {
+                        for (size_t f = begin; f < end && all_triangles.load(std::memory_order_relaxed); ++f)
+                        {
+                            if (load<int64_t>(data_ + offset + f * triangle_stride + lead, indices.count_type, swap_) != 3)
+                            {
+                                all_triangles.store(false, std::memory_order_relaxed);
+                            }
+                        } }, 1 << 14);
+                    if (all_triangles.load())
+                    {
+                        F.resize(element.count, 3);
+                        parallel_for(0, element.count, [&](size_t begin, size_t end)
+                                     {
+                            for (size_t f = begin; f < end; ++f)
+                            {
+                                const char *list_data = data_ + offset + f * triangle_stride + lead + count_size;
+                                for (int k = 0; k < 3; ++k)
+                                {
+                                    F(f, k) = checked_index(load<int64_t>(list_data + k * index_size, indices.type, swap_), num_vertices);
+                                }
+                            } }, 1 << 14);
+                        return offset + element.count * triangle_stride;
+                    }
+                }
+
+                // General path: locate the records serially, then fan-triangulate them in parallel.
+                // Every record holds at least its list length, which bounds the count before allocating.
+                require_records(offset, element.count, count_size);
+                std::vector<size_t> record_offset(element.count + 1);
+                std::vector<size_t> triangle_offset(element.count + 1, 0);
+                size_t position = offset;
+                for (size_t f = 0; f < element.count; ++f)
+                {
+                    record_offset[f] = position;
+                    const size_t list_position = position + record_size(position, element, *list);
+                    require(list_position, count_size);
+                    const size_t corners = load_length(data_ + list_position, indices.count_type, swap_);
+                    triangle_offset[f + 1] = triangle_offset[f] + (corners >= 3 ? corners - 2 : 0);
+                    position += record_size(position, element);
+                }
+                record_offset[element.count] = position;
+
+                F.resize(triangle_offset.back(), 3);
+                parallel_for(0, element.count, [&](size_t begin, size_t end)
+                             {
+                    for (size_t f = begin; f < end; ++f)
+                    {
+                        const char *list_data = data_ + record_offset[f] + record_size(record_offset[f], element, *list);
+                        const size_t corners = load_length(list_data, indices.count_type, swap_);
+                        list_data += count_size;
+                        auto corner = [&](size_t k)
+                        {
+                            return checked_index(load<int64_t>(list_data + k * index_size, indices.type, swap_), num_vertices);
+                        };
+                        size_t t = triangle_offset[f];
+                        for (size_t k = 2; k < corners; ++k, ++t)
+                        {
+                            F.row(t) << corner(0), corner(k - 1), corner(k);
+                        }
+                    } });
+                return position;
+            }
+
+            // Returns the offset just past the element.
+            size_t skip(const Element &element, size_t offset) const
+            {
+                if (!element.has_lists())
+                {
+                    const size_t stride = fixed_offsets(element).back();
+                    require_records(offset, element.count, stride);
+                    return offset + element.count * stride;
+                }
+                for (size_t i = 0; i < element.count; ++i)
+                {
+                    offset += record_size(offset, element);
+                }
+                return offset;
+            }
+
+        private:
+            // Byte size of the first num_properties properties of the record at offset (all of them by
+            // default), walking list lengths. Every length read is bounds-checked.
+            size_t record_size(size_t offset, const Element &element, size_t num_properties = SIZE_MAX) const
+            {
+                size_t size = 0;
+                num_properties = std::min(num_properties, element.properties.size());
+                for (size_t i = 0; i < num_properties; ++i)
+                {
+                    const Property &property = element.properties[i];
+                    if (property.is_list)
+                    {
+                        require(offset + size, type_size(property.count_type));
+                        const size_t count = load_length(data_ + offset + size, property.count_type, swap_);
+                        size += type_size(property.count_type);
+                        require_records(offset + size, count, type_size(property.type));
+                        size += count * type_size(property.type);
+                    }
+                    else
+                    {
+                        size += type_size(property.type);
+                    }
+                }
+                require(offset, size);
+                return size;
+            }
+
+            void require(size_t offset, size_t length) const
+            {
+                if (offset > size_ || length > size_ - offset)
+                {
+                    throw std::runtime_error("PLY file is truncated.");
+                }
+            }
+
+            // Like require(offset, count * stride), without overflowing the product for a huge count.
+            void require_records(size_t offset, size_t count, size_t stride) const
+            {
+                if (offset > size_ || (stride > 0 && count > (size_ - offset) / stride))
+                {
+                    throw std::runtime_error("PLY file is truncated.");
+                }
+            }
+
+            const char *data_;
+            size_t size_;
+            bool swap_;
+        };
+
+        // ASCII bodies are parsed serially: records are whitespace-separated and cannot be located
+        // without scanning everything before them.
+        inline void read_ascii(const char *p, const char *end, const Header &header, Polygon_mesh &mesh)
+        {
+            namespace fp = fast_parse;
+            auto number = [&](auto &value)
+            {
+                p = fp::parse_number(p, end, value);
+                if (!p)
+                {
+                    throw std::runtime_error("Malformed number in ASCII PLY body.");
+                }
+            };
+            auto length = [&]
+            {
+                long long value;
+                number(value);
+                return checked_length(value);
+            };
+            auto skip_property = [&](const Property &property)
+            {
+                double value;
+                size_t count = 1;
+                if (property.is_list)
+                {
+                    count = length();
+                }
+                for (size_t i = 0; i < count; ++i)
+                {
+                    number(value);
+                }
+            };
+
+            for (const Element &element : header.elements)
+            {
+                if (element.name == "vertex")
+                {
+                    const size_t columns[3] = {element.find({"x"}).value_or(SIZE_MAX), element.find({"y"}).value_or(SIZE_MAX), element.find({"z"}).value_or(SIZE_MAX)};
+                    for (const size_t column : columns)
+                    {
+                        if (column == SIZE_MAX || element.properties[column].is_list)
+                        {
+                            throw std::runtime_error("PLY vertex element needs scalar x, y and z properties.");
+                        }
+                    }
+                    mesh.V.resize(element.count, 3);
+                    for (size_t v = 0; v < element.count; ++v)
+                    {
+                        for (size_t i = 0; i < element.properties.size(); ++i)
+                        {
+                            const auto k = std::find(columns, columns + 3, i) - columns;
+                            if (k < 3)
+                            {
+                                number(mesh.V(v, k));
+                            }
+                            else
+                            {
+                                skip_property(element.properties[i]);
+                            }
+                        }
+                    }
+                }
+                else if (element.name == "face")
+                {
+                    const auto list = element.find({"vertex_indices", "vertex_index"});
+                    if (!list || !element.properties[*list].is_list)
+                    {
+                        throw std::runtime_error("PLY face element needs a vertex_indices list.");
+                    }
+                    // Count the triangles first so that F is written in place.
+                    const char *start = p;
+                    size_t triangles = 0;
+                    for (size_t f = 0; f < element.count; ++f)
+                    {
+                        for (size_t i = 0; i < element.properties.size(); ++i)
+                        {
+                            if (i == *list)
+                            {
+                                const size_t corners = length();
+                                triangles += corners >= 3 ? corners - 2 : 0;
+                                for (size_t k = 0; k < corners; ++k)
+                                {
+                                    long long index;
+                                    number(index);
+                                }
+                            }
+                            else
+                            {
+                                skip_property(element.properties[i]);
+                            }
+                        }
+                    }
+
+                    p = start;
+                    mesh.F.resize(triangles, 3);
+                    size_t t = 0;
+                    for (size_t f = 0; f < element.count; ++f)
+                    {
+                        for (size_t i = 0; i < element.properties.size(); ++i)
+                        {
+                            if (i != *list)
+                            {
+                                skip_property(element.properties[i]);
+                                continue;
+                            }
+                            const size_t corners = length();
+                            long long first = 0;
+                            long long previous = 0;
+                            for (size_t k = 0; k < corners; ++k)
+                            {
+                                long long index;
+                                number(index);
+                                if (k == 0)
+                                {
+                                    first = index;
+                                }
+                                else if (k >= 2)
+                                {
+                                    mesh.F.row(t++) << checked_index(first, mesh.V.rows()), checked_index(previous, mesh.V.rows()),
+                                        checked_index(index, mesh.V.rows());
+                                }
+                                previous = index;
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    for (size_t r = 0; r < element.count; ++r)
+                    {
+                        for (const Property &property : element.properties)
+                        {
+                            skip_property(property);
+                        }
+                    }
+                }
+            }
+        }
+    } // namespace ply_detail
+
+    // Reads the "vertex" and "face" elements of an ASCII or binary (either byte order) PLY file
+    // through a memory mapping. Binary vertices are decoded in parallel at their fixed record stride.
+    // Faces take the same path when every face is a triangle, which is checked in parallel first;
+    // otherwise the records are located in one serial pass and polygons are fan-triangulated in
+    // parallel. Other elements and properties are skipped, and N receives the unit normal of every
+    // triangle.
+    // Throws std::runtime_error if the file cannot be read or parsed.
+    inline Polygon_mesh read_ply(const std::filesystem::path &path)
+    {
+        using namespace ply_detail;
+
+        const MappedFile file(path);
+        const Header header = parse_header(file.data(), file.size());
+        const auto vertex_element = std::find_if(header.elements.begin(), header.elements.end(), [](const Element &e)
+                                                 { return e.name == "vertex"; });
+        const auto face_element = std::find_if(header.elements.begin(), header.elements.end(), [](const Element &e)
+                                               { return e.name == "face"; });
+        if (vertex_element == header.elements.end())
+        {
+            throw std::runtime_error("PLY file has no vertex element.");
+        }
+        if (face_element != header.elements.end() && face_element < vertex_element)
+        {
+            throw std::runtime_error("PLY face element precedes the vertex element.");
+        }
+
+        Polygon_mesh mesh;
+        if (header.format == Format::Ascii)
+        {
+            read_ascii(file.data() + header.data_offset, file.data() + file.size(), header, mesh);
+        }
+        else
+        {
+            const bool swap = (header.format == Format::BinaryBigEndian) != (std::endian::native == std::endian::big);
+            const BinaryReader reader(file.data(), file.size(), swap);
+            size_t offset = header.data_offset;
+            for (const Element &element : header.elements)
+            {
+                if (&element == &*vertex_element)
+                {
+                    reader.read_vertices(element, offset, mesh.V);
+                    offset += element.count * fixed_offsets(element).back();
+                }
+                else if (face_element != header.elements.end() && &element == &*face_element)
+                {
+                    offset = reader.read_faces(element, offset, static_cast<size_t>(mesh.V.rows()), mesh.F);
+                    break; // nothing after the faces is needed
+                }
+                else
+                {
+                    offset = reader.skip(element, offset);
+                }
+            }
+        }
+
+        if (mesh.F.rows() == 0)
+        {
+            mesh.F.resize(0, 3);
+        }
+        mesh.N = compute_face_normals(mesh.V, mesh.F);
+        mesh.normal_kind = Normal_kind::face;
+        return mesh;
+    }
+
+} // namespace MITSU_Domoe
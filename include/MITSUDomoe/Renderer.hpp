@@ -1,9 +1,13 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 #include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Clustering.hpp"
+#include "MITSUDomoe/DerivedData.hpp"
 #include "MITSUDomoe/Shader.hpp"
 
 namespace MITSU_Domoe
@@ -17,9 +21,9 @@ namespace MITSU_Domoe
         std::vector<float> vertices;
         std::vector<unsigned int> indices;
 
-        Renderer(const Polygon_mesh &mesh)
+        Renderer(const Polygon_mesh &mesh, MeshDerivedData &derived)
         {
-            setup_mesh(mesh);
+            setup_mesh(mesh, derived);
         }
 
         ~Renderer()
@@ -39,21 +43,52 @@ namespace MITSU_Domoe
         }
 
     private:
-        void setup_mesh(const Polygon_mesh &mesh)
+        void setup_mesh(const Polygon_mesh &mesh, MeshDerivedData &derived)
         {
-            // Convert vertices from double to float
-            vertices.reserve(mesh.V.rows() * 3);
-            for (int i = 0; i < mesh.V.rows(); ++i)
+            // The mesh comes from a result, so it is checked before anything indexes through F. A mesh
+            // that fails is uploaded without faces and normals instead of reading out of bounds.
+            bool valid = mesh.V.rows() == 0 || mesh.V.cols() == 3;
+            try
+            {
+                cluster_detail::check_triangle_mesh(mesh);
+            }
+            catch (const std::invalid_argument &)
+            {
+                valid = false;
+            }
+
+            // Shading needs a normal per vertex; face normals cannot be shared by indexed vertices,
+            // so they are replaced by area-weighted vertex normals.
+            std::shared_ptr<const Eigen::MatrixXd> vertex_normals;
+            if (!valid)
+            {
+                vertex_normals = std::make_shared<const Eigen::MatrixXd>(Eigen::MatrixXd::Zero(mesh.V.rows(), 3));
+            }
+            else if (!has_vertex_normals(mesh))
+            {
+                vertex_normals = derived.vertex_normals();
+            }
+            const Eigen::MatrixXd &normals = vertex_normals ? *vertex_normals : mesh.N;
+
+            // Interleave positions and normals, converted from double to float
+            const int num_vertices = mesh.V.cols() == 3 ? static_cast<int>(mesh.V.rows()) : 0;
+            vertices.reserve(num_vertices * 6);
+            for (int i = 0; i < num_vertices; ++i)
             {
                 for (int j = 0; j < 3; ++j)
                 {
                     vertices.push_back(static_cast<float>(mesh.V(i, j)));
                 }
+                for (int j = 0; j < 3; ++j)
+                {
+                    vertices.push_back(static_cast<float>(normals(i, j)));
+                }
             }
 
             // Convert faces to a flat list of indices
-            indices.reserve(mesh.F.rows() * 3);
-            for (int i = 0; i < mesh.F.rows(); ++i)
+            const int num_faces = valid ? static_cast<int>(mesh.F.rows()) : 0;
+            indices.reserve(num_faces * 3);
+            for (int i = 0; i < num_faces; ++i)
             {
                 for (int j = 0; j < 3; ++j)
                 {
@@ -68,14 +103,17 @@ namespace MITSU_Domoe
             glBindVertexArray(VAO);
 
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
             // vertex positions
             glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
 
             glBindVertexArray(0);
         }
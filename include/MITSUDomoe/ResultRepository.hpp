@@ -5,6 +5,9 @@
 #include <mutex>
 #include <optional>
 #include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
 
 namespace MITSU_Domoe {
 
@@ -12,14 +15,25 @@ namespace MITSU_Domoe {
 class ResultRepository {
 public:
     void store_result(uint64_t id, CommandResult result);
+    // Stores a batch under a single lock, in the order given.
+    void store_results(std::vector<std::pair<uint64_t, CommandResult>> results);
     std::optional<CommandResult> get_result(uint64_t id);
     bool remove_result(uint64_t id);
     std::map<uint64_t, CommandResult> get_all_results() const;
+    // Calls visitor for every result in ID order while holding the lock, without copying.
+    void visit_results(const std::function<void(uint64_t, const CommandResult &)> &visitor) const;
+    // Like visit_results, but only for results stored (or replaced) since the call that returned
+    // position, in the order they were stored. Returns the position to pass next time; 0 visits all.
+    size_t visit_results_since(size_t position, const std::function<void(uint64_t, const CommandResult &)> &visitor) const;
     std::optional<uint64_t> get_latest_result_id(uint64_t command_id_to_ignore) const;
     std::optional<uint64_t> get_nth_latest_result_id(size_t n, uint64_t command_id_to_ignore) const;
 
 private:
+    static void log_stored_result(uint64_t id, const CommandResult &result);
+
     std::map<uint64_t, CommandResult> results_;
+    // ID of every store, in order, for visit_results_since.
+    std::vector<uint64_t> store_log_;
     mutable std::mutex mutex_;
 };
 
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ResultRepository.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace MITSU_Domoe {
+
+// Everything needed to rebuild a session without re-running commands or re-parsing logs.
+//
+// File layout (native little-endian):
+//   header  : magic[8] "MITSUSNP", u32 version, u32 reserved,
+//             u64 next_command_id, u64 result_count, u64 attachment_count,
+//             u64 attachments_offset, u64 index_offset
+//   results : per result u64 id, u8 kind (0 = success, 1 = error) followed by length-prefixed strings
+//   attachments : length-prefixed name/content pairs
+//   index   : u64 offset of every result record, so records can be decoded in parallel
+struct SessionSnapshot {
+    uint64_t next_command_id = 1;
+    std::vector<std::pair<uint64_t, CommandResult>> results;
+    // Opaque client state (e.g. GUI render settings) keyed by name.
+    std::map<std::string, std::string> attachments;
+};
+
+// Writes a copy of every result in the repository, taken under its lock; the file is written
+// after the lock is released. Returns false and logs on failure.
+bool write_session_snapshot(const std::filesystem::path& path, const ResultRepository& repo,
+                            uint64_t next_command_id, const std::map<std::string, std::string>& attachments);
+
+// Memory-maps the file and decodes the records on the shared thread pool.
+// Returns std::nullopt and logs on failure.
+std::optional<SessionSnapshot> read_session_snapshot(const std::filesystem::path& path);
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "FastParse.hpp"
+#include "MappedFile.hpp"
+#include "MeshNormals.hpp"
+#include "ThreadPool.hpp"
+#include "VertexWelder.hpp"
+
+#include <Eigen/Core>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace stl_detail
+    {
+        constexpr size_t HEADER_SIZE = 80;
+        constexpr size_t TRIANGLE_SIZE = 50; // normal, 3 vertices (12 float32), uint16 attribute
+
+        // STL stores little-endian float32.
+        inline float load_float_le(const char *p)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, p, sizeof(bits));
+            if constexpr (std::endian::native == std::endian::big)
+            {
+                bits = ((bits & 0xff) << 24) | ((bits & 0xff00) << 8) | ((bits >> 8) & 0xff00) | (bits >> 24);
+            }
+            return std::bit_cast<float>(bits);
+        }
+
+        inline uint32_t load_uint32_le(const char *p)
+        {
+            const auto *b = reinterpret_cast<const unsigned char *>(p);
+            return static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) |
+                   (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+        }
+
+        // Whether [p, end) starts like an ASCII STL: "solid" and a name, then "facet" or "endsolid"
+        // opening the next line.
+        inline bool starts_like_ascii(const char *p, const char *end)
+        {
+            namespace fp = fast_parse;
+            if (fp::next_token(p, end) != "solid")
+            {
+                return false;
+            }
+            p = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!p)
+            {
+                return false;
+            }
+            const std::string_view token = fp::next_token(p, end);
+            return token == "facet" || token == "endsolid";
+        }
+
+        // Binary files are recognized by their size, which must cover the triangle count stored after
+        // the header: ASCII files may start with "solid" too, but binary exporters also often write
+        // "solid" into the 80-byte header. Some exporters pad the end, so a larger file is binary as
+        // well unless its header reads as ASCII. head holds the first HEADER_SIZE + 4 bytes.
+        inline bool is_binary(const char *head, uint64_t file_size)
+        {
+            if (file_size < HEADER_SIZE + 4)
+            {
+                return false;
+            }
+            const uint64_t size = HEADER_SIZE + 4 + load_uint32_le(head + HEADER_SIZE) * TRIANGLE_SIZE;
+            return file_size == size || (file_size > size && !starts_like_ascii(head, head + HEADER_SIZE + 4));
+        }
+
+        inline bool is_binary(const MappedFile &file)
+        {
+            return is_binary(file.data(), file.size());
+        }
+
+        // Triangle soup as float32 positions, 9 per triangle, parsed in parallel chunks.
+        inline std::vector<float> parse_binary(const MappedFile &file)
+        {
+            const size_t count = load_uint32_le(file.data() + HEADER_SIZE);
+            const char *records = file.data() + HEADER_SIZE + 4;
+            std::vector<float> soup(count * 9);
+            parallel_for(0, count, [&](size_t begin, size_t end)
+                         {
+                for (size_t t = begin; t < end; ++t)
+                {
+                    const char *vertices = records + t * TRIANGLE_SIZE + 12; // skip the stored normal
+                    for (size_t k = 0; k < 9; ++k)
+                    {
+                        soup[9 * t + k] = load_float_le(vertices + 4 * k);
+                    }
+                } }, 1 << 16);
+            return soup;
+        }
+
+        // Collects the coordinates following every "vertex" keyword; the facet structure around them
+        // carries no extra information.
+        inline std::vector<float> parse_ascii(const MappedFile &file)
+        {
+            namespace fp = fast_parse;
+            std::vector<float> soup;
+            const char *p = file.data();
+            const char *end = p + file.size();
+            while (p < end)
+            {
+                const std::string_view token = fp::next_token(p, end);
+                if (token != "vertex")
+                {
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    float value;
+                    p = fp::parse_number(p, end, value);
+                    if (!p)
+                    {
+                        throw std::runtime_error("Malformed vertex in ASCII STL.");
+                    }
+                    soup.push_back(value);
+                }
+            }
+            if (soup.empty())
+            {
+                throw std::runtime_error("No facets found in ASCII STL.");
+            }
+            if (soup.size() % 9 != 0)
+            {
+                throw std::runtime_error("ASCII STL vertex count is not a multiple of three.");
+            }
+            return soup;
+        }
+    } // namespace stl_detail
+
+    // Reads a binary or ASCII STL file through a memory mapping.
+    // With weld_tolerance >= 0, corners that coincide (0) or lie within the tolerance are merged into
+    // shared vertices (see weld_vertices); with a negative tolerance V keeps three vertices per face.
+    // N receives the unit normal of every face, computed from the vertices rather than trusting the file.
+    // Throws std::runtime_error if the file cannot be read or parsed.
+    inline Polygon_mesh read_stl(const std::filesystem::path &path, double weld_tolerance = 0.0)
+    {
+        const MappedFile file(path);
+        const std::vector<float> soup = stl_detail::is_binary(file) ? stl_detail::parse_binary(file) : stl_detail::parse_ascii(file);
+        const size_t num_faces = soup.size() / 9;
+        const size_t num_corners = num_faces * 3;
+
+        Polygon_mesh mesh;
+        mesh.F.resize(num_faces, 3);
+        auto corner_position = [&soup](size_t c)
+        {
+            return Eigen::Vector3d(soup[3 * c], soup[3 * c + 1], soup[3 * c + 2]);
+        };
+
+        if (weld_tolerance >= 0.0)
+        {
+            const WeldResult weld = weld_vertices(num_corners, corner_position, weld_tolerance);
+            mesh.V.resize(weld.representatives.size(), 3);
+            parallel_for(0, weld.representatives.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t v = begin; v < end; ++v)
+                {
+                    mesh.V.row(v) = corner_position(weld.representatives[v]).transpose();
+                } });
+            parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                         {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        mesh.F(f, k) = weld.remap[3 * f + k];
+                    }
+                } });
+        }
+        else
+        {
+            mesh.V.resize(num_corners, 3);
+            parallel_for(0, num_corners, [&](size_t begin, size_t end)
+                         {
+                for (size_t c = begin; c < end; ++c)
+                {
+                    mesh.V.row(c) = corner_position(c).transpose();
+                    mesh.F(c / 3, c % 3) = static_cast<int>(c);
+                } });
+        }
+
+        mesh.N = compute_face_normals(mesh.V, mesh.F);
+        mesh.normal_kind = Normal_kind::face;
+        return mesh;
+    }
+
+} // namespace MITSU_Domoe
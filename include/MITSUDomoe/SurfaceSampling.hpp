@@ -0,0 +1,354 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Clustering.hpp"
+#include "DerivedData.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace sampling_detail
+    {
+        // Samples are drawn in fixed blocks, each from its own random stream, so the result depends
+        // on the seed but not on the number of threads.
+        constexpr size_t BLOCK_SIZE = 1 << 12;
+        // Poisson-disk candidates drawn per radius^2 of surface. Enough for the accepted set to be
+        // close to maximal.
+        constexpr double CANDIDATES_PER_RADIUS_AREA = 8.0;
+        constexpr size_t MAX_CANDIDATES = size_t(1) << 27;
+        // Area per sample of a maximal Poisson-disk set, in radius^2.
+        constexpr double POISSON_AREA_PER_SAMPLE = 2.1;
+
+        // SplitMix64 stream; stream selects an independent sequence for the same seed.
+        class Random
+        {
+        public:
+            Random(uint64_t seed, uint64_t stream) : state_(mix(seed) ^ mix(stream + 0x632BE59BD9B4E019ull)) {}
+
+            uint64_t next()
+            {
+                return mix(state_ += 0x9E3779B97F4A7C15ull);
+            }
+
+            // Uniform in [0, 1).
+            double uniform()
+            {
+                return static_cast<double>(next() >> 11) * 0x1.0p-53;
+            }
+
+        private:
+            static uint64_t mix(uint64_t z)
+            {
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            }
+
+            uint64_t state_;
+        };
+
+        inline double surface_area(const FaceGeometry &geometry)
+        {
+            return geometry.areas.sum();
+        }
+
+        // Walker's alias table over the faces, weighted by area: a face is drawn in constant time
+        // by picking a slot uniformly and keeping it or taking its alias.
+        struct AliasTable
+        {
+            std::vector<double> probabilities;
+            std::vector<int> aliases;
+
+            explicit AliasTable(const Eigen::VectorXd &weights)
+                : probabilities(static_cast<size_t>(weights.size())), aliases(static_cast<size_t>(weights.size()))
+            {
+                const size_t size = probabilities.size();
+                const double total = weights.sum();
+                std::vector<int> small, large;
+                for (size_t i = 0; i < size; ++i)
+                {
+                    probabilities[i] = weights(i) * static_cast<double>(size) / total;
+                    aliases[i] = static_cast<int>(i);
+                    (probabilities[i] < 1.0 ? small : large).push_back(static_cast<int>(i));
+                }
+                while (!small.empty() && !large.empty())
+                {
+                    const int less = small.back();
+                    small.pop_back();
+                    const int more = large.back();
+                    aliases[less] = more;
+                    probabilities[more] -= 1.0 - probabilities[less];
+                    if (probabilities[more] < 1.0)
+                    {
+                        large.pop_back();
+                        small.push_back(more);
+                    }
+                }
+                // Left over only through rounding.
+                for (const int i : small)
+                {
+                    probabilities[i] = 1.0;
+                }
+                for (const int i : large)
+                {
+                    probabilities[i] = 1.0;
+                }
+            }
+
+            int draw(double u, double v) const
+            {
+                const size_t slot = std::min(probabilities.size() - 1, static_cast<size_t>(u * static_cast<double>(probabilities.size())));
+                return v < probabilities[slot] ? static_cast<int>(slot) : aliases[slot];
+            }
+        };
+
+        // count points, area-weighted: a face is drawn from an AliasTable, then a point uniformly
+        // inside it. Normals are interpolated from per-vertex mesh normals when the mesh has them,
+        // otherwise they are the face normals.
+        inline Point_cloud sample_uniform(const Polygon_mesh &mesh, const FaceGeometry &geometry, size_t count, uint64_t seed)
+        {
+            const Eigen::MatrixXd &V = mesh.V;
+            const Eigen::MatrixXi &F = mesh.F;
+            const double total_area = surface_area(geometry);
+            if (!(total_area > 0.0) || !std::isfinite(total_area))
+            {
+                throw std::invalid_argument("The mesh has no surface area to sample.");
+            }
+            const AliasTable faces(geometry.areas);
+            const bool vertex_normals = has_vertex_normals(mesh);
+
+            Point_cloud points;
+            points.positions.resize(count, 3);
+            points.normals.resize(count, 3);
+            const size_t num_blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                         {
+                for (size_t b = begin; b < end; ++b)
+                {
+                    Random random(seed, b);
+                    for (size_t i = b * BLOCK_SIZE; i < std::min(count, (b + 1) * BLOCK_SIZE); ++i)
+                    {
+                        const double pick = random.uniform();
+                        const int f = faces.draw(pick, random.uniform());
+                        const double root = std::sqrt(random.uniform());
+                        const double u = random.uniform();
+                        const Eigen::Vector3d weights(1.0 - root, root * (1.0 - u), root * u);
+                        Eigen::Vector3d position = Eigen::Vector3d::Zero();
+                        Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+                        for (int j = 0; j < 3; ++j)
+                        {
+                            position += weights(j) * V.row(F(f, j)).transpose();
+                            if (vertex_normals)
+                            {
+                                normal += weights(j) * mesh.N.row(F(f, j)).transpose();
+                            }
+                        }
+                        const double length = normal.norm();
+                        points.positions.row(i) = position.transpose();
+                        points.normals.row(i) = length > 0.0 ? Eigen::RowVector3d(normal.transpose() / length) : Eigen::RowVector3d(geometry.normals.row(f));
+                    }
+                } }, 1);
+            return points;
+        }
+
+        using Cell = std::array<int64_t, 3>;
+
+        // The points of candidates at least radius apart, chosen by dart throwing over a grid of
+        // cells of side radius. Conflicting points lie in neighbouring cells, so the cells are
+        // processed in 27 phases by their coordinates modulo 3: cells of one phase are at least two
+        // cells apart and are handled in parallel, each trying its candidates in index order. The
+        // accepted set does not depend on the number of threads.
+        inline std::vector<int> poisson_disk(const Eigen::MatrixXd &candidates, double radius)
+        {
+            struct Candidate
+            {
+                Cell cell;
+                int index;
+
+                bool operator<(const Candidate &other) const
+                {
+                    return cell != other.cell ? cell < other.cell : index < other.index;
+                }
+            };
+
+            const size_t num_candidates = static_cast<size_t>(candidates.rows());
+            const Eigen::RowVector3d origin = candidates.colwise().minCoeff();
+            std::vector<Candidate> sorted(num_candidates);
+            parallel_for(0, num_candidates, [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        sorted[i].cell[axis] = static_cast<int64_t>(std::floor((candidates(i, axis) - origin(axis)) / radius));
+                    }
+                    sorted[i].index = static_cast<int>(i);
+                } });
+            std::sort(sorted.begin(), sorted.end());
+
+            // Candidates grouped by cell, cells in lexicographic order.
+            std::vector<Cell> cells;
+            std::vector<int> cell_offsets;
+            for (size_t i = 0; i < num_candidates; ++i)
+            {
+                if (i == 0 || sorted[i].cell != cells.back())
+                {
+                    cells.push_back(sorted[i].cell);
+                    cell_offsets.push_back(static_cast<int>(i));
+                }
+            }
+            cell_offsets.push_back(static_cast<int>(num_candidates));
+            const size_t num_cells = cells.size();
+
+            std::vector<int> ids(num_candidates);
+            std::vector<Eigen::Vector3d> points(num_candidates);
+            std::vector<std::array<int, 27>> neighbours(num_cells);
+            parallel_for(0, num_cells, [&](size_t begin, size_t end)
+                         {
+                // A neighbour offset shifts cells without changing their order, so every offset
+                // keeps a cursor that only moves forward over the cells of the range.
+                std::array<size_t, 27> cursors;
+                for (size_t c = begin; c < end; ++c)
+                {
+                    for (int i = cell_offsets[c]; i < cell_offsets[c + 1]; ++i)
+                    {
+                        ids[i] = sorted[i].index;
+                        points[i] = candidates.row(sorted[i].index).transpose();
+                    }
+                    int n = 0;
+                    for (int64_t dx = -1; dx <= 1; ++dx)
+                    {
+                        for (int64_t dy = -1; dy <= 1; ++dy)
+                        {
+                            for (int64_t dz = -1; dz <= 1; ++dz)
+                            {
+                                const Cell cell = {cells[c][0] + dx, cells[c][1] + dy, cells[c][2] + dz};
+                                size_t &cursor = cursors[n];
+                                if (c == begin)
+                                {
+                                    cursor = std::lower_bound(cells.begin(), cells.end(), cell) - cells.begin();
+                                }
+                                while (cursor < num_cells && cells[cursor] < cell)
+                                {
+                                    ++cursor;
+                                }
+                                neighbours[c][n++] = cursor < num_cells && cells[cursor] == cell ? static_cast<int>(cursor) : -1;
+                            }
+                        }
+                    }
+                } });
+            sorted = std::vector<Candidate>();
+
+            std::array<std::vector<int>, 27> phases;
+            for (size_t c = 0; c < num_cells; ++c)
+            {
+                phases[(cells[c][0] % 3) * 9 + (cells[c][1] % 3) * 3 + cells[c][2] % 3].push_back(static_cast<int>(c));
+            }
+
+            // The accepted candidates of cell c are moved to the front of its range in order:
+            // [cell_offsets[c], cell_offsets[c] + num_accepted[c]) of ids and points.
+            std::vector<int> num_accepted(num_cells, 0);
+            const double radius_squared = radius * radius;
+            for (const std::vector<int> &phase : phases)
+            {
+                parallel_for(0, phase.size(), [&](size_t begin, size_t end)
+                             {
+                    for (size_t p = begin; p < end; ++p)
+                    {
+                        const int c = phase[p];
+                        for (int i = cell_offsets[c]; i < cell_offsets[c + 1]; ++i)
+                        {
+                            const Eigen::Vector3d point = points[i];
+                            bool free = true;
+                            for (int n = 0; n < 27 && free; ++n)
+                            {
+                                const int neighbour = neighbours[c][n];
+                                if (neighbour < 0)
+                                {
+                                    continue;
+                                }
+                                for (int k = cell_offsets[neighbour]; k < cell_offsets[neighbour] + num_accepted[neighbour]; ++k)
+                                {
+                                    if ((points[k] - point).squaredNorm() < radius_squared)
+                                    {
+                                        free = false;
+                                        break;
+                                    }
+                                }
+                            }
+                            if (free)
+                            {
+                                const int slot = cell_offsets[c] + num_accepted[c]++;
+                                ids[slot] = ids[i];
+                                points[slot] = point;
+                            }
+                        }
+                    } });
+            }
+
+            std::vector<int> accepted;
+            for (size_t c = 0; c < num_cells; ++c)
+            {
+                accepted.insert(accepted.end(), ids.begin() + cell_offsets[c], ids.begin() + cell_offsets[c] + num_accepted[c]);
+            }
+            std::sort(accepted.begin(), accepted.end());
+            return accepted;
+        }
+    } // namespace sampling_detail
+
+    // count points uniformly distributed over the surface of a triangle mesh, with their normals.
+    // The same seed gives the same points whatever the number of threads.
+    inline Point_cloud sample_surface_uniform(const Polygon_mesh &mesh, size_t count, uint64_t seed)
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        const std::shared_ptr<const FaceGeometry> geometry = MeshDerivedData(mesh).face_geometry();
+        return sampling_detail::sample_uniform(mesh, *geometry, count, seed);
+    }
+
+    // Poisson-disk sample of the surface of a triangle mesh: points no closer than radius
+    // (Euclidean) to each other, and leaving no gap where another would fit, up to the candidates
+    // drawn. The same seed gives the same points whatever the number of threads.
+    inline Point_cloud sample_surface_poisson(const Polygon_mesh &mesh, double radius, uint64_t seed)
+    {
+        cluster_detail::check_triangle_mesh(mesh);
+        if (!(radius > 0.0) || !std::isfinite(radius))
+        {
+            throw std::invalid_argument("radius must be positive.");
+        }
+        const std::shared_ptr<const FaceGeometry> geometry = MeshDerivedData(mesh).face_geometry();
+        const double num_candidates = std::ceil(sampling_detail::CANDIDATES_PER_RADIUS_AREA * sampling_detail::surface_area(*geometry) / (radius * radius));
+        if (!(num_candidates <= static_cast<double>(sampling_detail::MAX_CANDIDATES)))
+        {
+            throw std::invalid_argument("radius is too small for the size of the mesh.");
+        }
+        const Point_cloud candidates = sampling_detail::sample_uniform(mesh, *geometry, static_cast<size_t>(num_candidates), seed);
+        const std::vector<int> accepted = sampling_detail::poisson_disk(candidates.positions, radius);
+        Point_cloud points;
+        points.positions.resize(accepted.size(), 3);
+        points.normals.resize(accepted.size(), 3);
+        for (size_t i = 0; i < accepted.size(); ++i)
+        {
+            points.positions.row(i) = candidates.positions.row(accepted[i]);
+            points.normals.row(i) = candidates.normals.row(accepted[i]);
+        }
+        return points;
+    }
+
+    // Radius for which sample_surface_poisson gives about count points on a surface of this area.
+    inline double poisson_disk_radius(double area, size_t count)
+    {
+        return std::sqrt(area / (sampling_detail::POISSON_AREA_PER_SAMPLE * static_cast<double>(count)));
+    }
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    // Fixed-size pool of worker threads. One process-wide instance (shared()) is used by
+    // log ingestion and by the parallel cartridge kernels.
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t num_threads = std::max(1u, std::thread::hardware_concurrency()))
+        {
+            workers_.reserve(num_threads);
+            for (size_t i = 0; i < num_threads; ++i)
+            {
+                workers_.emplace_back(&ThreadPool::worker_loop, this);
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                stop_flag_ = true;
+            }
+            condition_.notify_all();
+            for (auto &worker : workers_)
+            {
+                if (worker.joinable())
+                {
+                    worker.join();
+                }
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        static ThreadPool &shared()
+        {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        size_t size() const { return workers_.size(); }
+
+        // Queues f and returns a future for its result.
+        template <typename F>
+        auto submit(F &&f) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+        {
+            using R = std::invoke_result_t<std::decay_t<F>>;
+            auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+            auto future = task->get_future();
+            enqueue([task]
+                    { (*task)(); });
+            return future;
+        }
+
+        // Queues f without a future. f must not throw.
+        void enqueue(std::function<void()> f)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                tasks_.push(std::move(f));
+            }
+            condition_.notify_one();
+        }
+
+    private:
+        void worker_loop()
+        {
+            while (true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex_);
+                    condition_.wait(lock, [this]
+                                    { return !tasks_.empty() || stop_flag_; });
+                    if (stop_flag_ && tasks_.empty())
+                    {
+                        return;
+                    }
+                    task = std::move(tasks_.front());
+                    tasks_.pop();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> workers_;
+        std::queue<std::function<void()>> tasks_;
+        std::mutex queue_mutex_;
+        std::condition_variable condition_;
+        bool stop_flag_ = false;
+    };
+
+    // Calls fn(chunk_begin, chunk_end) for consecutive chunks of [first, last) on the shared pool.
+    // The calling thread works on chunks too and only waits for chunks that are already running,
+    // so it is safe to call from a pool task or from several command workers at once.
+    // grain_size == 0 picks about four chunks per pool thread. The first exception is rethrown.
+    template <typename Fn>
+    void parallel_for(size_t first, size_t last, Fn &&fn, size_t grain_size = 0)
+    {
+        if (first >= last)
+        {
+            return;
+        }
+        ThreadPool &pool = ThreadPool::shared();
+        const size_t count = last - first;
+        if (grain_size == 0)
+        {
+            grain_size = std::max<size_t>(1, count / (pool.size() * 4));
+        }
+        const size_t num_chunks = (count + grain_size - 1) / grain_size;
+        if (num_chunks == 1 || pool.size() == 1)
+        {
+            fn(first, last);
+            return;
+        }
+
+        struct State
+        {
+            std::atomic<size_t> next_chunk{0};
+            std::atomic<size_t> finished_chunks{0};
+            std::mutex mutex;
+            std::condition_variable done;
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<State>();
+
+        // Helpers that start after every chunk has been claimed return without touching fn.
+        auto run_chunks = [state, first, last, grain_size, num_chunks, &fn]
+        {
+            size_t chunk;
+            while ((chunk = state->next_chunk.fetch_add(1)) < num_chunks)
+            {
+                const size_t chunk_begin = first + chunk * grain_size;
+                const size_t chunk_end = std::min(last, chunk_begin + grain_size);
+                try
+                {
+                    fn(chunk_begin, chunk_end);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (!state->error)
+                    {
+                        state->error = std::current_exception();
+                    }
+                }
+                if (state->finished_chunks.fetch_add(1) + 1 == num_chunks)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->done.notify_all();
+                }
+            }
+        };
+
+        const size_t num_helpers = std::min(pool.size(), num_chunks - 1);
+        for (size_t i = 0; i < num_helpers; ++i)
+        {
+            pool.enqueue(run_chunks);
+        }
+        run_chunks();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&]
+                         { return state->finished_chunks.load() == num_chunks; });
+        if (state->error)
+        {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+} // namespace MITSU_Domoe
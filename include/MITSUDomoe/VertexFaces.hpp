@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    // Faces around every vertex in CSR form: the faces at vertex v are faces[offsets[v], offsets[v + 1]),
+    // ascending. A face is listed once per corner, so a face with a repeated vertex appears twice.
+    struct VertexFaces
+    {
+        std::vector<int> offsets;
+        std::vector<int> faces;
+    };
+
+    // Builds the incidence of a face index matrix whose entries are all in [0, num_vertices).
+    inline VertexFaces vertex_faces(const Eigen::MatrixXi &F, Eigen::Index num_vertices)
+    {
+        VertexFaces incidence;
+        incidence.offsets.assign(num_vertices + 1, 0);
+        parallel_for(0, static_cast<size_t>(F.size()), [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                std::atomic_ref<int>(incidence.offsets[F.data()[i] + 1]).fetch_add(1, std::memory_order_relaxed);
+            } });
+        for (Eigen::Index v = 0; v < num_vertices; ++v)
+        {
+            incidence.offsets[v + 1] += incidence.offsets[v];
+        }
+        std::vector<int> cursor(incidence.offsets.begin(), incidence.offsets.end() - 1);
+        incidence.faces.resize(F.size());
+        parallel_for(0, static_cast<size_t>(F.rows()), [&](size_t begin, size_t end)
+                     {
+            for (size_t f = begin; f < end; ++f)
+            {
+                for (Eigen::Index j = 0; j < F.cols(); ++j)
+                {
+                    const int slot = std::atomic_ref<int>(cursor[F(f, j)]).fetch_add(1, std::memory_order_relaxed);
+                    incidence.faces[slot] = static_cast<int>(f);
+                }
+            } });
+        // The concurrent fill leaves every list in a different order from run to run; sorting them
+        // makes everything summed over the faces of a vertex reproducible.
+        parallel_for(0, static_cast<size_t>(num_vertices), [&](size_t begin, size_t end)
+                     {
+            for (size_t v = begin; v < end; ++v)
+            {
+                std::sort(incidence.faces.begin() + incidence.offsets[v], incidence.faces.begin() + incidence.offsets[v + 1]);
+            } });
+        return incidence;
+    }
+
+} // namespace MITSU_Domoe
@@ -0,0 +1,357 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    struct WeldResult
+    {
+        // New vertex index of every input point.
+        std::vector<int> remap;
+        // For every new vertex, the input point whose position it takes: the lowest index in its cluster.
+        std::vector<size_t> representatives;
+    };
+
+    namespace detail
+    {
+        // Bit patterns of the coordinates, with -0.0 folded into 0.0 so they compare equal.
+        inline std::array<uint64_t, 3> exact_key(const Eigen::Vector3d &p)
+        {
+            std::array<uint64_t, 3> key;
+            for (int i = 0; i < 3; ++i)
+            {
+                key[i] = std::bit_cast<uint64_t>(p(i) + 0.0);
+            }
+            return key;
+        }
+
+        // Slots are taken from the low bits, which a multiply only fills from the low bits of its input.
+        // Coordinates on a grid leave the low mantissa bits zero, so every word is finalized with the
+        // shifts of MurmurHash3's fmix64 to spread its high bits down.
+        inline uint64_t hash_key(const std::array<uint64_t, 3> &key)
+        {
+            uint64_t h = 0x9E3779B97F4A7C15ull;
+            for (const uint64_t k : key)
+            {
+                h = (h ^ k) * 0xBF58476D1CE4E5B9ull;
+                h ^= h >> 33;
+            }
+            h *= 0xFF51AFD7ED558CCDull;
+            h ^= h >> 33;
+            h *= 0xC4CEB9FE1A85EC53ull;
+            return h ^ (h >> 33);
+        }
+
+        // Lock-free open-addressing hash table of item indices. key(i) returns a std::array<uint64_t, 3>
+        // and must be safe to call from several threads; the table holds room for count items. Each
+        // slot holds the lowest index inserted with its key, so the contents do not depend on the order
+        // of concurrent inserts.
+        template <typename KeyFn>
+        class ConcurrentKeyTable
+        {
+        public:
+            static constexpr uint32_t EMPTY = UINT32_MAX;
+
+            ConcurrentKeyTable(size_t count, KeyFn key)
+                : key_(std::forward<KeyFn>(key)), capacity_(std::bit_ceil(std::max<size_t>(16, 2 * count))),
+                  table_(new std::atomic<uint32_t>[capacity_])
+            {
+                parallel_for(0, capacity_, [&](size_t begin, size_t end)
+                             {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        table_[i].store(EMPTY, std::memory_order_relaxed);
+                    } });
+            }
+
+            void insert(uint32_t i)
+            {
+                const auto item_key = key_(i);
+                const size_t mask = capacity_ - 1;
+                size_t slot = hash_key(item_key) & mask;
+                while (true)
+                {
+                    uint32_t current = table_[slot].load(std::memory_order_acquire);
+                    // A failed exchange leaves the item that took the slot in current.
+                    if (current == EMPTY &&
+                        table_[slot].compare_exchange_strong(current, i, std::memory_order_acq_rel))
+                    {
+                        return;
+                    }
+                    if (key_(current) == item_key)
+                    {
+                        // Once occupied, a slot only ever holds items with this key, so keeping the minimum is enough.
+                        while (i < current && !table_[slot].compare_exchange_weak(current, i, std::memory_order_acq_rel))
+                        {
+                        }
+                        return;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+            }
+
+            // The lowest index inserted with this key, or EMPTY. Must not race with insert.
+            uint32_t find(const std::array<uint64_t, 3> &item_key) const
+            {
+                const size_t mask = capacity_ - 1;
+                size_t slot = hash_key(item_key) & mask;
+                uint32_t current;
+                while ((current = table_[slot].load(std::memory_order_relaxed)) != EMPTY && key_(current) != item_key)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                return current;
+            }
+
+        private:
+            KeyFn key_;
+            size_t capacity_;
+            std::unique_ptr<std::atomic<uint32_t>[]> table_;
+        };
+
+        // For every item, the lowest index of an item with the same key. key(i) is as for
+        // ConcurrentKeyTable.
+        template <typename KeyFn>
+        std::vector<uint32_t> first_occurrences(size_t count, KeyFn &&key)
+        {
+            ConcurrentKeyTable<KeyFn &> table(count, key);
+            parallel_for(0, count, [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    table.insert(static_cast<uint32_t>(i));
+                } });
+
+            std::vector<uint32_t> root(count);
+            parallel_for(0, count, [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    root[i] = table.find(key(i));
+                } });
+            return root;
+        }
+
+        // Concurrent union-find. Roots are always linked under the smaller root, so the root of a set
+        // is its smallest element no matter in which order threads perform the unions.
+        class ConcurrentDisjointSets
+        {
+        public:
+            explicit ConcurrentDisjointSets(size_t size)
+                : parent_(new std::atomic<uint32_t>[size]), size_(size)
+            {
+                parallel_for(0, size, [&](size_t begin, size_t end)
+                             {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        parent_[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+                    } });
+            }
+
+            uint32_t find(uint32_t x) const
+            {
+                uint32_t parent = parent_[x].load(std::memory_order_acquire);
+                while (parent != x)
+                {
+                    // Path halving: point x at its grandparent. Losing the race only skips the shortcut.
+                    const uint32_t grandparent = parent_[parent].load(std::memory_order_acquire);
+                    parent_[x].compare_exchange_weak(parent, grandparent, std::memory_order_acq_rel);
+                    x = parent;
+                    parent = parent_[x].load(std::memory_order_acquire);
+                }
+                return x;
+            }
+
+            void unite(uint32_t a, uint32_t b)
+            {
+                while (true)
+                {
+                    a = find(a);
+                    b = find(b);
+                    if (a == b)
+                    {
+                        return;
+                    }
+                    if (a > b)
+                    {
+                        std::swap(a, b);
+                    }
+                    uint32_t expected = b;
+                    if (parent_[b].compare_exchange_strong(expected, a, std::memory_order_acq_rel))
+                    {
+                        return;
+                    }
+                }
+            }
+
+            size_t size() const { return size_; }
+
+        private:
+            std::unique_ptr<std::atomic<uint32_t>[]> parent_;
+            size_t size_;
+        };
+    } // namespace detail
+
+    // Merges input points that share a position, or lie within tolerance of each other, into one vertex.
+    // point(i) returns the position of input point i as an Eigen::Vector3d and must be safe to call
+    // from several threads.
+    //
+    // Identical points are merged first through a lock-free open-addressing hash table. With a
+    // positive tolerance the distinct positions are then binned into cells of that size, kept in a
+    // second such table; every position is compared with the positions in its own and the 26
+    // neighbouring cells, and close pairs are joined in a concurrent union-find. Clusters are transitive, so a chain of points
+    // each within tolerance of the next becomes one vertex.
+    //
+    // The result is deterministic: every cluster is represented by its lowest input index, and new
+    // vertices are numbered in order of first appearance.
+    template <typename PointFn>
+    WeldResult weld_vertices(size_t num_points, PointFn &&point, double tolerance = 0.0)
+    {
+        WeldResult result;
+        result.remap.resize(num_points);
+        if (num_points == 0)
+        {
+            return result;
+        }
+
+        // 1. Exact duplicates.
+        std::vector<uint32_t> root = detail::first_occurrences(num_points, [&](size_t i)
+                                                               { return detail::exact_key(point(i)); });
+
+        // 2. Points within tolerance, compared between distinct positions only.
+        if (tolerance > 0.0)
+        {
+            std::vector<uint32_t> distinct;
+            for (size_t i = 0; i < num_points; ++i)
+            {
+                if (root[i] == i)
+                {
+                    distinct.push_back(static_cast<uint32_t>(i));
+                }
+            }
+
+            // Cells are identified by their lowest position and found through a hash table, and the
+            // positions are grouped by cell with a counting pass, so every step is linear.
+            std::vector<std::array<uint64_t, 3>> cells(distinct.size());
+            parallel_for(0, distinct.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t k = begin; k < end; ++k)
+                {
+                    const Eigen::Vector3d p = point(distinct[k]);
+                    for (int d = 0; d < 3; ++d)
+                    {
+                        cells[k][d] = static_cast<uint64_t>(static_cast<int64_t>(std::floor(p(d) / tolerance)));
+                    }
+                } });
+            const auto cell_key = [&cells](size_t k)
+            { return cells[k]; };
+            detail::ConcurrentKeyTable<decltype(cell_key)> cell_table(distinct.size(), cell_key);
+            parallel_for(0, distinct.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t k = begin; k < end; ++k)
+                {
+                    cell_table.insert(static_cast<uint32_t>(k));
+                } });
+
+            // cell_of[k] is the lowest position in the cell of k; the members of cell c are
+            // members[first_member[c], first_member[c + 1]).
+            std::vector<uint32_t> cell_of(distinct.size());
+            std::vector<uint32_t> first_member(distinct.size() + 1, 0);
+            parallel_for(0, distinct.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t k = begin; k < end; ++k)
+                {
+                    cell_of[k] = cell_table.find(cells[k]);
+                    std::atomic_ref<uint32_t>(first_member[cell_of[k] + 1]).fetch_add(1, std::memory_order_relaxed);
+                } });
+            std::partial_sum(first_member.begin(), first_member.end(), first_member.begin());
+            std::vector<uint32_t> members(distinct.size());
+            {
+                std::vector<uint32_t> next_member(first_member.begin(), first_member.end() - 1);
+                parallel_for(0, distinct.size(), [&](size_t begin, size_t end)
+                             {
+                    for (size_t k = begin; k < end; ++k)
+                    {
+                        members[std::atomic_ref<uint32_t>(next_member[cell_of[k]]).fetch_add(1, std::memory_order_relaxed)] = static_cast<uint32_t>(k);
+                    } });
+            }
+
+            // Members of a cell are stored in no particular order, but each close pair is joined
+            // whatever the order, and the union-find root does not depend on it.
+            detail::ConcurrentDisjointSets sets(distinct.size());
+            const double tolerance_squared = tolerance * tolerance;
+            parallel_for(0, distinct.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t k = begin; k < end; ++k)
+                {
+                    const Eigen::Vector3d p = point(distinct[k]);
+                    for (int64_t dx = -1; dx <= 1; ++dx)
+                    for (int64_t dy = -1; dy <= 1; ++dy)
+                    for (int64_t dz = -1; dz <= 1; ++dz)
+                    {
+                        const std::array<uint64_t, 3> neighbour{cells[k][0] + static_cast<uint64_t>(dx), cells[k][1] + static_cast<uint64_t>(dy), cells[k][2] + static_cast<uint64_t>(dz)};
+                        const uint32_t cell = cell_table.find(neighbour);
+                        if (cell == cell_table.EMPTY)
+                        {
+                            continue;
+                        }
+                        for (uint32_t m = first_member[cell]; m < first_member[cell + 1]; ++m)
+                        {
+                            // Each pair is tested once, from its lower position.
+                            const uint32_t other = members[m];
+                            if (other > k && (point(distinct[other]) - p).squaredNorm() <= tolerance_squared)
+                            {
+                                sets.unite(static_cast<uint32_t>(k), other);
+                            }
+                        }
+                    }
+                } });
+
+            // Positions in distinct are in input order, so the set root is also the lowest input index.
+            std::vector<uint32_t> position_of(num_points);
+            for (size_t k = 0; k < distinct.size(); ++k)
+            {
+                position_of[distinct[k]] = static_cast<uint32_t>(k);
+            }
+            parallel_for(0, num_points, [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    root[i] = distinct[sets.find(position_of[root[i]])];
+                } });
+        }
+
+        // 3. Number the clusters in order of first appearance.
+        std::vector<int> new_index(num_points, -1);
+        for (size_t i = 0; i < num_points; ++i)
+        {
+            if (root[i] == i)
+            {
+                new_index[i] = static_cast<int>(result.representatives.size());
+                result.representatives.push_back(i);
+            }
+        }
+        parallel_for(0, num_points, [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; ++i)
+            {
+                result.remap[i] = new_index[root[i]];
+            } });
+        return result;
+    }
+
+} // namespace MITSU_Domoe
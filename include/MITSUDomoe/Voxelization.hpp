@@ -0,0 +1,531 @@
+#pragma once
+
+#include "3D_objects.hpp"
+#include "Clustering.hpp"
+#include "DerivedData.hpp"
+#include "Geometry.hpp"
+#include "ThreadPool.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace MITSU_Domoe
+{
+
+    namespace voxel_detail
+    {
+        constexpr int BRICK_SIZE = 8;
+        // The grid is processed in columns of TILE_BRICKS x TILE_BRICKS bricks in y and z that span
+        // all of x, one column per task.
+        constexpr int TILE_BRICKS = 8;
+        constexpr int TILE_SIZE = BRICK_SIZE * TILE_BRICKS;
+        constexpr int MAX_RESOLUTION = 4096;
+        constexpr uint64_t FULL_WORD = ~uint64_t(0);
+
+        using Brick = std::array<int, 3>;
+
+        // Dense occupancy of one tile column, brick by brick. x is global, y and z are relative to
+        // the tile.
+        class TileColumn
+        {
+        public:
+            explicit TileColumn(int num_bricks_x)
+                : words_(static_cast<size_t>(num_bricks_x) * TILE_BRICKS * TILE_BRICKS * BRICK_SIZE, 0)
+            {
+            }
+
+            void set(int x, int y, int z)
+            {
+                words_[word_index(x, y, z)] |= uint64_t(1) << ((x & 7) + 8 * (y & 7));
+            }
+
+            // Sets voxels [first, last) along x.
+            void set_run(int first, int last, int y, int z)
+            {
+                while (first < last)
+                {
+                    const int count = std::min(last, (first | 7) + 1) - first;
+                    const uint64_t bits = count == 8 ? 0xFF : (uint64_t(1) << count) - 1;
+                    words_[word_index(first, y, z)] |= bits << ((first & 7) + 8 * (y & 7));
+                    first += count;
+                }
+            }
+
+            const uint64_t *brick(int bx, int by, int bz) const
+            {
+                return words_.data() + brick_index(bx, by, bz) * BRICK_SIZE;
+            }
+
+        private:
+            static size_t brick_index(int bx, int by, int bz)
+            {
+                return (static_cast<size_t>(bx) * TILE_BRICKS + by) * TILE_BRICKS + bz;
+            }
+
+            static size_t word_index(int x, int y, int z)
+            {
+                return brick_index(x >> 3, y >> 3, z >> 3) * BRICK_SIZE + (z & 7);
+            }
+
+            std::vector<uint64_t> words_;
+        };
+
+        // Edge function of p against the 2D edge (u, v), positive on its left. It is evaluated from
+        // the lexicographically smaller end, so the two triangles sharing an edge get exactly opposite
+        // values and no sample falls between them.
+        inline double edge_function(const Eigen::Vector2d &u, const Eigen::Vector2d &v, const Eigen::Vector2d &p)
+        {
+            const bool forward = u(0) < v(0) || (u(0) == v(0) && u(1) < v(1));
+            const Eigen::Vector2d &q = forward ? u : v;
+            const Eigen::Vector2d &w = forward ? v : u;
+            const double value = (w(0) - q(0)) * (p(1) - q(1)) - (w(1) - q(1)) * (p(0) - q(0));
+            return forward ? value : -value;
+        }
+
+        // Whether a sample exactly on edge (u, v) of a counter-clockwise triangle belongs to it. Of
+        // two triangles on either side of an edge, exactly one owns it.
+        inline bool owns_edge(const Eigen::Vector2d &u, const Eigen::Vector2d &v)
+        {
+            return v(0) > u(0) || (v(0) == u(0) && v(1) > u(1));
+        }
+
+        struct TileResult
+        {
+            std::vector<Brick> bricks;
+            std::vector<std::array<uint64_t, BRICK_SIZE>> brick_bits;
+            std::vector<Brick> full_bricks;
+        };
+
+        // Sorts rows of bricks (and the matching bit rows) into lexicographic order.
+        inline std::vector<int> sorted_order(const std::vector<Brick> &bricks)
+        {
+            std::vector<int> order(bricks.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](int a, int b)
+                      { return bricks[a] < bricks[b]; });
+            return order;
+        }
+    } // namespace voxel_detail
+
+    // Voxels of a triangle mesh on a grid with resolution voxels along the longest side of its
+    // bounding box. A voxel is occupied when a triangle overlaps it (separating axis test) or, with
+    // solid, when its center is inside the mesh: every column of voxel centers along x is crossed
+    // with the triangles and filled between pairs of crossings (scanline parity). A column with an
+    // odd number of crossings, where the mesh is not closed, is left as surface only.
+    //
+    // The grid is split into tile columns of 64 x 64 voxels in y and z, each voxelized densely on
+    // its own thread from the triangles that reach it and then reduced to bricks, so the result does
+    // not depend on the number of threads.
+    inline Voxel_grid voxelize_mesh(const Polygon_mesh &mesh, int resolution, bool solid)
+    {
+        using namespace voxel_detail;
+        cluster_detail::check_triangle_mesh(mesh);
+        if (resolution < 1 || resolution > MAX_RESOLUTION)
+        {
+            throw std::invalid_argument("resolution must be between 1 and " + std::to_string(MAX_RESOLUTION) + ".");
+        }
+        Voxel_grid grid;
+        if (mesh.F.rows() == 0)
+        {
+            return grid;
+        }
+
+        const std::shared_ptr<const Eigen::MatrixXd> bounds = MeshDerivedData(mesh).bounding_box();
+        const Eigen::RowVector3d extent = bounds->row(1) - bounds->row(0);
+        if (!(extent.maxCoeff() > 0.0) || !std::isfinite(extent.maxCoeff()))
+        {
+            throw std::invalid_argument("The mesh has no extent to voxelize.");
+        }
+        grid.origin = bounds->row(0);
+        grid.voxel_size = extent.maxCoeff() / resolution;
+        for (int k = 0; k < 3; ++k)
+        {
+            grid.dimensions(k) = std::clamp(static_cast<int>(std::ceil(extent(k) / grid.voxel_size)), 1, resolution);
+        }
+        const Eigen::Vector3i dimensions = grid.dimensions.transpose();
+
+        // Vertices in voxel units.
+        const Eigen::MatrixXd &V = mesh.V;
+        const Eigen::MatrixXi &F = mesh.F;
+        Eigen::MatrixXd G(V.rows(), 3);
+        parallel_for(0, static_cast<size_t>(V.rows()), [&](size_t begin, size_t end)
+                     {
+            for (size_t v = begin; v < end; ++v)
+            {
+                G.row(v) = (V.row(v) - grid.origin) / grid.voxel_size;
+            } });
+
+        // Voxel range of every triangle, and the triangles reaching every tile column.
+        const size_t num_faces = static_cast<size_t>(F.rows());
+        std::vector<std::array<int, 6>> ranges(num_faces);
+        parallel_for(0, num_faces, [&](size_t begin, size_t end)
+                     {
+            for (size_t f = begin; f < end; ++f)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    const double lo = std::min({G(F(f, 0), k), G(F(f, 1), k), G(F(f, 2), k)});
+                    const double hi = std::max({G(F(f, 0), k), G(F(f, 1), k), G(F(f, 2), k)});
+                    ranges[f][k] = std::clamp(static_cast<int>(std::floor(lo)), 0, dimensions(k) - 1);
+                    ranges[f][k + 3] = std::clamp(static_cast<int>(std::floor(hi)), 0, dimensions(k) - 1);
+                }
+            } });
+        const int tiles_y = (dimensions(1) + TILE_SIZE - 1) / TILE_SIZE;
+        const int tiles_z = (dimensions(2) + TILE_SIZE - 1) / TILE_SIZE;
+        const size_t num_tiles = static_cast<size_t>(tiles_y) * tiles_z;
+        std::vector<int> tile_offsets(num_tiles + 1, 0);
+        for (const auto &range : ranges)
+        {
+            for (int ty = range[1] / TILE_SIZE; ty <= range[4] / TILE_SIZE; ++ty)
+            {
+                for (int tz = range[2] / TILE_SIZE; tz <= range[5] / TILE_SIZE; ++tz)
+                {
+                    ++tile_offsets[static_cast<size_t>(ty) * tiles_z + tz + 1];
+                }
+            }
+        }
+        std::partial_sum(tile_offsets.begin(), tile_offsets.end(), tile_offsets.begin());
+        std::vector<int> tile_faces(tile_offsets.back());
+        {
+            std::vector<int> cursor(tile_offsets.begin(), tile_offsets.end() - 1);
+            for (size_t f = 0; f < num_faces; ++f)
+            {
+                for (int ty = ranges[f][1] / TILE_SIZE; ty <= ranges[f][4] / TILE_SIZE; ++ty)
+                {
+                    for (int tz = ranges[f][2] / TILE_SIZE; tz <= ranges[f][5] / TILE_SIZE; ++tz)
+                    {
+                        tile_faces[cursor[static_cast<size_t>(ty) * tiles_z + tz]++] = static_cast<int>(f);
+                    }
+                }
+            }
+        }
+
+        const int num_bricks_x = (dimensions(0) + BRICK_SIZE - 1) / BRICK_SIZE;
+        std::vector<TileResult> results(num_tiles);
+        parallel_for(0, num_tiles, [&](size_t begin, size_t end)
+                     {
+            for (size_t tile = begin; tile < end; ++tile)
+            {
+                const int y0 = static_cast<int>(tile / tiles_z) * TILE_SIZE;
+                const int z0 = static_cast<int>(tile % tiles_z) * TILE_SIZE;
+                const int y1 = std::min(y0 + TILE_SIZE, dimensions(1));
+                const int z1 = std::min(z0 + TILE_SIZE, dimensions(2));
+                TileColumn column(num_bricks_x);
+                // (column of voxel centers, x of the crossing), the column being (y - y0) * TILE_SIZE + z - z0.
+                std::vector<std::pair<int, double>> crossings;
+
+                for (int i = tile_offsets[tile]; i < tile_offsets[tile + 1]; ++i)
+                {
+                    const int f = tile_faces[i];
+                    const Eigen::Vector3d a = G.row(F(f, 0)).transpose();
+                    const Eigen::Vector3d b = G.row(F(f, 1)).transpose();
+                    const Eigen::Vector3d c = G.row(F(f, 2)).transpose();
+                    const auto &range = ranges[f];
+                    const int ylo = std::max(range[1], y0), yhi = std::min(range[4], y1 - 1);
+                    const int zlo = std::max(range[2], z0), zhi = std::min(range[5], z1 - 1);
+
+                    // Along the dominant axis w of the normal, only the few voxels the plane of the
+                    // triangle passes through are tested in each line of voxels.
+                    const Eigen::Vector3d half_extent = Eigen::Vector3d::Constant(0.5);
+                    const Eigen::Vector3d normal = (b - a).cross(c - a);
+                    int w = 0;
+                    normal.cwiseAbs().maxCoeff(&w);
+                    const int u = (w + 1) % 3, v = (w + 2) % 3;
+                    const int lo[3] = {range[0], ylo, zlo};
+                    const int hi[3] = {range[3], yhi, zhi};
+                    const double reach = half_extent.dot(normal.cwiseAbs());
+                    Eigen::Vector3d center;
+                    for (int iu = lo[u]; iu <= hi[u]; ++iu)
+                    {
+                        center(u) = iu + 0.5;
+                        for (int iv = lo[v]; iv <= hi[v]; ++iv)
+                        {
+                            center(v) = iv + 0.5;
+                            int first = lo[w], last = hi[w];
+                            if (normal(w) != 0.0)
+                            {
+                                const double offset = normal(u) * (center(u) - a(u)) + normal(v) * (center(v) - a(v));
+                                const double t0 = (-reach - offset) / normal(w) + a(w) - 0.5;
+                                const double t1 = (reach - offset) / normal(w) + a(w) - 0.5;
+                                first = std::max(first, static_cast<int>(std::ceil(std::min(t0, t1) - 1e-6)));
+                                last = std::min(last, static_cast<int>(std::floor(std::max(t0, t1) + 1e-6)));
+                            }
+                            for (int iw = first; iw <= last; ++iw)
+                            {
+                                center(w) = iw + 0.5;
+                                if (triangle_box_overlap(center, half_extent, a, b, c))
+                                {
+                                    column.set(static_cast<int>(center(0)), static_cast<int>(center(1)) - y0, static_cast<int>(center(2)) - z0);
+                                }
+                            }
+                        }
+                    }
+
+                    if (!solid)
+                    {
+                        continue;
+                    }
+                    // Projection onto (y, z), made counter-clockwise.
+                    Eigen::Vector2d p[3] = {a.tail<2>(), b.tail<2>(), c.tail<2>()};
+                    double heights[3] = {a(0), b(0), c(0)};
+                    const double area = edge_function(p[0], p[1], p[2]);
+                    if (area == 0.0)
+                    {
+                        continue;
+                    }
+                    if (area < 0.0)
+                    {
+                        std::swap(p[1], p[2]);
+                        std::swap(heights[1], heights[2]);
+                    }
+                    const int cy0 = std::max(static_cast<int>(std::ceil(std::min({p[0](0), p[1](0), p[2](0)}) - 0.5)), y0);
+                    const int cy1 = std::min(static_cast<int>(std::floor(std::max({p[0](0), p[1](0), p[2](0)}) - 0.5)), y1 - 1);
+                    const int cz0 = std::max(static_cast<int>(std::ceil(std::min({p[0](1), p[1](1), p[2](1)}) - 0.5)), z0);
+                    const int cz1 = std::min(static_cast<int>(std::floor(std::max({p[0](1), p[1](1), p[2](1)}) - 0.5)), z1 - 1);
+                    for (int y = cy0; y <= cy1; ++y)
+                    {
+                        for (int z = cz0; z <= cz1; ++z)
+                        {
+                            const Eigen::Vector2d sample(y + 0.5, z + 0.5);
+                            double weights[3];
+                            bool inside = true;
+                            for (int j = 0; j < 3 && inside; ++j)
+                            {
+                                const Eigen::Vector2d &u = p[(j + 1) % 3];
+                                const Eigen::Vector2d &v = p[(j + 2) % 3];
+                                weights[j] = edge_function(u, v, sample);
+                                inside = weights[j] > 0.0 || (weights[j] == 0.0 && owns_edge(u, v));
+                            }
+                            if (inside)
+                            {
+                                const double sum = weights[0] + weights[1] + weights[2];
+                                const double x = (weights[0] * heights[0] + weights[1] * heights[1] + weights[2] * heights[2]) / sum;
+                                crossings.emplace_back((y - y0) * TILE_SIZE + z - z0, x);
+                            }
+                        }
+                    }
+                }
+
+                if (solid)
+                {
+                    std::sort(crossings.begin(), crossings.end());
+                    for (size_t first = 0; first < crossings.size();)
+                    {
+                        size_t last = first;
+                        while (last < crossings.size() && crossings[last].first == crossings[first].first)
+                        {
+                            ++last;
+                        }
+                        if ((last - first) % 2 == 0)
+                        {
+                            const int y = crossings[first].first / TILE_SIZE;
+                            const int z = crossings[first].first % TILE_SIZE;
+                            for (size_t i = first; i < last; i += 2)
+                            {
+                                const int x0 = std::clamp(static_cast<int>(std::ceil(crossings[i].second - 0.5)), 0, dimensions(0));
+                                const int x1 = std::clamp(static_cast<int>(std::ceil(crossings[i + 1].second - 0.5)), 0, dimensions(0));
+                                column.set_run(x0, x1, y, z);
+                            }
+                        }
+                        first = last;
+                    }
+                }
+
+                TileResult &result = results[tile];
+                for (int bx = 0; bx < num_bricks_x; ++bx)
+                {
+                    for (int by = 0; by < TILE_BRICKS; ++by)
+                    {
+                        for (int bz = 0; bz < TILE_BRICKS; ++bz)
+                        {
+                            const uint64_t *words = column.brick(bx, by, bz);
+                            const bool empty = std::all_of(words, words + BRICK_SIZE, [](uint64_t w)
+                                                           { return w == 0; });
+                            if (empty)
+                            {
+                                continue;
+                            }
+                            const Brick brick = {bx, y0 / BRICK_SIZE + by, z0 / BRICK_SIZE + bz};
+                            if (std::all_of(words, words + BRICK_SIZE, [](uint64_t w)
+                                            { return w == FULL_WORD; }))
+                            {
+                                result.full_bricks.push_back(brick);
+                            }
+                            else
+                            {
+                                result.bricks.push_back(brick);
+                                std::array<uint64_t, BRICK_SIZE> bits;
+                                std::copy(words, words + BRICK_SIZE, bits.begin());
+                                result.brick_bits.push_back(bits);
+                            }
+                        }
+                    }
+                }
+            } }, 1);
+
+        std::vector<Brick> bricks, full_bricks;
+        std::vector<std::array<uint64_t, BRICK_SIZE>> brick_bits;
+        for (TileResult &result : results)
+        {
+            bricks.insert(bricks.end(), result.bricks.begin(), result.bricks.end());
+            brick_bits.insert(brick_bits.end(), result.brick_bits.begin(), result.brick_bits.end());
+            full_bricks.insert(full_bricks.end(), result.full_bricks.begin(), result.full_bricks.end());
+            result = TileResult();
+        }
+        const std::vector<int> order = sorted_order(bricks);
+        grid.bricks.resize(bricks.size(), 3);
+        grid.brick_bits.resize(bricks.size(), BRICK_SIZE);
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                grid.bricks(i, k) = bricks[order[i]][k];
+            }
+            for (int k = 0; k < BRICK_SIZE; ++k)
+            {
+                grid.brick_bits(i, k) = brick_bits[order[i]][k];
+            }
+        }
+        std::sort(full_bricks.begin(), full_bricks.end());
+        grid.full_bricks.resize(full_bricks.size(), 3);
+        for (size_t i = 0; i < full_bricks.size(); ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                grid.full_bricks(i, k) = full_bricks[i][k];
+            }
+        }
+        return grid;
+    }
+
+    inline uint64_t voxel_count(const Voxel_grid &grid)
+    {
+        uint64_t count = static_cast<uint64_t>(grid.full_bricks.rows()) * 512;
+        for (Eigen::Index i = 0; i < grid.brick_bits.size(); ++i)
+        {
+            count += static_cast<uint64_t>(std::popcount(grid.brick_bits.data()[i]));
+        }
+        return count;
+    }
+
+    // Outer faces of the occupied voxels, for display: the grid is first coarsened (a coarse voxel
+    // is occupied when any of its voxels is) until no side has more than max_resolution voxels.
+    // Every face is its own quad, so the mesh shades flat.
+    inline Polygon_mesh voxel_boundary_mesh(const Voxel_grid &grid, int max_resolution)
+    {
+        using voxel_detail::BRICK_SIZE;
+        const int factor = std::max(1, (grid.dimensions.maxCoeff() + max_resolution - 1) / max_resolution);
+        const Eigen::Vector3i dimensions = ((grid.dimensions.array() + factor - 1) / factor).transpose();
+        const auto cell_index = [&](int x, int y, int z)
+        {
+            return (static_cast<size_t>(x) * dimensions(1) + y) * dimensions(2) + z;
+        };
+        std::vector<uint8_t> occupied(static_cast<size_t>(dimensions.prod()), 0);
+        for (Eigen::Index i = 0; i < grid.full_bricks.rows(); ++i)
+        {
+            const Eigen::Vector3i first = (BRICK_SIZE * grid.full_bricks.row(i).transpose()) / factor;
+            const Eigen::Vector3i last = ((BRICK_SIZE * grid.full_bricks.row(i).transpose()).array() + BRICK_SIZE - 1).matrix() / factor;
+            for (int x = first(0); x <= last(0); ++x)
+            {
+                for (int y = first(1); y <= last(1); ++y)
+                {
+                    for (int z = first(2); z <= last(2); ++z)
+                    {
+                        occupied[cell_index(x, y, z)] = 1;
+                    }
+                }
+            }
+        }
+        for (Eigen::Index i = 0; i < grid.bricks.rows(); ++i)
+        {
+            for (int k = 0; k < BRICK_SIZE; ++k)
+            {
+                for (uint64_t word = grid.brick_bits(i, k); word != 0; word &= word - 1)
+                {
+                    const int bit = std::countr_zero(word);
+                    occupied[cell_index((BRICK_SIZE * grid.bricks(i, 0) + bit % 8) / factor,
+                                        (BRICK_SIZE * grid.bricks(i, 1) + bit / 8) / factor,
+                                        (BRICK_SIZE * grid.bricks(i, 2) + k) / factor)] = 1;
+                }
+            }
+        }
+
+        std::vector<Eigen::Vector3d> vertices;
+        std::vector<Eigen::Vector3i> faces;
+        const double size = grid.voxel_size * factor;
+        for (int x = 0; x < dimensions(0); ++x)
+        {
+            for (int y = 0; y < dimensions(1); ++y)
+            {
+                for (int z = 0; z < dimensions(2); ++z)
+                {
+                    if (!occupied[cell_index(x, y, z)])
+                    {
+                        continue;
+                    }
+                    const Eigen::Vector3i cell(x, y, z);
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        for (const int side : {-1, 1})
+                        {
+                            Eigen::Vector3i neighbour = cell;
+                            neighbour(axis) += side;
+                            if (neighbour(axis) >= 0 && neighbour(axis) < dimensions(axis) &&
+                                occupied[cell_index(neighbour(0), neighbour(1), neighbour(2))])
+                            {
+                                continue;
+                            }
+                            // Corners of the face, counter-clockwise seen from outside.
+                            const Eigen::Vector3d u = Eigen::Vector3d::Unit((axis + 1) % 3);
+                            const Eigen::Vector3d v = Eigen::Vector3d::Unit((axis + 2) % 3);
+                            Eigen::Vector3d base = cell.cast<double>();
+                            if (side > 0)
+                            {
+                                base(axis) += 1.0;
+                            }
+                            const Eigen::Vector3d corners[4] = {base, base + u, base + u + v, base + v};
+                            const int first = static_cast<int>(vertices.size());
+                            for (const Eigen::Vector3d &corner : corners)
+                            {
+                                vertices.push_back(grid.origin.transpose() + size * corner);
+                            }
+                            if (side > 0)
+                            {
+                                faces.emplace_back(first, first + 1, first + 2);
+                                faces.emplace_back(first, first + 2, first + 3);
+                            }
+                            else
+                            {
+                                faces.emplace_back(first, first + 2, first + 1);
+                                faces.emplace_back(first, first + 3, first + 2);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        Polygon_mesh mesh;
+        mesh.V.resize(vertices.size(), 3);
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            mesh.V.row(i) = vertices[i].transpose();
+        }
+        mesh.F.resize(faces.size(), 3);
+        for (size_t i = 0; i < faces.size(); ++i)
+        {
+            mesh.F.row(i) = faces[i].transpose();
+        }
+        return mesh;
+    }
+
+} // namespace MITSU_Domoe
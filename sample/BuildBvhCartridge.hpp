@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Bvh.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+
+class BuildBvhCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // Ranges of at most this many triangles become leaves. Defaults to 4.
+        rfl::Field<"leaf_size", std::optional<int>> leaf_size;
+    };
+
+    struct Output
+    {
+        rfl::Field<"bvh", MITSU_Domoe::Mesh_bvh> bvh;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "buildBvh";
+    static inline const std::string description = "Builds a bounding volume hierarchy over a triangle mesh for nearest-point, ray-cast and overlap queries.";
+
+    Output execute(const Input &input) const
+    {
+        MITSU_Domoe::Mesh_bvh bvh = MITSU_Domoe::build_bvh(input.polygon_mesh.get(), static_cast<size_t>(std::max(1, input.leaf_size.get().value_or(4))));
+
+        // Later queries in this session find the packed form without rebuilding it.
+        auto packed = std::make_shared<const MITSU_Domoe::PackedBvh>(bvh);
+        MITSU_Domoe::PackedBvhCache::shared().insert(packed);
+
+        const std::string message = "Built BVH with " + std::to_string(packed->node_count()) + " nodes over " +
+                                    std::to_string(packed->triangle_count()) + " triangles (depth " + std::to_string(packed->depth()) + ").";
+        return Output{
+            .bvh = std::move(bvh),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<BuildBvhCartridge>);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/KdTree.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+
+class BuildKdTreeCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"point_cloud", MITSU_Domoe::Point_cloud> point_cloud;
+        // Ranges of at most this many points become leaves. Defaults to 8.
+        rfl::Field<"leaf_size", std::optional<int>> leaf_size;
+    };
+
+    struct Output
+    {
+        rfl::Field<"kd_tree", MITSU_Domoe::Point_kd_tree> kd_tree;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "buildKdTree";
+    static inline const std::string description = "Builds a KD-tree over the positions of a point cloud for nearest-neighbour and radius queries.";
+
+    Output execute(const Input &input) const
+    {
+        MITSU_Domoe::Point_kd_tree tree = MITSU_Domoe::build_kd_tree(input.point_cloud.get().positions, static_cast<size_t>(std::max(1, input.leaf_size.get().value_or(8))));
+
+        // Later queries in this session find the packed form without rebuilding it.
+        auto packed = std::make_shared<const MITSU_Domoe::PackedKdTree>(tree);
+        MITSU_Domoe::PackedKdTreeCache::shared().insert(packed);
+
+        const std::string message = "Built KD-tree with " + std::to_string(packed->node_count()) + " nodes over " +
+                                    std::to_string(packed->point_count()) + " points.";
+        return Output{
+            .kd_tree = std::move(tree),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<BuildKdTreeCartridge>);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Bvh.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <Eigen/Core>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+class BvhNearestCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"bvh", MITSU_Domoe::Mesh_bvh> bvh;
+        rfl::Field<"points", Eigen::MatrixXd> points;
+    };
+
+    struct Output
+    {
+        // Per query point: nearest face (-1 if the BVH is empty), closest point on it and distance.
+        rfl::Field<"face_ids", Eigen::VectorXi> face_ids;
+        rfl::Field<"closest_points", Eigen::MatrixXd> closest_points;
+        rfl::Field<"distances", Eigen::VectorXd> distances;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "bvhNearest";
+    static inline const std::string description = "Finds the closest point on a mesh to each query point using a BVH.";
+
+    Output execute(const Input &input) const
+    {
+        const Eigen::MatrixXd &points = input.points.get();
+        if (points.rows() > 0 && points.cols() != 3)
+        {
+            throw std::invalid_argument("points must have 3 columns.");
+        }
+        const auto bvh = MITSU_Domoe::PackedBvhCache::shared().get(input.bvh.get());
+
+        const Eigen::Index n = points.rows();
+        Eigen::VectorXi face_ids(n);
+        Eigen::MatrixXd closest_points(n, 3);
+        Eigen::VectorXd distances(n);
+        MITSU_Domoe::for_each_bvh_query(static_cast<size_t>(n), [&](size_t i, std::vector<uint32_t> &stack)
+                                        {
+            const auto hit = bvh->nearest(points.row(i).transpose(), stack);
+            face_ids(i) = hit.face;
+            closest_points.row(i) = hit.point.transpose();
+            distances(i) = hit.face >= 0 ? std::sqrt(hit.squared_distance) : 0.0; });
+
+        return Output{
+            .face_ids = std::move(face_ids),
+            .closest_points = std::move(closest_points),
+            .distances = std::move(distances),
+            .message = "Answered " + std::to_string(n) + " nearest-point queries."
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<BvhNearestCartridge>);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Bvh.hpp"
+#include "MITSUDomoe/ThreadPool.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <Eigen/Core>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class BvhOverlapCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"bvh", MITSU_Domoe::Mesh_bvh> bvh;
+        // One axis-aligned query box per row.
+        rfl::Field<"box_min", Eigen::MatrixXd> box_min;
+        rfl::Field<"box_max", Eigen::MatrixXd> box_max;
+    };
+
+    struct Output
+    {
+        // The faces overlapping box i are face_ids[offsets[i], offsets[i + 1]), in ascending order.
+        rfl::Field<"offsets", Eigen::VectorXi> offsets;
+        rfl::Field<"face_ids", Eigen::VectorXi> face_ids;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "bvhOverlap";
+    static inline const std::string description = "Lists the mesh faces that intersect each query box using a BVH.";
+
+    Output execute(const Input &input) const
+    {
+        constexpr size_t block_size = 256;
+
+        const Eigen::MatrixXd &box_min = input.box_min.get();
+        const Eigen::MatrixXd &box_max = input.box_max.get();
+        const size_t n = static_cast<size_t>(box_min.rows());
+        if (box_max.rows() != box_min.rows() || (n > 0 && (box_min.cols() != 3 || box_max.cols() != 3)))
+        {
+            throw std::invalid_argument("box_min and box_max must both be n x 3.");
+        }
+        const auto bvh = MITSU_Domoe::PackedBvhCache::shared().get(input.bvh.get());
+
+        // Each block of queries collects its faces separately; the blocks are then concatenated in order.
+        const size_t num_blocks = (n + block_size - 1) / block_size;
+        std::vector<std::vector<int>> block_faces(num_blocks);
+        Eigen::VectorXi offsets = Eigen::VectorXi::Zero(n + 1);
+        MITSU_Domoe::parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                                  {
+            std::vector<uint32_t> stack;
+            for (size_t b = begin; b < end; ++b)
+            {
+                for (size_t i = b * block_size; i < std::min(n, (b + 1) * block_size); ++i)
+                {
+                    const size_t before = block_faces[b].size();
+                    bvh->overlap(box_min.row(i).transpose(), box_max.row(i).transpose(), block_faces[b], stack);
+                    offsets(i + 1) = static_cast<int>(block_faces[b].size() - before);
+                }
+            } }, 1);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            offsets(i + 1) += offsets(i);
+        }
+        Eigen::VectorXi face_ids(offsets(n));
+        for (size_t b = 0; b < num_blocks; ++b)
+        {
+            std::copy(block_faces[b].begin(), block_faces[b].end(), face_ids.data() + offsets(b * block_size));
+        }
+
+        const std::string message = "Found " + std::to_string(face_ids.size()) + " overlaps for " + std::to_string(n) + " boxes.";
+        return Output{
+            .offsets = std::move(offsets),
+            .face_ids = std::move(face_ids),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<BvhOverlapCartridge>);
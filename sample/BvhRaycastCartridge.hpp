@@ -0,0 +1,73 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Bvh.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <Eigen/Core>
+#include <stdexcept>
+#include <string>
+
+class BvhRaycastCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"bvh", MITSU_Domoe::Mesh_bvh> bvh;
+        rfl::Field<"origins", Eigen::MatrixXd> origins;
+        // One direction per origin, or a single row shared by all origins. Need not be normalized.
+        rfl::Field<"directions", Eigen::MatrixXd> directions;
+    };
+
+    struct Output
+    {
+        // Per ray: first face hit (-1 for a miss), ray parameter t of the hit (-1 for a miss) and the
+        // hit point origin + t * direction (zero for a miss).
+        rfl::Field<"face_ids", Eigen::VectorXi> face_ids;
+        rfl::Field<"distances", Eigen::VectorXd> distances;
+        rfl::Field<"hit_points", Eigen::MatrixXd> hit_points;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "bvhRaycast";
+    static inline const std::string description = "Casts rays against a mesh using a BVH and reports the first hit of each.";
+
+    Output execute(const Input &input) const
+    {
+        const Eigen::MatrixXd &origins = input.origins.get();
+        const Eigen::MatrixXd &directions = input.directions.get();
+        const Eigen::Index n = origins.rows();
+        if ((n > 0 && origins.cols() != 3) || directions.cols() != 3 || (directions.rows() != n && directions.rows() != 1))
+        {
+            throw std::invalid_argument("origins must be n x 3 and directions n x 3 or 1 x 3.");
+        }
+        const auto bvh = MITSU_Domoe::PackedBvhCache::shared().get(input.bvh.get());
+
+        Eigen::VectorXi face_ids(n);
+        Eigen::VectorXd distances(n);
+        Eigen::MatrixXd hit_points(n, 3);
+        size_t hits = 0;
+        MITSU_Domoe::for_each_bvh_query(static_cast<size_t>(n), [&](size_t i, std::vector<uint32_t> &stack)
+                                        {
+            const Eigen::Vector3d origin = origins.row(i).transpose();
+            const Eigen::Vector3d direction = directions.row(directions.rows() == 1 ? 0 : i).transpose();
+            const auto hit = bvh->raycast(origin, direction, stack);
+            face_ids(i) = hit.face;
+            distances(i) = hit.face >= 0 ? hit.distance : -1.0;
+            hit_points.row(i) = hit.face >= 0 ? Eigen::RowVector3d((origin + hit.distance * direction).transpose()) : Eigen::RowVector3d::Zero(); });
+        for (Eigen::Index i = 0; i < n; ++i)
+        {
+            hits += face_ids(i) >= 0 ? 1 : 0;
+        }
+
+        return Output{
+            .face_ids = std::move(face_ids),
+            .distances = std::move(distances),
+            .hit_points = std::move(hit_points),
+            .message = "Cast " + std::to_string(n) + " rays, " + std::to_string(hits) + " hit the mesh."
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<BvhRaycastCartridge>);
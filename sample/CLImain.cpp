@@ -4,8 +4,10 @@
 
 int main()
 {
-    auto log_path = MITSU_Domoe::initialize_logger();
+    auto log_path = MITSU_Domoe::initialize_logger(MITSU_Domoe::LoggerOptions::from_env());
     auto client = std::make_unique<MITSU_Domoe::ConsoleClient>(log_path);
     client->run();
+    client.reset();
+    MITSU_Domoe::shutdown_logger();
     return 0;
 }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/MeshCleaning.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <optional>
+#include <string>
+
+class CleanMeshCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // Vertices within this distance of each other are merged (default 0: only coincident ones).
+        // A negative value keeps all vertices apart.
+        rfl::Field<"weld_tolerance", std::optional<double>> weld_tolerance;
+    };
+
+    struct Output
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"welded_vertices", int> welded_vertices;
+        rfl::Field<"unreferenced_vertices", int> unreferenced_vertices;
+        rfl::Field<"degenerate_faces", int> degenerate_faces;
+        rfl::Field<"duplicate_faces", int> duplicate_faces;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "cleanMesh";
+    static inline const std::string description = "Welds close vertices and removes degenerate faces, duplicate faces and unreferenced vertices of a triangle mesh.";
+
+    Output execute(const Input &input) const
+    {
+        const auto &mesh = input.polygon_mesh.get();
+        MITSU_Domoe::MeshCleanup result = MITSU_Domoe::clean_mesh(mesh, input.weld_tolerance.get().value_or(0.0));
+
+        const std::string message = "Cleaned mesh to " + std::to_string(result.mesh.V.rows()) + " vertices and " + std::to_string(result.mesh.F.rows()) +
+                                    " faces (" + std::to_string(result.welded_vertices) + " vertices welded, " +
+                                    std::to_string(result.unreferenced_vertices) + " unreferenced; " + std::to_string(result.degenerate_faces) +
+                                    " degenerate and " + std::to_string(result.duplicate_faces) + " duplicate faces removed).";
+        return Output{
+            .polygon_mesh = std::move(result.mesh),
+            .welded_vertices = static_cast<int>(result.welded_vertices),
+            .unreferenced_vertices = static_cast<int>(result.unreferenced_vertices),
+            .degenerate_faces = static_cast<int>(result.degenerate_faces),
+            .duplicate_faces = static_cast<int>(result.duplicate_faces),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<CleanMeshCartridge>);
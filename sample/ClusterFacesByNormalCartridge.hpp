@@ -0,0 +1,43 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Clustering.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <optional>
+#include <string>
+
+class ClusterFacesByNormalCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // Largest angle between the normals of two adjacent faces in one region. Defaults to 30.
+        rfl::Field<"max_angle_degrees", std::optional<double>> max_angle_degrees;
+    };
+
+    struct Output
+    {
+        rfl::Field<"polygon_clusters", MITSU_Domoe::Polygon_clusters> polygon_clusters;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "clusterFacesByNormal";
+    static inline const std::string description = "Splits the faces of a triangle mesh into smooth regions separated by creases and boundaries.";
+
+    Output execute(const Input &input) const
+    {
+        MITSU_Domoe::Polygon_clusters clusters = MITSU_Domoe::cluster_faces_by_normal(input.polygon_mesh.get(), input.max_angle_degrees.get().value_or(30.0));
+
+        const std::string message = "Grouped " + std::to_string(clusters.faces.size()) + " faces into " +
+                                    std::to_string(clusters.areas.size()) + " regions.";
+        return Output{
+            .polygon_clusters = std::move(clusters),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<ClusterFacesByNormalCartridge>);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Clustering.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <optional>
+#include <string>
+
+class ClusterFacesKMeansCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"k", int> k;
+        // Defaults to 50.
+        rfl::Field<"max_iterations", std::optional<int>> max_iterations;
+    };
+
+    struct Output
+    {
+        rfl::Field<"polygon_clusters", MITSU_Domoe::Polygon_clusters> polygon_clusters;
+        rfl::Field<"iterations", int> iterations;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "clusterFacesKMeans";
+    static inline const std::string description = "Groups the faces of a triangle mesh into k spatial clusters by area-weighted k-means on the face centroids.";
+
+    Output execute(const Input &input) const
+    {
+        MITSU_Domoe::KMeansClustering result = MITSU_Domoe::cluster_faces_kmeans(input.polygon_mesh.get(), input.k.get(), input.max_iterations.get().value_or(50));
+
+        const std::string message = "Grouped " + std::to_string(result.clusters.faces.size()) + " faces into " +
+                                    std::to_string(result.clusters.areas.size()) + " clusters " +
+                                    (result.converged ? "(converged after " : "(stopped after ") + std::to_string(result.iterations) + " iterations).";
+        return Output{
+            .polygon_clusters = std::move(result.clusters),
+            .iterations = result.iterations,
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<ClusterFacesKMeansCartridge>);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/DerivedData.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+class ComputeNormalsCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // "vertex" (default) or "face".
+        rfl::Field<"per", std::optional<std::string>> per;
+        // Vertex normals only: "area" (default) or "angle".
+        rfl::Field<"weighting", std::optional<std::string>> weighting;
+    };
+
+    struct Output
+    {
+        // The input mesh with N and normal_kind replaced.
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "computeNormals";
+    static inline const std::string description = "Computes unit face normals or area- or angle-weighted vertex normals of a triangle mesh.";
+
+    Output execute(const Input &input) const
+    {
+        MITSU_Domoe::Polygon_mesh mesh = input.polygon_mesh.get();
+        const std::string per = input.per.get().value_or("vertex");
+        const std::string weighting = input.weighting.get().value_or("area");
+        if (per != "vertex" && per != "face")
+        {
+            throw std::invalid_argument("'per' must be \"vertex\" or \"face\", got \"" + per + "\"");
+        }
+        if (weighting != "area" && weighting != "angle")
+        {
+            throw std::invalid_argument("'weighting' must be \"area\" or \"angle\", got \"" + weighting + "\"");
+        }
+        if (mesh.F.rows() > 0 && (mesh.F.cols() != 3 || mesh.V.cols() != 3))
+        {
+            throw std::invalid_argument("Normals can only be computed for a triangle mesh with 3D vertices.");
+        }
+        if (mesh.F.size() > 0 && (mesh.F.minCoeff() < 0 || mesh.F.maxCoeff() >= mesh.V.rows()))
+        {
+            throw std::invalid_argument("Face index out of range.");
+        }
+
+        MITSU_Domoe::MeshDerivedData derived(mesh);
+        if (per == "face")
+        {
+            mesh.N = derived.face_geometry()->normals;
+            mesh.normal_kind = MITSU_Domoe::Normal_kind::face;
+        }
+        else
+        {
+            mesh.N = *derived.vertex_normals(weighting == "angle" ? MITSU_Domoe::NormalWeighting::angle : MITSU_Domoe::NormalWeighting::area);
+            mesh.normal_kind = MITSU_Domoe::Normal_kind::vertex;
+        }
+
+        const std::string message = "Computed " + std::to_string(mesh.N.rows()) + " " + per + " normals" +
+                                    (per == "vertex" ? " (" + weighting + "-weighted)." : ".");
+        return Output{
+            .polygon_mesh = std::move(mesh),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<ComputeNormalsCartridge>);
@@ -2,15 +2,16 @@
 
 #include "MITSUDomoe/ICartridge.hpp"
 #include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/DerivedData.hpp"
+#include "MITSUDomoe/MeshTopology.hpp"
+#include "MITSUDomoe/ThreadPool.hpp"
 #include <rfl.hpp>
 #include <rfl_eigen_serdes.hpp>
-#include <igl/doublearea.h>
-#include <igl/barycenter.h>
 #include <numeric>
 #include <algorithm>
+#include <cstdint>
+#include <optional>
 #include <vector>
-#include <map>
-#include <set>
 
 class CutMeshCartridge
 {
@@ -18,6 +19,9 @@ public:
     struct Input
     {
         MITSU_Domoe::Polygon_mesh input_mesh;
+        // When true, triangles that straddle the cutting plane are split along it instead of
+        // being assigned whole to one side by their centroid.
+        std::optional<bool> clip;
     };
 
     struct Output
@@ -39,80 +43,248 @@ public:
             return Output{ .mesh_a = {}, .mesh_b = {}, .message = "Input mesh is empty." };
         }
 
-        // 1. Calculate face areas and centroids
-        Eigen::VectorXd face_areas;
-        igl::doublearea(V, F, face_areas);
-        face_areas /= 2.0;
-        const double total_area = face_areas.sum();
+        // 1. Gather face areas and centroid x-coordinates
+        MITSU_Domoe::MeshDerivedData derived(input.input_mesh);
+        const auto geometry = derived.face_geometry();
+        const size_t num_faces = F.rows();
+        std::vector<FaceKey> faces(num_faces);
+        MITSU_Domoe::parallel_for(0, num_faces, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                faces[f].x = geometry->centroids(f, 0);
+                faces[f].area = geometry->areas(f);
+                faces[f].index = static_cast<int>(f);
+            }
+        });
 
-        Eigen::MatrixXd face_centroids;
-        igl::barycenter(V, F, face_centroids);
+        // 2. Split faces into two groups: everything up to and including the area-weighted median
+        // face, in centroid-x order, goes to A. The median is found by selection, not by sorting.
+        std::vector<uint8_t> in_a(num_faces);
+        const FaceKey median = weighted_median(faces);
+        const double median_x = median.x;
+        MITSU_Domoe::parallel_for(0, num_faces, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                in_a[faces[i].index] = !(median < faces[i]);
+            }
+        });
 
-        // 2. Find the median x-coordinate
-        std::vector<int> face_indices(F.rows());
-        std::iota(face_indices.begin(), face_indices.end(), 0);
-        std::sort(face_indices.begin(), face_indices.end(),
-                  [&](int a, int b) { return face_centroids(a, 0) < face_centroids(b, 0); });
+        if (input.clip.value_or(false)) {
+            return clip_at(V, F, *derived.topology(), in_a, median_x);
+        }
 
-        double accumulated_area = 0.0;
-        double median_x = 0.0;
-        int split_idx = 0;
-        for (int i = 0; i < F.rows(); ++i) {
-            int face_idx = face_indices[i];
-            accumulated_area += face_areas(face_idx);
-            if (accumulated_area >= total_area / 2.0) {
-                median_x = face_centroids(face_idx, 0);
-                split_idx = i;
-                break;
+        MITSU_Domoe::Polygon_mesh meshes[2];
+        MITSU_Domoe::parallel_for(0, 2, [&](size_t begin, size_t end) {
+            for (size_t side = begin; side < end; ++side) {
+                const uint8_t wanted = side == 0;
+                std::vector<Eigen::RowVector3i> side_faces;
+                for (size_t f = 0; f < num_faces; ++f) {
+                    if (in_a[f] == wanted) {
+                        side_faces.emplace_back(F.row(f));
+                    }
+                }
+                meshes[side] = create_submesh(V, {}, side_faces);
             }
+        }, 1);
+
+        return Output{
+            .mesh_a = std::move(meshes[0]),
+            .mesh_b = std::move(meshes[1]),
+            .message = "Successfully split mesh near x = " + std::to_string(median_x)
+        };
+    }
+
+private:
+    struct FaceKey
+    {
+        double x;
+        double area;
+        int index;
+
+        // Faces with equal centroid x are ordered by index, so the split is deterministic.
+        bool operator<(const FaceKey &other) const
+        {
+            return x < other.x || (x == other.x && index < other.index);
+        }
+    };
+
+    // Returns the first face, in centroid-x order, at which the accumulated area reaches half the total.
+    // Weighted quickselect: each step partitions the remaining range around its middle element with
+    // nth_element and keeps the half that contains the target, so the expected cost is linear.
+    static FaceKey weighted_median(std::vector<FaceKey> &faces)
+    {
+        double total_area = 0.0;
+        for (const FaceKey &face : faces) {
+            total_area += face.area;
         }
+        const double target = total_area / 2.0;
 
-        // 3. Split faces into two groups
-        std::vector<int> faces_a_indices, faces_b_indices;
-        for(int i = 0; i < F.rows(); ++i) {
-            if (i <= split_idx) {
-                faces_a_indices.push_back(face_indices[i]);
+        double accumulated_area = 0.0;
+        auto first = faces.begin();
+        auto last = faces.end();
+        while (last - first > 1) {
+            auto middle = first + (last - first - 1) / 2;
+            std::nth_element(first, middle, last);
+            double lower_area = 0.0;
+            for (auto it = first; it <= middle; ++it) {
+                lower_area += it->area;
+            }
+            if (accumulated_area + lower_area >= target) {
+                last = middle + 1;
             } else {
-                faces_b_indices.push_back(face_indices[i]);
+                accumulated_area += lower_area;
+                first = middle + 1;
             }
         }
+        return *first;
+    }
 
-        auto create_submesh = [&](const std::vector<int>& selected_face_indices) {
-            MITSU_Domoe::Polygon_mesh submesh;
-            if (selected_face_indices.empty()) return submesh;
+    // Builds a mesh from the given faces, keeping only the vertices they use, in index order.
+    // Indices at or above V.rows() refer to rows of extra_vertices.
+    static MITSU_Domoe::Polygon_mesh create_submesh(const Eigen::MatrixXd &V, const std::vector<Eigen::RowVector3d> &extra_vertices,
+                                                    const std::vector<Eigen::RowVector3i> &faces)
+    {
+        MITSU_Domoe::Polygon_mesh submesh;
+        if (faces.empty()) return submesh;
 
-            std::set<int> unique_vert_indices;
-            for (int face_idx : selected_face_indices) {
-                for (int i = 0; i < F.cols(); ++i) {
-                    unique_vert_indices.insert(F(face_idx, i));
-                }
+        const size_t num_vertices = V.rows() + extra_vertices.size();
+        std::vector<int> new_index(num_vertices, 0);
+        for (const auto &face : faces) {
+            for (int j = 0; j < 3; ++j) {
+                new_index[face(j)] = 1;
+            }
+        }
+        // Exclusive prefix sum over the used flags gives the new indices in ascending old order.
+        int used = 0;
+        for (size_t i = 0; i < num_vertices; ++i) {
+            const int flag = new_index[i];
+            new_index[i] = flag ? used : -1;
+            used += flag;
+        }
+
+        submesh.V.resize(used, V.cols());
+        for (size_t i = 0; i < num_vertices; ++i) {
+            if (new_index[i] >= 0) {
+                submesh.V.row(new_index[i]) = i < static_cast<size_t>(V.rows()) ? Eigen::RowVector3d(V.row(i)) : extra_vertices[i - V.rows()];
             }
+        }
 
-            std::map<int, int> old_to_new_vert_map;
-            submesh.V.resize(unique_vert_indices.size(), V.cols());
-            int new_idx = 0;
-            for (int old_idx : unique_vert_indices) {
-                submesh.V.row(new_idx) = V.row(old_idx);
-                old_to_new_vert_map[old_idx] = new_idx;
-                new_idx++;
+        submesh.F.resize(faces.size(), 3);
+        for (size_t i = 0; i < faces.size(); ++i) {
+            for (int j = 0; j < 3; ++j) {
+                submesh.F(i, j) = new_index[faces[i](j)];
             }
+        }
+        return submesh;
+    }
 
-            submesh.F.resize(selected_face_indices.size(), F.cols());
-            for (size_t i = 0; i < selected_face_indices.size(); ++i) {
-                for (int j = 0; j < F.cols(); ++j) {
-                    submesh.F(i, j) = old_to_new_vert_map[F(selected_face_indices[i], j)];
+    // Splits every triangle that straddles x = plane_x. Faces entirely on one side keep their
+    // in_a assignment by side; vertices on the plane are shared by both halves.
+    static Output clip_at(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const MITSU_Domoe::MeshTopology &topology,
+                          const std::vector<uint8_t> &in_a, double plane_x)
+    {
+        const size_t num_faces = F.rows();
+        auto sign = [&](int v) {
+            const double s = V(v, 0) - plane_x;
+            return (s > 0.0) - (s < 0.0);
+        };
+
+        // Every edge crossing the plane gets one intersection vertex, shared by all faces on it so
+        // that the cut stays closed.
+        const size_t num_edges = topology.edges.size();
+        std::vector<int> crossing_index(num_edges);
+        MITSU_Domoe::parallel_for(0, num_edges, [&](size_t begin, size_t end) {
+            for (size_t e = begin; e < end; ++e) {
+                crossing_index[e] = sign(topology.edges[e][0]) * sign(topology.edges[e][1]) < 0;
+            }
+        });
+        int num_crossing = 0;
+        for (size_t e = 0; e < num_edges; ++e) {
+            const int crossing = crossing_index[e];
+            crossing_index[e] = crossing ? num_crossing : -1;
+            num_crossing += crossing;
+        }
+
+        // Each intersection is computed from the lower to the higher vertex index, so it does not
+        // depend on which face asks for it.
+        std::vector<Eigen::RowVector3d> intersections(num_crossing);
+        MITSU_Domoe::parallel_for(0, num_edges, [&](size_t begin, size_t end) {
+            for (size_t e = begin; e < end; ++e) {
+                if (crossing_index[e] < 0) {
+                    continue;
                 }
+                const int a = topology.edges[e][0];
+                const int b = topology.edges[e][1];
+                const double t = (plane_x - V(a, 0)) / (V(b, 0) - V(a, 0));
+                Eigen::RowVector3d &p = intersections[crossing_index[e]];
+                p = V.row(a) + t * (V.row(b) - V.row(a));
+                p(0) = plane_x;
             }
-            return submesh;
+        });
+        const int first_intersection = V.rows();
+        // Intersection vertex on the edge of half-edge j of face f.
+        auto intersection = [&](size_t f, int j) {
+            return first_intersection + crossing_index[topology.half_edge_edges[3 * f + j]];
         };
 
-        MITSU_Domoe::Polygon_mesh mesh_a_val = create_submesh(faces_a_indices);
-        MITSU_Domoe::Polygon_mesh mesh_b_val = create_submesh(faces_b_indices);
+        MITSU_Domoe::Polygon_mesh meshes[2];
+        size_t num_clipped = 0;
+        MITSU_Domoe::parallel_for(0, 2, [&](size_t begin, size_t end) {
+            for (size_t side = begin; side < end; ++side) {
+                // Side 0 (A) is x <= plane_x, side 1 (B) is x >= plane_x.
+                const int side_sign = side == 0 ? -1 : 1;
+                std::vector<Eigen::RowVector3i> side_faces;
+                size_t clipped = 0;
+                for (size_t f = 0; f < num_faces; ++f) {
+                    const int s[3] = {sign(F(f, 0)), sign(F(f, 1)), sign(F(f, 2))};
+                    const bool has_negative = s[0] < 0 || s[1] < 0 || s[2] < 0;
+                    const bool has_positive = s[0] > 0 || s[1] > 0 || s[2] > 0;
+                    if (!(has_negative && has_positive)) {
+                        // Only faces lying in the plane fit both sides; they keep their centroid-based side.
+                        const bool fits_a = !has_positive;
+                        const bool fits_b = !has_negative;
+                        const bool to_a = fits_a && (!fits_b || in_a[f]);
+                        if (to_a == (side == 0)) {
+                            side_faces.emplace_back(F.row(f));
+                        }
+                        continue;
+                    }
+                    ++clipped;
+                    // Rotate so that corner 0 is the odd one out: the only vertex on the plane,
+                    // or the only vertex on its side.
+                    int r = 0;
+                    if (s[0] == 0 || s[1] == 0 || s[2] == 0) {
+                        while (s[r] != 0) ++r;
+                    } else {
+                        while (s[r] == s[(r + 1) % 3] || s[r] == s[(r + 2) % 3]) ++r;
+                    }
+                    const int a = F(f, r);
+                    const int b = F(f, (r + 1) % 3);
+                    const int c = F(f, (r + 2) % 3);
+                    const int sb = s[(r + 1) % 3];
+                    if (s[r] == 0) {
+                        const int p_bc = intersection(f, (r + 1) % 3);
+                        side_faces.emplace_back(sb == side_sign ? Eigen::RowVector3i(a, b, p_bc) : Eigen::RowVector3i(a, p_bc, c));
+                    } else {
+                        const int p_ab = intersection(f, r);
+                        const int p_ca = intersection(f, (r + 2) % 3);
+                        if (s[r] == side_sign) {
+                            side_faces.emplace_back(a, p_ab, p_ca);
+                        } else {
+                            side_faces.emplace_back(p_ab, b, c);
+                            side_faces.emplace_back(p_ab, c, p_ca);
+                        }
+                    }
+                }
+                meshes[side] = create_submesh(V, intersections, side_faces);
+                if (side == 0) {
+                    num_clipped = clipped;
+                }
+            }
+        }, 1);
 
         return Output{
-            .mesh_a = mesh_a_val,
-            .mesh_b = mesh_b_val,
-            .message = "Successfully split mesh near x = " + std::to_string(median_x)
+            .mesh_a = std::move(meshes[0]),
+            .mesh_b = std::move(meshes[1]),
+            .message = "Successfully clipped mesh at x = " + std::to_string(plane_x) + " (" + std::to_string(num_clipped) + " triangles split)"
         };
     }
 };
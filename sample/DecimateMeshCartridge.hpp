@@ -0,0 +1,68 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Decimation.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+class DecimateMeshCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // At least one of the two must be given; reduction stops at whichever is reached first.
+        rfl::Field<"target_faces", std::optional<int>> target_faces;
+        // Largest RMS distance of a merged vertex from the planes of the faces it replaces.
+        rfl::Field<"max_error", std::optional<double>> max_error;
+    };
+
+    struct Output
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"num_faces_before", int> num_faces_before;
+        rfl::Field<"num_faces_after", int> num_faces_after;
+        rfl::Field<"max_error", double> max_error;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "decimateMesh";
+    static inline const std::string description = "Reduces a triangle mesh to a target face count or error bound by quadric error edge collapses.";
+
+    Output execute(const Input &input) const
+    {
+        const auto &mesh = input.polygon_mesh.get();
+        const std::optional<int> target_faces = input.target_faces.get();
+        const std::optional<double> max_error = input.max_error.get();
+        if (!target_faces && !max_error)
+        {
+            throw std::invalid_argument("Either 'target_faces' or 'max_error' must be given.");
+        }
+        if (target_faces && *target_faces < 0)
+        {
+            throw std::invalid_argument("'target_faces' must not be negative, got " + std::to_string(*target_faces));
+        }
+
+        MITSU_Domoe::Decimation result = MITSU_Domoe::decimate_mesh(mesh, target_faces ? static_cast<size_t>(*target_faces) : 0,
+                                                                    max_error.value_or(std::numeric_limits<double>::infinity()));
+
+        const int num_faces_before = static_cast<int>(mesh.F.rows());
+        const int num_faces_after = static_cast<int>(result.mesh.F.rows());
+        const std::string message = "Decimated " + std::to_string(num_faces_before) + " faces to " + std::to_string(num_faces_after) +
+                                    " in " + std::to_string(result.collapses) + " edge collapses.";
+        return Output{
+            .polygon_mesh = std::move(result.mesh),
+            .num_faces_before = num_faces_before,
+            .num_faces_after = num_faces_after,
+            .max_error = result.max_error,
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<DecimateMeshCartridge>);
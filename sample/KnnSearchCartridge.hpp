@@ -0,0 +1,72 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/KdTree.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class KnnSearchCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"kd_tree", MITSU_Domoe::Point_kd_tree> kd_tree;
+        rfl::Field<"points", Eigen::MatrixXd> points;
+        rfl::Field<"k", int> k;
+    };
+
+    struct Output
+    {
+        // Row i lists the k points nearest to query i, nearest first. k is clamped to the number of
+        // points in the tree, so the matrices have min(k, tree points) columns.
+        rfl::Field<"point_ids", Eigen::MatrixXi> point_ids;
+        rfl::Field<"distances", Eigen::MatrixXd> distances;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "knnSearch";
+    static inline const std::string description = "Finds the k nearest points of a KD-tree to each query point.";
+
+    Output execute(const Input &input) const
+    {
+        const Eigen::MatrixXd &points = input.points.get();
+        if (points.rows() > 0 && points.cols() != 3)
+        {
+            throw std::invalid_argument("points must have 3 columns.");
+        }
+        if (input.k.get() < 1)
+        {
+            throw std::invalid_argument("k must be at least 1.");
+        }
+        const auto tree = MITSU_Domoe::PackedKdTreeCache::shared().get(input.kd_tree.get());
+
+        const Eigen::Index n = points.rows();
+        // Clamped so that a large k cannot allocate columns no query could ever fill.
+        const Eigen::Index k = std::min<Eigen::Index>(input.k.get(), input.kd_tree.get().points.rows());
+        Eigen::MatrixXi point_ids = Eigen::MatrixXi::Constant(n, k, -1);
+        Eigen::MatrixXd distances = Eigen::MatrixXd::Constant(n, k, -1.0);
+        MITSU_Domoe::for_each_kd_query(MITSU_Domoe::spatial_query_order(points), [&](size_t i, std::vector<MITSU_Domoe::PackedKdTree::Neighbour> &neighbours, std::vector<MITSU_Domoe::PackedKdTree::StackEntry> &stack)
+                                       {
+            tree->knn(points.row(i).transpose(), static_cast<size_t>(k), neighbours, stack);
+            for (size_t j = 0; j < neighbours.size(); ++j)
+            {
+                point_ids(i, j) = neighbours[j].id;
+                distances(i, j) = std::sqrt(neighbours[j].squared_distance);
+            } });
+
+        return Output{
+            .point_ids = std::move(point_ids),
+            .distances = std::move(distances),
+            .message = "Answered " + std::to_string(n) + " " + std::to_string(k) + "-nearest-neighbour queries."
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<KnnSearchCartridge>);
@@ -21,6 +21,8 @@ public:
 
     static inline const std::string command_name = "loadJson";
     static inline const std::string description = "Loads a JSON file and registers its content as a result.";
+    // Reads the file on every call; a replay never reuses an earlier result.
+    static constexpr bool cacheable = false;
 
     Output execute(const Input &input) const
     {
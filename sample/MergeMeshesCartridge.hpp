@@ -0,0 +1,67 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/MeshAssembly.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class MergeMeshesCartridge
+{
+public:
+    struct Input
+    {
+        // Usually a list of references, e.g. ["$ref:cmd[1].polygon_mesh", "$ref:cmd[2].polygon_mesh"].
+        rfl::Field<"polygon_meshes", std::vector<MITSU_Domoe::Polygon_mesh>> polygon_meshes;
+        // When given, boundary vertices within this distance of each other (0: coincident) are welded
+        // and the result is cleaned up as by cleanMesh. Otherwise the meshes are only concatenated.
+        rfl::Field<"weld_tolerance", std::optional<double>> weld_tolerance;
+    };
+
+    struct Output
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // With weld_tolerance: what welding merged and the cleanup removed (see cleanMesh); otherwise 0.
+        rfl::Field<"welded_vertices", int> welded_vertices;
+        rfl::Field<"unreferenced_vertices", int> unreferenced_vertices;
+        rfl::Field<"degenerate_faces", int> degenerate_faces;
+        rfl::Field<"duplicate_faces", int> duplicate_faces;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "mergeMeshes";
+    static inline const std::string description = "Concatenates a list of meshes into one, optionally welding them where their boundaries meet.";
+
+    Output execute(const Input &input) const
+    {
+        const auto &meshes = input.polygon_meshes.get();
+        const std::optional<double> weld_tolerance = input.weld_tolerance.get();
+        if (weld_tolerance && *weld_tolerance < 0.0)
+        {
+            throw std::invalid_argument("'weld_tolerance' must not be negative.");
+        }
+
+        MITSU_Domoe::MeshCleanup result = MITSU_Domoe::merge_meshes(meshes, weld_tolerance.value_or(-1.0));
+
+        std::string message = "Merged " + std::to_string(meshes.size()) + " meshes into " + std::to_string(result.mesh.V.rows()) + " vertices and " +
+                              std::to_string(result.mesh.F.rows()) + " faces";
+        message += weld_tolerance ? " (" + std::to_string(result.welded_vertices) + " vertices welded, " +
+                                        std::to_string(result.unreferenced_vertices) + " unreferenced; " + std::to_string(result.degenerate_faces) +
+                                        " degenerate and " + std::to_string(result.duplicate_faces) + " duplicate faces removed)."
+                                  : ".";
+        return Output{
+            .polygon_mesh = std::move(result.mesh),
+            .welded_vertices = static_cast<int>(result.welded_vertices),
+            .unreferenced_vertices = static_cast<int>(result.unreferenced_vertices),
+            .degenerate_faces = static_cast<int>(result.degenerate_faces),
+            .duplicate_faces = static_cast<int>(result.duplicate_faces),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<MergeMeshesCartridge>);
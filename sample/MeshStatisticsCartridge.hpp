@@ -0,0 +1,67 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Clustering.hpp"
+#include "MITSUDomoe/MeshStatistics.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <cstdint>
+#include <string>
+
+class MeshStatisticsCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+    };
+
+    struct Output
+    {
+        rfl::Field<"vertex_count", uint64_t> vertex_count;
+        rfl::Field<"face_count", uint64_t> face_count;
+        // Faces of zero area, including those that repeat a vertex.
+        rfl::Field<"degenerate_count", uint64_t> degenerate_count;
+        rfl::Field<"total_area", double> total_area;
+        // Histograms of areas and lengths have four logarithmic bins per octave.
+        rfl::Field<"face_area", MITSU_Domoe::Value_distribution> face_area;
+        // Every edge of every face, so an edge shared by two faces counts twice.
+        rfl::Field<"edge_length", MITSU_Domoe::Value_distribution> edge_length;
+        // 1 for an equilateral triangle, growing as the triangle gets thinner. Degenerate faces are left out.
+        rfl::Field<"aspect_ratio", MITSU_Domoe::Value_distribution> aspect_ratio;
+        // Smallest angle of each face in degrees, in one-degree bins. Degenerate faces are left out.
+        rfl::Field<"min_angle", MITSU_Domoe::Value_distribution> min_angle;
+        // Largest distance from each face centroid to its corners, as bounded by subdividePolygon's r.
+        rfl::Field<"centroid_radius", MITSU_Domoe::Value_distribution> centroid_radius;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "meshStatistics";
+    static inline const std::string description = "Computes area, edge length, aspect ratio and angle statistics and histograms of a triangle mesh in one pass.";
+
+    Output execute(const Input &input) const
+    {
+        const auto &mesh = input.polygon_mesh.get();
+        MITSU_Domoe::cluster_detail::check_triangle_mesh(mesh);
+
+        MITSU_Domoe::Mesh_statistics statistics = MITSU_Domoe::mesh_statistics(mesh.V, mesh.F);
+
+        const std::string message = "Computed statistics of " + std::to_string(statistics.face_count) + " faces (" +
+                                    std::to_string(statistics.degenerate_count) + " degenerate).";
+        return Output{
+            .vertex_count = static_cast<uint64_t>(mesh.V.rows()),
+            .face_count = statistics.face_count,
+            .degenerate_count = statistics.degenerate_count,
+            .total_area = statistics.total_area,
+            .face_area = std::move(statistics.face_areas),
+            .edge_length = std::move(statistics.edge_lengths),
+            .aspect_ratio = std::move(statistics.aspect_ratios),
+            .min_angle = std::move(statistics.min_angles),
+            .centroid_radius = std::move(statistics.centroid_radii),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<MeshStatisticsCartridge>);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/MeshStream.hpp"
+#include <rfl.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+class OpenMeshStreamCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"filepath", std::string> filepath;
+        // Triangles per chunk read by downstream stream cartridges. Defaults to 262144 (about 9 MB of positions).
+        rfl::Field<"chunk_triangles", std::optional<uint64_t>> chunk_triangles;
+    };
+
+    struct Output
+    {
+        rfl::Field<"mesh_stream", MITSU_Domoe::Mesh_stream> mesh_stream;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "openMeshStream";
+    static inline const std::string description = "Opens an STL file as a mesh stream that later commands read chunk by chunk, for meshes too large to load at once.";
+    // Inspects the file on every call; a replay never reuses an earlier result.
+    static constexpr bool cacheable = false;
+
+    Output execute(const Input &input) const
+    {
+        const MITSU_Domoe::Mesh_stream stream = MITSU_Domoe::open_mesh_stream(
+            input.filepath.get(), input.chunk_triangles.get().value_or(MITSU_Domoe::DEFAULT_CHUNK_TRIANGLES));
+
+        const std::string count = stream.triangle_count > 0 ? std::to_string(stream.triangle_count) + " triangles" : "triangle count unknown";
+        return Output{
+            .mesh_stream = stream,
+            .message = "Opened " + stream.format + " mesh stream: " + stream.filepath + " (" + count + ")"
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<OpenMeshStreamCartridge>);
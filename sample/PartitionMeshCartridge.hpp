@@ -0,0 +1,53 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Partition.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+class PartitionMeshCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"k", int> k;
+        // Allowed excess of a part over the mean area; defaults to 0.03.
+        rfl::Field<"imbalance", std::optional<double>> imbalance;
+    };
+
+    struct Output
+    {
+        // Parts in order; each one can be referenced on its own, e.g. "$ref:cmd[0].partitions.2.mesh".
+        rfl::Field<"partitions", std::vector<MITSU_Domoe::Mesh_partition>> partitions;
+        rfl::Field<"polygon_clusters", MITSU_Domoe::Polygon_clusters> polygon_clusters;
+        rfl::Field<"cut_edges", size_t> cut_edges;
+        rfl::Field<"imbalance", double> imbalance;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "partitionMesh";
+    static inline const std::string description = "Splits a triangle mesh into k submeshes of balanced area with short boundaries by partitioning its face adjacency graph.";
+
+    Output execute(const Input &input) const
+    {
+        MITSU_Domoe::MeshPartitioning result = MITSU_Domoe::partition_mesh(input.polygon_mesh.get(), input.k.get(), input.imbalance.get().value_or(0.03));
+
+        const std::string message = "Split " + std::to_string(result.parts.faces.size()) + " faces into " +
+                                    std::to_string(result.partitions.size()) + " partitions with " +
+                                    std::to_string(result.cut_edges) + " cut edges (imbalance " + std::to_string(result.imbalance) + ").";
+        return Output{
+            .partitions = std::move(result.partitions),
+            .polygon_clusters = std::move(result.parts),
+            .cut_edges = result.cut_edges,
+            .imbalance = result.imbalance,
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<PartitionMeshCartridge>);
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/KdTree.hpp"
+#include "MITSUDomoe/ThreadPool.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <Eigen/Core>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class RadiusSearchCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"kd_tree", MITSU_Domoe::Point_kd_tree> kd_tree;
+        rfl::Field<"points", Eigen::MatrixXd> points;
+        rfl::Field<"radius", double> radius;
+    };
+
+    struct Output
+    {
+        // The points within radius of query i are point_ids[offsets[i], offsets[i + 1]), nearest first.
+        rfl::Field<"offsets", Eigen::VectorXi> offsets;
+        rfl::Field<"point_ids", Eigen::VectorXi> point_ids;
+        rfl::Field<"distances", Eigen::VectorXd> distances;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "radiusSearch";
+    static inline const std::string description = "Lists the points of a KD-tree within a radius of each query point.";
+
+    Output execute(const Input &input) const
+    {
+        constexpr size_t block_size = 256;
+
+        const Eigen::MatrixXd &points = input.points.get();
+        const double radius = input.radius.get();
+        if (points.rows() > 0 && points.cols() != 3)
+        {
+            throw std::invalid_argument("points must have 3 columns.");
+        }
+        if (!(radius >= 0.0))
+        {
+            throw std::invalid_argument("radius must not be negative.");
+        }
+        const auto tree = MITSU_Domoe::PackedKdTreeCache::shared().get(input.kd_tree.get());
+
+        // Queries are answered in spatial order, in blocks that collect their neighbours separately.
+        // Each block's results are then copied to the ranges of its queries in the output.
+        const size_t n = static_cast<size_t>(points.rows());
+        const std::vector<uint32_t> order = MITSU_Domoe::spatial_query_order(points);
+        const size_t num_blocks = (n + block_size - 1) / block_size;
+        std::vector<std::vector<MITSU_Domoe::PackedKdTree::Neighbour>> block_neighbours(num_blocks);
+        Eigen::VectorXi offsets = Eigen::VectorXi::Zero(n + 1);
+        MITSU_Domoe::parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                                  {
+            std::vector<MITSU_Domoe::PackedKdTree::StackEntry> stack;
+            for (size_t b = begin; b < end; ++b)
+            {
+                for (size_t j = b * block_size; j < std::min(n, (b + 1) * block_size); ++j)
+                {
+                    const size_t before = block_neighbours[b].size();
+                    tree->radius_search(points.row(order[j]).transpose(), radius, block_neighbours[b], stack);
+                    offsets(order[j] + 1) = static_cast<int>(block_neighbours[b].size() - before);
+                }
+            } }, 1);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            offsets(i + 1) += offsets(i);
+        }
+        Eigen::VectorXi point_ids(offsets(n));
+        Eigen::VectorXd distances(offsets(n));
+        MITSU_Domoe::parallel_for(0, num_blocks, [&](size_t begin, size_t end)
+                                  {
+            for (size_t b = begin; b < end; ++b)
+            {
+                const MITSU_Domoe::PackedKdTree::Neighbour *source = block_neighbours[b].data();
+                for (size_t j = b * block_size; j < std::min(n, (b + 1) * block_size); ++j)
+                {
+                    for (int out = offsets(order[j]); out < offsets(order[j] + 1); ++out, ++source)
+                    {
+                        point_ids(out) = source->id;
+                        distances(out) = std::sqrt(source->squared_distance);
+                    }
+                }
+            } }, 1);
+
+        const std::string message = "Found " + std::to_string(point_ids.size()) + " neighbours for " + std::to_string(n) + " points.";
+        return Output{
+            .offsets = std::move(offsets),
+            .point_ids = std::move(point_ids),
+            .distances = std::move(distances),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<RadiusSearchCartridge>);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/ObjReader.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp> // Use the serialization library for Eigen
+#include <Eigen/Core>
+#include <string>
+
+#include "MITSUDomoe/3D_objects.hpp"
+
+class ReadObjCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"filepath", std::string> filepath;
+    };
+
+    struct Output
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"filepath", std::string> filepath;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "readObj";
+    static inline const std::string description = "Reads a triangulated mesh from a Wavefront OBJ file, parsing large files on several threads.";
+    // Reads the file on every call; a replay never reuses an earlier result.
+    static constexpr bool cacheable = false;
+
+    Output execute(const Input &input) const
+    {
+        MITSU_Domoe::Polygon_mesh mesh;
+        try
+        {
+            mesh = MITSU_Domoe::read_obj(input.filepath.get());
+        }
+        catch (const std::exception &e)
+        {
+            return Output{
+                .polygon_mesh = MITSU_Domoe::Polygon_mesh(),
+                .filepath = input.filepath.get(),
+                .message = "Failed to read OBJ file: " + input.filepath.get() + " (" + e.what() + ")"
+            };
+        }
+
+        const std::string counts = std::to_string(mesh.V.rows()) + " vertices, " + std::to_string(mesh.F.rows()) + " faces";
+        return Output{
+            .polygon_mesh = std::move(mesh),
+            .filepath = input.filepath.get(),
+            .message = "Successfully read OBJ file: " + input.filepath.get() + " (" + counts + ")"
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<ReadObjCartridge>);
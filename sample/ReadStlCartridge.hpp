@@ -1,11 +1,11 @@
 #pragma once
 
 #include "MITSUDomoe/ICartridge.hpp"
-#include <fstream>
+#include "MITSUDomoe/StlReader.hpp"
 #include <rfl.hpp>
 #include <rfl_eigen_serdes.hpp> // Use the serialization library for Eigen
-#include <igl/readSTL.h>
 #include <Eigen/Core>
+#include <optional>
 #include <vector>
 #include <string>
 
@@ -17,6 +17,9 @@ public:
     struct Input
     {
         rfl::Field<"filepath", std::string> filepath;
+        // Corners closer than this are merged into one vertex. Defaults to 0 (only identical corners);
+        // a negative value keeps three separate vertices per face.
+        rfl::Field<"weld_tolerance", std::optional<double>> weld_tolerance;
     };
 
     struct Output
@@ -27,28 +30,31 @@ public:
     };
 
     static inline const std::string command_name = "readStl";
-    static inline const std::string description = "Reads a mesh from an STL file.";
+    static inline const std::string description = "Reads a mesh from a binary or ASCII STL file and welds coincident vertices.";
+    // Reads the file on every call; a replay never reuses an earlier result.
+    static constexpr bool cacheable = false;
 
     Output execute(const Input &input) const
     {
-
-        std::ifstream ifs(input.filepath.get());
-        Eigen::MatrixXd V;
-        Eigen::MatrixXi F;
-        Eigen::MatrixXd N; // Normals, not used for now
-        if (!igl::readSTL(ifs, V, F, N))
+        MITSU_Domoe::Polygon_mesh mesh;
+        try
+        {
+            mesh = MITSU_Domoe::read_stl(input.filepath.get(), input.weld_tolerance.get().value_or(0.0));
+        }
+        catch (const std::exception &e)
         {
             return Output{
                 .polygon_mesh = MITSU_Domoe::Polygon_mesh(),
                 .filepath = input.filepath.get(),
-                .message = "Failed to read STL file: " + input.filepath.get()
+                .message = "Failed to read STL file: " + input.filepath.get() + " (" + e.what() + ")"
             };
         }
 
+        const std::string counts = std::to_string(mesh.V.rows()) + " vertices, " + std::to_string(mesh.F.rows()) + " faces";
         return Output{
-            .polygon_mesh = {{V, F, N}},
+            .polygon_mesh = std::move(mesh),
             .filepath = input.filepath.get(),
-            .message = "Successfully read STL file: " + input.filepath.get()
+            .message = "Successfully read STL file: " + input.filepath.get() + " (" + counts + ")"
         };
     }
 };
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/DerivedData.hpp"
+#include "MITSUDomoe/SurfaceSampling.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+class SampleSurfaceCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // "uniform" (default): independent area-weighted random points.
+        // "poisson": points no closer than a radius to each other, spread evenly.
+        rfl::Field<"method", std::optional<std::string>> method;
+        // Exactly one of count, density (points per unit area) and, for "poisson", radius must be
+        // given. For "poisson", count and density are approximate.
+        rfl::Field<"count", std::optional<int>> count;
+        rfl::Field<"density", std::optional<double>> density;
+        rfl::Field<"radius", std::optional<double>> radius;
+        // The same seed gives the same points (default 0).
+        rfl::Field<"seed", std::optional<int>> seed;
+    };
+
+    struct Output
+    {
+        // Positions and unit normals, interpolated from the vertex normals of the mesh when it has
+        // them, otherwise the normals of the faces the points lie on.
+        rfl::Field<"point_cloud", MITSU_Domoe::Point_cloud> point_cloud;
+        // Minimum distance between points for "poisson", 0 for "uniform".
+        rfl::Field<"radius", double> radius;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "sampleSurface";
+    static inline const std::string description = "Samples points on the surface of a triangle mesh, area-weighted at random or by Poisson-disk sampling.";
+
+    Output execute(const Input &input) const
+    {
+        const auto &mesh = input.polygon_mesh.get();
+        const std::string method = input.method.get().value_or("uniform");
+        const std::optional<int> count = input.count.get();
+        const std::optional<double> density = input.density.get();
+        const std::optional<double> radius = input.radius.get();
+        const uint64_t seed = static_cast<uint64_t>(static_cast<int64_t>(input.seed.get().value_or(0)));
+        if (method != "uniform" && method != "poisson")
+        {
+            throw std::invalid_argument("'method' must be \"uniform\" or \"poisson\", got \"" + method + "\"");
+        }
+        if (count.has_value() + density.has_value() + radius.has_value() != 1)
+        {
+            throw std::invalid_argument("Exactly one of 'count', 'density' and 'radius' must be given.");
+        }
+        if (radius && method != "poisson")
+        {
+            throw std::invalid_argument("'radius' is only used by the \"poisson\" method.");
+        }
+        if (count && *count < 0)
+        {
+            throw std::invalid_argument("'count' must not be negative, got " + std::to_string(*count));
+        }
+        if (density && !(*density >= 0.0 && std::isfinite(*density)))
+        {
+            throw std::invalid_argument("'density' must be a non-negative number.");
+        }
+        MITSU_Domoe::cluster_detail::check_triangle_mesh(mesh);
+
+        const double area = mesh.F.rows() > 0 ? MITSU_Domoe::MeshDerivedData(mesh).face_geometry()->areas.sum() : 0.0;
+        const double target = count ? static_cast<double>(*count) : density ? *density * area : 0.0;
+        if (!radius && !(target >= 1.0))
+        {
+            return Output{
+                .point_cloud = MITSU_Domoe::Point_cloud{},
+                .radius = 0.0,
+                .message = "No points requested."
+            };
+        }
+
+        MITSU_Domoe::Point_cloud points;
+        double min_distance = 0.0;
+        if (method == "uniform")
+        {
+            points = MITSU_Domoe::sample_surface_uniform(mesh, static_cast<size_t>(std::llround(target)), seed);
+        }
+        else
+        {
+            min_distance = radius ? *radius : MITSU_Domoe::poisson_disk_radius(area, static_cast<size_t>(std::llround(target)));
+            points = MITSU_Domoe::sample_surface_poisson(mesh, min_distance, seed);
+        }
+
+        const std::string message = "Sampled " + std::to_string(points.positions.rows()) + " points (" + method + ").";
+        return Output{
+            .point_cloud = std::move(points),
+            .radius = min_distance,
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<SampleSurfaceCartridge>);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/MeshStream.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <Eigen/Core>
+#include <limits>
+#include <string>
+
+class StreamBoundingBoxCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"mesh_stream", MITSU_Domoe::Mesh_stream> mesh_stream;
+    };
+
+    struct Output
+    {
+        rfl::Field<"min", Eigen::RowVector3d> min;
+        rfl::Field<"max", Eigen::RowVector3d> max;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "streamBoundingBox";
+    static inline const std::string description = "Computes the axis-aligned bounding box of a mesh stream one chunk at a time.";
+    // Reads the streamed file, which may have changed since it was opened; never reused from the cache.
+    static constexpr bool cacheable = false;
+
+    Output execute(const Input &input) const
+    {
+        Eigen::RowVector3d lower = Eigen::RowVector3d::Constant(std::numeric_limits<double>::infinity());
+        Eigen::RowVector3d upper = Eigen::RowVector3d::Constant(-std::numeric_limits<double>::infinity());
+
+        // Min and max are exact, so chunk order and threading cannot change the result.
+        const uint64_t triangles = MITSU_Domoe::for_each_mesh_chunk(input.mesh_stream.get(), [&](const MITSU_Domoe::MeshChunk &chunk)
+                                                                    {
+            lower = lower.cwiseMin(chunk.V.colwise().minCoeff());
+            upper = upper.cwiseMax(chunk.V.colwise().maxCoeff()); });
+
+        if (triangles == 0)
+        {
+            return Output{
+                .min = Eigen::RowVector3d::Zero(),
+                .max = Eigen::RowVector3d::Zero(),
+                .message = "Mesh stream has no triangles."
+            };
+        }
+
+        return Output{
+            .min = lower,
+            .max = upper,
+            .message = "Computed bounding box of " + std::to_string(triangles) + " triangles."
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<StreamBoundingBoxCartridge>);
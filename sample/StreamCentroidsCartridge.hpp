@@ -0,0 +1,90 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/MeshStream.hpp"
+#include "MITSUDomoe/MeshWriter.hpp"
+#include "GenerateCentroidsCartridge.hpp"
+#include <rfl.hpp>
+#include <Eigen/Core>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class StreamCentroidsCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"mesh_stream", MITSU_Domoe::Mesh_stream> mesh_stream;
+        rfl::Field<"output_path", std::string> output_path;
+    };
+
+    struct Output
+    {
+        rfl::Field<"output_path", std::string> output_path;
+        rfl::Field<"centroid_count", uint64_t> centroid_count;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "streamCentroids";
+    static inline const std::string description = "Computes face centroids of a mesh stream chunk by chunk and writes them to a binary PLY point cloud.";
+    // Reads the streamed file and writes output_path, so it always runs.
+    static constexpr bool cacheable = false;
+
+    Output execute(const Input &input) const
+    {
+        std::ofstream out(input.output_path.get(), std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("Failed to open output file: " + input.output_path.get());
+        }
+
+        // The vertex count is only known at the end for ASCII sources, so it is written as a
+        // fixed-width field and patched in place once all chunks are done.
+        const std::string count_prefix = "ply\nformat binary_little_endian 1.0\nelement vertex ";
+        out << count_prefix << format_count(0)
+            << "\nproperty double x\nproperty double y\nproperty double z\nend_header\n";
+
+        std::vector<char> buffer;
+        const uint64_t count = MITSU_Domoe::for_each_mesh_chunk(input.mesh_stream.get(), [&](const MITSU_Domoe::MeshChunk &chunk)
+                                                                {
+            const Eigen::MatrixXd centroids = GenerateCentroidsCartridge::compute_centroids(chunk.V, chunk.F);
+            buffer.resize(static_cast<size_t>(centroids.rows()) * 3 * sizeof(double));
+            char *p = buffer.data();
+            for (Eigen::Index i = 0; i < centroids.rows(); ++i)
+            {
+                for (int k = 0; k < 3; ++k, p += sizeof(double))
+                {
+                    MITSU_Domoe::writer_detail::store_le<double>(p, centroids(i, k));
+                }
+            }
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size())); });
+
+        out.seekp(static_cast<std::streamoff>(count_prefix.size()));
+        out << format_count(count);
+        out.close();
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write output file: " + input.output_path.get());
+        }
+
+        return Output{
+            .output_path = input.output_path.get(),
+            .centroid_count = count,
+            .message = "Wrote " + std::to_string(count) + " centroids to " + input.output_path.get()
+        };
+    }
+
+private:
+    // Zero-padded to the width of the largest uint64_t.
+    static std::string format_count(uint64_t count)
+    {
+        std::string digits = std::to_string(count);
+        return std::string(20 - digits.size(), '0') + digits;
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<StreamCentroidsCartridge>);
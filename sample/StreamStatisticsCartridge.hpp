@@ -0,0 +1,76 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/MeshStatistics.hpp"
+#include "MITSUDomoe/MeshStream.hpp"
+#include <rfl.hpp>
+#include <cstdint>
+#include <string>
+
+class StreamStatisticsCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"mesh_stream", MITSU_Domoe::Mesh_stream> mesh_stream;
+    };
+
+    struct Output
+    {
+        rfl::Field<"triangle_count", uint64_t> triangle_count;
+        rfl::Field<"degenerate_count", uint64_t> degenerate_count;
+        rfl::Field<"total_area", double> total_area;
+        rfl::Field<"min_area", double> min_area;
+        rfl::Field<"max_area", double> max_area;
+        rfl::Field<"min_edge_length", double> min_edge_length;
+        rfl::Field<"max_edge_length", double> max_edge_length;
+        rfl::Field<"mean_edge_length", double> mean_edge_length;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "streamStatistics";
+    static inline const std::string description = "Computes triangle count, area and edge length statistics of a mesh stream one chunk at a time.";
+    // Reads the streamed file, which may have changed since it was opened; never reused from the cache.
+    static constexpr bool cacheable = false;
+
+    Output execute(const Input &input) const
+    {
+        // The chunks go through the same fused pass as meshStatistics, one after another in file
+        // order, so the sums do not depend on the number of threads.
+        MITSU_Domoe::MeshStatisticsAccumulator accumulator;
+        const uint64_t triangles = MITSU_Domoe::for_each_mesh_chunk(input.mesh_stream.get(), [&](const MITSU_Domoe::MeshChunk &chunk)
+                                                                    { accumulator.add(chunk.V, chunk.F); });
+
+        if (triangles == 0)
+        {
+            return Output{
+                .triangle_count = 0,
+                .degenerate_count = 0,
+                .total_area = 0.0,
+                .min_area = 0.0,
+                .max_area = 0.0,
+                .min_edge_length = 0.0,
+                .max_edge_length = 0.0,
+                .mean_edge_length = 0.0,
+                .message = "Mesh stream has no triangles."
+            };
+        }
+
+        const MITSU_Domoe::Mesh_statistics statistics = accumulator.result();
+        return Output{
+            .triangle_count = triangles,
+            .degenerate_count = statistics.degenerate_count,
+            .total_area = statistics.total_area,
+            .min_area = statistics.face_areas.min,
+            .max_area = statistics.face_areas.max,
+            .min_edge_length = statistics.edge_lengths.min,
+            .max_edge_length = statistics.edge_lengths.max,
+            .mean_edge_length = statistics.edge_lengths.mean,
+            .message = "Computed statistics of " + std::to_string(triangles) + " triangles (" +
+                       std::to_string(statistics.degenerate_count) + " degenerate)."
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<StreamStatisticsCartridge>);
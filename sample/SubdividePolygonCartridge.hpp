@@ -7,10 +7,13 @@
 #include <Eigen/Core>
 #include <string>
 #include <vector>
-#include <igl/barycenter.h>
-#include <igl/edge_lengths.h>
-#include <iostream>
-#include <list>
+#include "MITSUDomoe/ThreadPool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
 
 class SubdividePolygonCartridge
 {
@@ -34,88 +37,168 @@ public:
 
     Output execute(const Input &input) const
     {
-        Eigen::MatrixXd V = input.input_polygon_mesh.get().V;
-        Eigen::MatrixXi F = input.input_polygon_mesh.get().F;
+        const auto &mesh = input.input_polygon_mesh.get();
         const double r = input.r.get();
+        if (!(r > 0.0))
+        {
+            throw std::invalid_argument("'r' must be positive, got " + std::to_string(r));
+        }
         const double r_squared = r * r;
 
-        const int num_faces_before = F.rows();
+        const int num_faces_before = mesh.F.rows();
 
-        std::vector<Eigen::RowVector3d> V_vec;
-        for (long i = 0; i < V.rows(); ++i)
+        std::vector<Eigen::RowVector3d> V_vec(mesh.V.rows());
+        for (long i = 0; i < mesh.V.rows(); ++i)
         {
-            V_vec.push_back(V.row(i));
+            V_vec[i] = mesh.V.row(i);
         }
-
-        std::list<Eigen::RowVector3i> F_worklist;
-        for (long i = 0; i < F.rows(); ++i)
+        std::vector<Eigen::RowVector3i> F_vec(mesh.F.rows());
+        for (long i = 0; i < mesh.F.rows(); ++i)
         {
-            F_worklist.push_back(F.row(i));
+            F_vec[i] = mesh.F.row(i);
         }
 
-        std::vector<Eigen::RowVector3i> F_final_vec;
-
-        while (!F_worklist.empty())
+        // Each round bisects the longest edge of every face that is still too large. An edge is split
+        // once, at a midpoint shared by both faces on it, and any face touching a split edge also has
+        // its own longest edge split (Rivara closure). This keeps the mesh conforming, so no T-junctions
+        // or duplicate vertices appear.
+        std::vector<uint8_t> longest(F_vec.size());
+        std::vector<uint8_t> split(F_vec.size());
+        std::vector<uint64_t> requested_edges;
+        std::vector<uint64_t> edge_list;
+        SplitEdges split_edges;
+        while (true)
         {
-            Eigen::RowVector3i face_indices = F_worklist.front();
-            F_worklist.pop_front();
-
-            Eigen::RowVector3d v0 = V_vec[face_indices(0)];
-            Eigen::RowVector3d v1 = V_vec[face_indices(1)];
-            Eigen::RowVector3d v2 = V_vec[face_indices(2)];
-
-            Eigen::RowVector3d centroid = (v0 + v1 + v2) / 3.0;
-
-            double max_dist_sq = 0.0;
-            max_dist_sq = std::max(max_dist_sq, (v0 - centroid).squaredNorm());
-            max_dist_sq = std::max(max_dist_sq, (v1 - centroid).squaredNorm());
-            max_dist_sq = std::max(max_dist_sq, (v2 - centroid).squaredNorm());
-
-            if (max_dist_sq <= r_squared)
+            longest.resize(F_vec.size());
+            split.assign(F_vec.size(), 0);
+            requested_edges.assign(F_vec.size(), NO_EDGE);
+            MITSU_Domoe::parallel_for(0, F_vec.size(), [&](size_t begin, size_t end)
+                                      {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    longest[f] = static_cast<uint8_t>(longest_edge(F_vec[f], V_vec));
+                    if (exceeds_radius(F_vec[f], V_vec, r_squared))
+                    {
+                        split[f] = 1;
+                        requested_edges[f] = face_edge_key(F_vec[f], longest[f]);
+                    }
+                } });
+            edge_list.clear();
+            if (append_requested(requested_edges, edge_list) == 0)
             {
-                F_final_vec.push_back(face_indices);
+                break;
             }
-            else
-            {
-                double d01_sq = (v0 - v1).squaredNorm();
-                double d12_sq = (v1 - v2).squaredNorm();
-                double d20_sq = (v2 - v0).squaredNorm();
+            split_edges.build(V_vec.size(), edge_list);
 
-                int v_idx0 = face_indices(0);
-                int v_idx1 = face_indices(1);
-                int v_idx2 = face_indices(2);
-
-                int p1_idx, p2_idx, opposite_v_idx;
-                Eigen::RowVector3d new_v_coords;
-
-                if (d01_sq >= d12_sq && d01_sq >= d20_sq)
-                {
-                    p1_idx = v_idx0;
-                    p2_idx = v_idx1;
-                    opposite_v_idx = v_idx2;
-                    new_v_coords = (v0 + v1) / 2.0;
-                }
-                else if (d12_sq >= d01_sq && d12_sq >= d20_sq)
+            // Faces that are not split yet but touch a split edge must split their longest edge too.
+            // Repeats until no face is left with a split edge other than its longest one.
+            while (true)
+            {
+                requested_edges.assign(F_vec.size(), NO_EDGE);
+                MITSU_Domoe::parallel_for(0, F_vec.size(), [&](size_t begin, size_t end)
+                                          {
+                    for (size_t f = begin; f < end; ++f)
+                    {
+                        if (split[f])
+                        {
+                            continue;
+                        }
+                        if (split_edges.find(F_vec[f](longest[f]), F_vec[f]((longest[f] + 1) % 3)) >= 0)
+                        {
+                            split[f] = 1;
+                            continue;
+                        }
+                        for (int k = 1; k < 3; ++k)
+                        {
+                            const int corner = (longest[f] + k) % 3;
+                            if (split_edges.find(F_vec[f](corner), F_vec[f]((corner + 1) % 3)) >= 0)
+                            {
+                                split[f] = 1;
+                                requested_edges[f] = face_edge_key(F_vec[f], longest[f]);
+                                break;
+                            }
+                        }
+                    } });
+                if (append_requested(requested_edges, edge_list) == 0)
                 {
-                    p1_idx = v_idx1;
-                    p2_idx = v_idx2;
-                    opposite_v_idx = v_idx0;
-                    new_v_coords = (v1 + v2) / 2.0;
+                    break;
                 }
-                else
+                split_edges.build(V_vec.size(), edge_list);
+            }
+
+            // Midpoints are numbered in sorted edge order, so the output does not depend on the thread count.
+            const size_t first_midpoint = V_vec.size();
+            V_vec.resize(first_midpoint + split_edges.size());
+            MITSU_Domoe::parallel_for(0, first_midpoint, [&](size_t begin, size_t end)
+                                      {
+                for (size_t a = begin; a < end; ++a)
                 {
-                    p1_idx = v_idx2;
-                    p2_idx = v_idx0;
-                    opposite_v_idx = v_idx1;
-                    new_v_coords = (v2 + v0) / 2.0;
-                }
+                    split_edges.for_each_edge_of(a, [&](size_t edge, int b)
+                                                 { V_vec[first_midpoint + edge] = (V_vec[a] + V_vec[b]) / 2.0; });
+                } });
 
-                int new_v_idx = V_vec.size();
-                V_vec.push_back(new_v_coords);
+            // Count children per face, prefix-sum the counts, then write every face's children in place.
+            // A split face has 2, 3 or 4 children, depending on how many of its edges are split.
+            std::vector<Eigen::RowVector3i> midpoints(F_vec.size());
+            std::vector<size_t> offsets(F_vec.size() + 1, 0);
+            MITSU_Domoe::parallel_for(0, F_vec.size(), [&](size_t begin, size_t end)
+                                      {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    if (!split[f])
+                    {
+                        offsets[f + 1] = 1;
+                        continue;
+                    }
+                    size_t children = 1;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        const int edge = split_edges.find(F_vec[f](k), F_vec[f]((k + 1) % 3));
+                        midpoints[f](k) = edge < 0 ? -1 : static_cast<int>(first_midpoint + edge);
+                        children += edge >= 0;
+                    }
+                    offsets[f + 1] = children;
+                } });
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
 
-                F_worklist.push_back(Eigen::RowVector3i(p1_idx, new_v_idx, opposite_v_idx));
-                F_worklist.push_back(Eigen::RowVector3i(p2_idx, opposite_v_idx, new_v_idx));
-            }
+            std::vector<Eigen::RowVector3i> F_next(offsets.back());
+            MITSU_Domoe::parallel_for(0, F_vec.size(), [&](size_t begin, size_t end)
+                                      {
+                for (size_t f = begin; f < end; ++f)
+                {
+                    Eigen::RowVector3i *out = F_next.data() + offsets[f];
+                    if (!split[f])
+                    {
+                        *out = F_vec[f];
+                        continue;
+                    }
+                    const int l = longest[f];
+                    const int a = F_vec[f](l);
+                    const int b = F_vec[f]((l + 1) % 3);
+                    const int c = F_vec[f]((l + 2) % 3);
+                    const int m = midpoints[f](l);
+                    const int m_bc = midpoints[f]((l + 1) % 3);
+                    const int m_ca = midpoints[f]((l + 2) % 3);
+                    if (m_ca < 0)
+                    {
+                        *out++ = Eigen::RowVector3i(a, m, c);
+                    }
+                    else
+                    {
+                        *out++ = Eigen::RowVector3i(c, m_ca, m);
+                        *out++ = Eigen::RowVector3i(a, m, m_ca);
+                    }
+                    if (m_bc < 0)
+                    {
+                        *out++ = Eigen::RowVector3i(b, c, m);
+                    }
+                    else
+                    {
+                        *out++ = Eigen::RowVector3i(b, m_bc, m);
+                        *out++ = Eigen::RowVector3i(c, m, m_bc);
+                    }
+                } });
+            F_vec = std::move(F_next);
         }
 
         Eigen::MatrixXd V_out(V_vec.size(), 3);
@@ -124,18 +207,149 @@ public:
             V_out.row(i) = V_vec[i];
         }
 
-        Eigen::MatrixXi F_out(F_final_vec.size(), 3);
-        for (size_t i = 0; i < F_final_vec.size(); ++i)
+        Eigen::MatrixXi F_out(F_vec.size(), 3);
+        for (size_t i = 0; i < F_vec.size(); ++i)
         {
-            F_out.row(i) = F_final_vec[i];
+            F_out.row(i) = F_vec[i];
         }
         const int num_faces_after = F_out.rows();
         return Output{
             .output_polygon_mesh = MITSU_Domoe::Polygon_mesh{V_out, F_out, {}},
             .polygon_num_origin = num_faces_before,
             .polygon_num_subdivided = num_faces_after,
-            .message = "Successfully subdivided mesh. Original faces: " + std::to_string(F.rows()) + ", new faces: " + std::to_string(F_out.rows())};
+            .message = "Successfully subdivided mesh. Original faces: " + std::to_string(num_faces_before) + ", new faces: " + std::to_string(F_out.rows())};
+    }
+
+private:
+    static constexpr uint64_t NO_EDGE = std::numeric_limits<uint64_t>::max();
+
+    static uint64_t edge_key(int a, int b)
+    {
+        return (static_cast<uint64_t>(std::min(a, b)) << 32) | static_cast<uint32_t>(std::max(a, b));
+    }
+
+    // Edge k of a face runs from corner k to corner k + 1.
+    static uint64_t face_edge_key(const Eigen::RowVector3i &face, int k)
+    {
+        return edge_key(face(k), face((k + 1) % 3));
     }
+
+    static bool exceeds_radius(const Eigen::RowVector3i &face, const std::vector<Eigen::RowVector3d> &V_vec, double r_squared)
+    {
+        const Eigen::RowVector3d &v0 = V_vec[face(0)];
+        const Eigen::RowVector3d &v1 = V_vec[face(1)];
+        const Eigen::RowVector3d &v2 = V_vec[face(2)];
+        const Eigen::RowVector3d centroid = (v0 + v1 + v2) / 3.0;
+
+        double max_dist_sq = 0.0;
+        max_dist_sq = std::max(max_dist_sq, (v0 - centroid).squaredNorm());
+        max_dist_sq = std::max(max_dist_sq, (v1 - centroid).squaredNorm());
+        max_dist_sq = std::max(max_dist_sq, (v2 - centroid).squaredNorm());
+        return max_dist_sq > r_squared;
+    }
+
+    // Ties go to the earlier edge, so every caller picks the same edge for a face.
+    static int longest_edge(const Eigen::RowVector3i &face, const std::vector<Eigen::RowVector3d> &V_vec)
+    {
+        const double d01_sq = (V_vec[face(0)] - V_vec[face(1)]).squaredNorm();
+        const double d12_sq = (V_vec[face(1)] - V_vec[face(2)]).squaredNorm();
+        const double d20_sq = (V_vec[face(2)] - V_vec[face(0)]).squaredNorm();
+        if (d01_sq >= d12_sq && d01_sq >= d20_sq)
+        {
+            return 0;
+        }
+        if (d12_sq >= d20_sq)
+        {
+            return 1;
+        }
+        return 2;
+    }
+
+    // Appends the requested edges to edge_list and returns how many there were.
+    static size_t append_requested(const std::vector<uint64_t> &requested_edges, std::vector<uint64_t> &edge_list)
+    {
+        const size_t size_before = edge_list.size();
+        std::copy_if(requested_edges.begin(), requested_edges.end(), std::back_inserter(edge_list),
+                     [](uint64_t key)
+                     { return key != NO_EDGE; });
+        return edge_list.size() - size_before;
+    }
+
+    // Split edges bucketed by their lower vertex (CSR), each bucket sorted by the upper vertex.
+    // The position of an edge is its rank in sorted key order, which numbers the midpoints.
+    // Faces that are close in the face list share vertices, so lookups stay cache-local.
+    class SplitEdges
+    {
+    public:
+        void build(size_t num_vertices, const std::vector<uint64_t> &edge_keys)
+        {
+            first_.assign(num_vertices + 1, 0);
+            for (const uint64_t key : edge_keys)
+            {
+                ++first_[(key >> 32) + 1];
+            }
+            std::partial_sum(first_.begin(), first_.end(), first_.begin());
+
+            other_.resize(edge_keys.size());
+            std::vector<size_t> cursor(first_.begin(), first_.end() - 1);
+            for (const uint64_t key : edge_keys)
+            {
+                other_[cursor[key >> 32]++] = static_cast<int>(key & 0xffffffffu);
+            }
+
+            // Sort and deduplicate each bucket, compacting the buckets towards the front.
+            size_t write = 0;
+            for (size_t a = 0; a < num_vertices; ++a)
+            {
+                const size_t begin = first_[a];
+                const size_t end = first_[a + 1];
+                std::sort(other_.begin() + begin, other_.begin() + end);
+                first_[a] = write;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    if (i == begin || other_[i] != other_[i - 1])
+                    {
+                        other_[write++] = other_[i];
+                    }
+                }
+            }
+            first_[num_vertices] = write;
+            other_.resize(write);
+        }
+
+        size_t size() const { return other_.size(); }
+
+        // Position of edge (a, b), or -1 if it is not split.
+        int find(int a, int b) const
+        {
+            if (a > b)
+            {
+                std::swap(a, b);
+            }
+            for (size_t i = first_[a]; i < first_[a + 1]; ++i)
+            {
+                if (other_[i] == b)
+                {
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        }
+
+        // Calls fn(position, b) for every split edge (a, b) with a < b.
+        template <typename Fn>
+        void for_each_edge_of(size_t a, Fn &&fn) const
+        {
+            for (size_t i = first_[a]; i < first_[a + 1]; ++i)
+            {
+                fn(i, other_[i]);
+            }
+        }
+
+    private:
+        std::vector<size_t> first_;
+        std::vector<int> other_;
+    };
 };
 
 static_assert(MITSU_Domoe::Cartridge<SubdividePolygonCartridge>);
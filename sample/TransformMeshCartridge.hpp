@@ -0,0 +1,50 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/MeshAssembly.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <Eigen/Core>
+#include <stdexcept>
+#include <string>
+
+class TransformMeshCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // 4x4 affine transform applied to column vectors (x, y, z, 1); the last row must be (0, 0, 0, 1).
+        rfl::Field<"transform", Eigen::MatrixXd> transform;
+    };
+
+    struct Output
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "transformMesh";
+    static inline const std::string description = "Applies a 4x4 affine transform to the vertices and normals of a mesh.";
+
+    Output execute(const Input &input) const
+    {
+        const auto &mesh = input.polygon_mesh.get();
+        const Eigen::MatrixXd &transform = input.transform.get();
+        if (transform.rows() != 4 || transform.cols() != 4)
+        {
+            throw std::invalid_argument("'transform' must be a 4x4 matrix, got " + std::to_string(transform.rows()) + "x" + std::to_string(transform.cols()));
+        }
+
+        MITSU_Domoe::Polygon_mesh result = MITSU_Domoe::transform_mesh(mesh, transform);
+
+        const std::string message = "Transformed " + std::to_string(result.V.rows()) + " vertices.";
+        return Output{
+            .polygon_mesh = std::move(result),
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<TransformMeshCartridge>);
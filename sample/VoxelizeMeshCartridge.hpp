@@ -0,0 +1,60 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/3D_objects.hpp"
+#include "MITSUDomoe/Voxelization.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+class VoxelizeMeshCartridge
+{
+public:
+    // Largest side of the preview mesh, in (coarsened) voxels.
+    static constexpr int PREVIEW_RESOLUTION = 128;
+
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        // Voxels along the longest side of the bounding box (default 128, at most 4096).
+        rfl::Field<"resolution", std::optional<int>> resolution;
+        // When true, the inside of the mesh is filled as well as its surface. The mesh should be closed.
+        rfl::Field<"solid", std::optional<bool>> solid;
+    };
+
+    struct Output
+    {
+        rfl::Field<"voxel_grid", MITSU_Domoe::Voxel_grid> voxel_grid;
+        // Outer faces of the voxels for display, coarsened to at most PREVIEW_RESOLUTION per side.
+        rfl::Field<"boundary_mesh", MITSU_Domoe::Polygon_mesh> boundary_mesh;
+        rfl::Field<"voxel_count", uint64_t> voxel_count;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "voxelizeMesh";
+    static inline const std::string description = "Voxelizes the surface or the solid of a triangle mesh into a sparse grid of 8x8x8 bricks.";
+
+    Output execute(const Input &input) const
+    {
+        const auto &mesh = input.polygon_mesh.get();
+        const int resolution = input.resolution.get().value_or(128);
+        const bool solid = input.solid.get().value_or(false);
+
+        MITSU_Domoe::Voxel_grid grid = MITSU_Domoe::voxelize_mesh(mesh, resolution, solid);
+        MITSU_Domoe::Polygon_mesh boundary = MITSU_Domoe::voxel_boundary_mesh(grid, PREVIEW_RESOLUTION);
+        const uint64_t count = MITSU_Domoe::voxel_count(grid);
+
+        const std::string message = "Voxelized " + std::string(solid ? "solid" : "surface") + " into " + std::to_string(count) + " voxels on a " +
+                                    std::to_string(grid.dimensions(0)) + "x" + std::to_string(grid.dimensions(1)) + "x" + std::to_string(grid.dimensions(2)) + " grid.";
+        return Output{
+            .voxel_grid = std::move(grid),
+            .boundary_mesh = std::move(boundary),
+            .voxel_count = count,
+            .message = message
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<VoxelizeMeshCartridge>);
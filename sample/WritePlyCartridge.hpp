@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/MeshWriter.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "MITSUDomoe/3D_objects.hpp"
+
+class WritePlyCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"filepath", std::string> filepath;
+        // Store vertex positions as double instead of float. Defaults to false.
+        rfl::Field<"double_precision", std::optional<bool>> double_precision;
+    };
+
+    struct Output
+    {
+        rfl::Field<"filepath", std::string> filepath;
+        rfl::Field<"bytes_written", uint64_t> bytes_written;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "writePly";
+    static inline const std::string description = "Writes a triangle mesh to a binary little-endian PLY file.";
+    // Writes the file, so it always runs.
+    static constexpr bool cacheable = false;
+
+    Output execute(const Input &input) const
+    {
+        const auto &mesh = input.polygon_mesh.get();
+        const uint64_t bytes = MITSU_Domoe::write_ply(input.filepath.get(), mesh, input.double_precision.get().value_or(false));
+        return Output{
+            .filepath = input.filepath.get(),
+            .bytes_written = bytes,
+            .message = "Wrote " + std::to_string(mesh.V.rows()) + " vertices and " + std::to_string(mesh.F.rows()) + " faces to " + input.filepath.get()
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<WritePlyCartridge>);
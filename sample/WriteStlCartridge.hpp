@@ -0,0 +1,44 @@
+#pragma once
+
+#include "MITSUDomoe/ICartridge.hpp"
+#include "MITSUDomoe/MeshWriter.hpp"
+#include <rfl.hpp>
+#include <rfl_eigen_serdes.hpp>
+#include <cstdint>
+#include <string>
+
+#include "MITSUDomoe/3D_objects.hpp"
+
+class WriteStlCartridge
+{
+public:
+    struct Input
+    {
+        rfl::Field<"polygon_mesh", MITSU_Domoe::Polygon_mesh> polygon_mesh;
+        rfl::Field<"filepath", std::string> filepath;
+    };
+
+    struct Output
+    {
+        rfl::Field<"filepath", std::string> filepath;
+        rfl::Field<"bytes_written", uint64_t> bytes_written;
+        rfl::Field<"message", std::string> message;
+    };
+
+    static inline const std::string command_name = "writeStl";
+    static inline const std::string description = "Writes a triangle mesh to a binary STL file.";
+    // Writes the file, so it always runs.
+    static constexpr bool cacheable = false;
+
+    Output execute(const Input &input) const
+    {
+        const uint64_t bytes = MITSU_Domoe::write_stl(input.filepath.get(), input.polygon_mesh.get());
+        return Output{
+            .filepath = input.filepath.get(),
+            .bytes_written = bytes,
+            .message = "Wrote " + std::to_string(input.polygon_mesh.get().F.rows()) + " faces to " + input.filepath.get()
+        };
+    }
+};
+
+static_assert(MITSU_Domoe::Cartridge<WriteStlCartridge>);
@@ -1,7 +1,12 @@
 #version 330 core
+in vec3 normal;
 out vec4 FragColor;
 
+// Fixed light in model space; both sides of a face are lit alike.
+const vec3 lightDirection = normalize(vec3(0.3, 0.5, 1.0));
+
 void main()
 {
-    FragColor = vec4(0.8, 0.8, 0.8, 1.0);
+    float diffuse = length(normal) > 0.0 ? abs(dot(normalize(normal), lightDirection)) : 1.0;
+    FragColor = vec4(vec3(0.8) * (0.3 + 0.7 * diffuse), 1.0);
 }
@@ -1,9 +1,13 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
 
 uniform mat4 MVP;
 
+out vec3 normal;
+
 void main()
 {
+    normal = aNormal;
     gl_Position = MVP * vec4(aPos, 1.0);
 }
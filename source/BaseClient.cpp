@@ -1,4 +1,51 @@
 #include "MITSUDomoe/BaseClient.hpp"
+#include "MITSUDomoe/SessionSnapshot.hpp"
+#include "MITSUDomoe/ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <rfl/json.hpp>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+namespace
+{
+// Returns the *.json files to process for a file or directory path.
+// The log files are named with a zero-padded ID, so lexicographical sort gives command order.
+std::vector<std::filesystem::path> collect_log_files(const std::filesystem::path& path)
+{
+    std::vector<std::filesystem::path> files;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".json") {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    } else if (std::filesystem::is_regular_file(path)) {
+        if (path.extension() == ".json") {
+            files.push_back(path);
+        }
+    } else {
+        spdlog::error("Path is not a valid file or directory: {}", path.string());
+    }
+    return files;
+}
+
+std::optional<std::string> read_file(const std::filesystem::path& file_path)
+{
+    std::ifstream ifs(file_path, std::ios::binary);
+    if (!ifs) {
+        spdlog::error("Failed to open file: {}", file_path.string());
+        return std::nullopt;
+    }
+    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+}
 
 namespace MITSU_Domoe
 {
@@ -45,4 +92,247 @@ void BaseClient::load_result(const std::string& json_content) {
     processor->load_result_from_log(json_content);
 }
 
+std::vector<BaseClient::LoadedLog> BaseClient::load_logs(const std::filesystem::path& path, LogLoadProgress* progress)
+{
+    const auto files = collect_log_files(path);
+    if (progress) {
+        progress->completed = 0;
+        progress->total = files.size();
+    }
+
+    struct ParsedLog
+    {
+        std::optional<std::pair<uint64_t, CommandResult>> result;
+        std::string pretty_json;
+    };
+    std::vector<ParsedLog> parsed(files.size());
+
+    parallel_for(0, files.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            spdlog::info("Loading log: {}", files[i].string());
+            if (const auto content = read_file(files[i])) {
+                parsed[i].result = CommandProcessor::parse_result_log(*content);
+
+                auto generic = rfl::json::read<rfl::Generic>(*content);
+                if (generic) {
+                    parsed[i].pretty_json = rfl::json::write(*generic, YYJSON_WRITE_PRETTY);
+                } else {
+                    spdlog::error("Failed to parse or print JSON from {}: {}", files[i].string(), generic.error().what());
+                }
+            }
+            if (progress) {
+                progress->completed++;
+            }
+        }
+    }, 1);
+
+    // Insert in ID order. Files that did not yield a result keep their filename order at the end.
+    std::vector<size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const auto& ra = parsed[a].result;
+        const auto& rb = parsed[b].result;
+        if (ra && rb) {
+            return ra->first < rb->first;
+        }
+        return ra.has_value() && !rb.has_value();
+    });
+
+    std::vector<std::pair<uint64_t, CommandResult>> results;
+    std::vector<LoadedLog> loaded;
+    results.reserve(files.size());
+    loaded.reserve(files.size());
+    for (size_t i : order) {
+        if (parsed[i].result) {
+            results.push_back(std::move(*parsed[i].result));
+        }
+        if (!parsed[i].pretty_json.empty()) {
+            loaded.push_back({files[i], std::move(parsed[i].pretty_json)});
+        }
+    }
+
+    const size_t num_results = results.size();
+    if (!results.empty()) {
+        // Commands posted after the load must not overwrite the loaded IDs.
+        processor->advance_next_command_id(results.back().first + 1);
+    }
+    result_repo->store_results(std::move(results));
+    spdlog::info("Loaded {} results from {} log files.", num_results, files.size());
+    return loaded;
+}
+
+BaseClient::TraceReport BaseClient::trace_logs(const std::filesystem::path& path, LogLoadProgress* progress, bool reuse_cached)
+{
+    const auto trace_start = std::chrono::steady_clock::now();
+    const auto files = collect_log_files(path);
+    if (progress) {
+        progress->completed = 0;
+        progress->total = files.size();
+    }
+
+    struct TracedRequest
+    {
+        std::optional<uint64_t> original_id;
+        std::string command_name;
+        std::string request_json;
+    };
+    std::vector<std::optional<TracedRequest>> requests(files.size());
+
+    parallel_for(0, files.size(), [&](size_t begin, size_t end) {
+        // Result logs carry the ID and the request before ref resolution.
+        // Command history logs only have the (unresolved) request; their ID is the filename prefix.
+        struct Log
+        {
+            rfl::Field<"id", std::optional<uint64_t>> id;
+            rfl::Field<"command", std::string> command;
+            rfl::Field<"request", rfl::Generic> request;
+            rfl::Field<"unresolved_request", std::optional<rfl::Generic>> unresolved_request;
+        };
+
+        for (size_t i = begin; i < end; ++i) {
+            spdlog::info("Tracing log: {}", files[i].string());
+            if (const auto content = read_file(files[i])) {
+                auto parsed = rfl::json::read<Log>(*content);
+                if (parsed) {
+                    TracedRequest request;
+                    request.original_id = parsed->id();
+                    if (!request.original_id) {
+                        const std::string stem = files[i].stem().string();
+                        const auto digits = stem.substr(0, stem.find('_'));
+                        if (!digits.empty() && std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+                            request.original_id = std::stoull(digits);
+                        }
+                    }
+                    request.command_name = parsed->command();
+                    request.request_json = rfl::json::write(parsed->unresolved_request() ? *parsed->unresolved_request() : parsed->request());
+                    requests[i] = std::move(request);
+                } else {
+                    spdlog::error("Failed to parse or trace JSON from {}: {}", files[i].string(), parsed.error().what());
+                }
+            }
+            if (progress) {
+                progress->completed++;
+            }
+        }
+    }, 1);
+
+    // $ref:cmd[N] refs to traced commands are rewritten to the IDs they get in this session,
+    // so a changed upstream result flows into the resolved input of everything downstream.
+    // latest/prev[n] are pinned to the traced command they resolve to in a serial replay. That turns them
+    // into explicit dependencies, and the processor runs independent branches of the trace concurrently.
+    // Interactive commands run one at a time; the replay uses every hardware thread while it lasts.
+    const size_t interactive_workers = processor->get_worker_count();
+    const size_t replay_workers = std::max(1u, std::thread::hardware_concurrency());
+    processor->set_worker_count(replay_workers);
+
+    std::map<uint64_t, uint64_t> id_map;
+    std::vector<uint64_t> posted_ids;
+    std::vector<CommandProcessor::CommandDependencies> posted_dependencies;
+    for (const auto& request : requests) {
+        if (!request) {
+            continue;
+        }
+        const std::string request_json = CommandProcessor::pin_relative_refs(
+            CommandProcessor::remap_command_refs(request->request_json, id_map), posted_ids);
+        spdlog::info("Re-posting command '{}' with input: {}", request->command_name, request_json);
+        const uint64_t new_id = processor->add_to_queue(request->command_name, request_json, reuse_cached, true);
+        if (request->original_id) {
+            id_map[*request->original_id] = new_id;
+        }
+        posted_ids.push_back(new_id);
+        posted_dependencies.push_back(CommandProcessor::collect_dependencies(request_json, new_id));
+    }
+
+    processor->wait_for_commands(posted_ids);
+    processor->set_worker_count(interactive_workers);
+
+    TraceReport report;
+    report.posted = posted_ids.size();
+    report.workers = replay_workers;
+    report.wall_time = std::chrono::steady_clock::now() - trace_start;
+
+    // Longest chain of dependent commands, weighted by measured run time. No schedule can beat it.
+    std::map<uint64_t, size_t> posted_index;
+    std::vector<std::chrono::duration<double>> path_end(posted_ids.size());
+    std::vector<std::optional<size_t>> path_previous(posted_ids.size());
+    std::optional<size_t> longest_so_far;
+    for (size_t i = 0; i < posted_ids.size(); ++i) {
+        std::chrono::duration<double> duration{0};
+        if (const auto timing = processor->take_command_timing(posted_ids[i])) {
+            duration = timing->finished - timing->started;
+        }
+        report.total_command_time += duration;
+
+        std::optional<size_t> previous;
+        auto consider = [&](size_t j) {
+            if (!previous || path_end[j] > path_end[*previous]) {
+                previous = j;
+            }
+        };
+        if (posted_dependencies[i].depends_on_all_earlier) {
+            if (longest_so_far) {
+                consider(*longest_so_far);
+            }
+        }
+        for (const uint64_t dependency : posted_dependencies[i].command_ids) {
+            if (auto it = posted_index.find(dependency); it != posted_index.end()) {
+                consider(it->second);
+            }
+        }
+        path_end[i] = duration + (previous ? path_end[*previous] : std::chrono::duration<double>{0});
+        path_previous[i] = previous;
+        posted_index[posted_ids[i]] = i;
+        if (!longest_so_far || path_end[i] > path_end[*longest_so_far]) {
+            longest_so_far = i;
+        }
+    }
+    if (longest_so_far) {
+        report.critical_path_time = path_end[*longest_so_far];
+        for (std::optional<size_t> i = longest_so_far; i; i = path_previous[*i]) {
+            report.critical_path.push_back(posted_ids[*i]);
+        }
+        std::reverse(report.critical_path.begin(), report.critical_path.end());
+    }
+
+    spdlog::info("{}", report.to_string());
+    return report;
+}
+
+std::string BaseClient::TraceReport::to_string() const
+{
+    std::string path;
+    for (const uint64_t id : critical_path) {
+        path += (path.empty() ? "" : " -> ") + std::to_string(id);
+    }
+    return fmt::format("Replayed {} commands on {} workers in {:.3f} s (command time {:.3f} s, critical path {:.3f} s: {})",
+                       posted, workers, wall_time.count(), total_command_time.count(), critical_path_time.count(),
+                       path.empty() ? "none" : path);
+}
+
+bool BaseClient::save_snapshot(const std::filesystem::path& path)
+{
+    return write_session_snapshot(path, *result_repo, processor->get_next_command_id(), get_snapshot_attachments());
+}
+
+bool BaseClient::restore_snapshot(const std::filesystem::path& path)
+{
+    auto snapshot = read_session_snapshot(path);
+    if (!snapshot) {
+        return false;
+    }
+
+    uint64_t next_id = snapshot->next_command_id;
+    for (const auto& [id, result] : snapshot->results) {
+        next_id = std::max(next_id, id + 1);
+    }
+    // Attachments are parsed before the results are stored; a client must not apply them until
+    // restore_snapshot returns (see GuiClient::handle_restore_snapshot).
+    restore_snapshot_attachments(snapshot->attachments);
+    result_repo->store_results(std::move(snapshot->results));
+    processor->advance_next_command_id(next_id);
+
+    spdlog::info("Session restored from {}. Next command ID: {}", path.string(), processor->get_next_command_id());
+    return true;
+}
+
 }
@@ -6,11 +6,50 @@
 #include <fstream>
 #include <rfl/json.hpp>
 #include <iomanip>
+#include <algorithm>
+#include <tuple>
 
 namespace MITSU_Domoe
 {
     namespace
     {
+        // Appended to the command name of results loaded from logs.
+        constexpr std::string_view LOADED_COMMAND_SUFFIX = "(Loaded)";
+
+        std::string_view base_command_name(std::string_view command_name)
+        {
+            if (command_name.ends_with(LOADED_COMMAND_SUFFIX))
+            {
+                command_name.remove_suffix(LOADED_COMMAND_SUFFIX.size());
+            }
+            return command_name;
+        }
+
+        // Minified JSON, so requests that differ only in whitespace compare equal.
+        std::optional<std::string> normalize_json(const std::string &json)
+        {
+            yyjson_doc *doc = yyjson_read(json.c_str(), json.length(), 0);
+            if (!doc)
+            {
+                return std::nullopt;
+            }
+            char *written = yyjson_val_write(yyjson_doc_get_root(doc), 0, NULL);
+            yyjson_doc_free(doc);
+            if (!written)
+            {
+                return std::nullopt;
+            }
+            std::string normalized(written);
+            free(written);
+            return normalized;
+        }
+
+        size_t request_key(std::string_view command_name, const std::string &normalized_input)
+        {
+            const size_t h = std::hash<std::string_view>{}(command_name);
+            return h ^ (std::hash<std::string>{}(normalized_input) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+        }
+
         void log_unresolved_command(uint64_t id, const std::string &command_name, const std::string &unresolved_json, const std::filesystem::path &command_history_path)
         {
             std::stringstream ss;
@@ -43,8 +82,9 @@ namespace MITSU_Domoe
         }
     }
 
-    CommandProcessor::CommandProcessor(std::shared_ptr<ResultRepository> repo, const std::filesystem::path &log_path)
-        : result_repo_(std::move(repo)), log_path_(log_path)
+    CommandProcessor::CommandProcessor(std::shared_ptr<ResultRepository> repo, const std::filesystem::path &log_path, size_t num_workers)
+        : result_repo_(std::move(repo)), log_path_(log_path),
+          num_workers_(std::max<size_t>(1, num_workers))
     {
         command_history_path_ = log_path_ / "command_history";
         try
@@ -68,7 +108,39 @@ namespace MITSU_Domoe
 
     void CommandProcessor::start()
     {
-        worker_thread_ = std::thread(&CommandProcessor::worker_loop, this);
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        spdlog::info("Starting command processor with {} workers.", num_workers_);
+        for (size_t i = worker_threads_.size(); i < num_workers_; ++i)
+        {
+            worker_threads_.emplace_back(&CommandProcessor::worker_loop, this, i);
+        }
+    }
+
+    void CommandProcessor::set_worker_count(size_t num_workers)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            if (stop_flag_)
+            {
+                return;
+            }
+            num_workers_ = std::max<size_t>(1, num_workers);
+            // Before start() the count only takes effect there.
+            if (!worker_threads_.empty())
+            {
+                for (size_t i = worker_threads_.size(); i < num_workers_; ++i)
+                {
+                    worker_threads_.emplace_back(&CommandProcessor::worker_loop, this, i);
+                }
+            }
+        }
+        condition_.notify_all();
+    }
+
+    size_t CommandProcessor::get_worker_count() const
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        return num_workers_;
     }
 
     void CommandProcessor::stop()
@@ -77,79 +149,154 @@ namespace MITSU_Domoe
             std::unique_lock<std::mutex> lock(queue_mutex_);
             stop_flag_ = true;
         }
-        condition_.notify_one();
-        if (worker_thread_.joinable())
+        condition_.notify_all();
+        for (auto &worker : worker_threads_)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+        worker_threads_.clear();
+    }
+
+    std::map<uint64_t, CommandProcessor::CommandTask>::iterator CommandProcessor::find_ready_task()
+    {
+        const uint64_t lowest_running = running_commands_.empty() ? UINT64_MAX : *running_commands_.begin();
+        for (auto it = pending_commands_.begin(); it != pending_commands_.end(); ++it)
         {
-            worker_thread_.join();
+            const CommandTask &task = it->second;
+            if (task.dependencies.depends_on_all_earlier)
+            {
+                // Nothing earlier is queued if this is the first queued command.
+                if (it == pending_commands_.begin() && lowest_running > task.id)
+                {
+                    return it;
+                }
+                continue;
+            }
+            const bool ready = std::none_of(task.dependencies.command_ids.begin(), task.dependencies.command_ids.end(),
+                                            [this](uint64_t dependency)
+                                            { return pending_commands_.count(dependency) || running_commands_.count(dependency); });
+            if (ready)
+            {
+                return it;
+            }
         }
+        return pending_commands_.end();
     }
 
-    void CommandProcessor::worker_loop()
+    void CommandProcessor::worker_loop(size_t index)
     {
         while (true)
         {
             CommandTask current_task;
             {
                 std::unique_lock<std::mutex> lock(queue_mutex_);
-                condition_.wait(lock, [this]
-                                { return !command_queue_.empty() || stop_flag_; });
+                auto ready = pending_commands_.end();
+                condition_.wait(lock, [this, index, &ready]
+                                {
+                    ready = index < num_workers_ ? find_ready_task() : pending_commands_.end();
+                    return ready != pending_commands_.end() || (stop_flag_ && pending_commands_.empty()); });
 
-                if (stop_flag_ && command_queue_.empty())
+                if (ready == pending_commands_.end())
                 {
                     return;
                 }
 
-                current_task = std::move(command_queue_.front());
-                command_queue_.pop();
+                current_task = std::move(ready->second);
+                pending_commands_.erase(ready);
+                running_commands_.insert(current_task.id);
+                if (auto timing = command_timings_.find(current_task.id); timing != command_timings_.end())
+                {
+                    timing->second.started = std::chrono::steady_clock::now();
+                }
             }
 
-            spdlog::info("Executing command '{}' with ID {}...", current_task.command_name, current_task.id);
-            CommandResult result = current_task.task();
+            execute_task(current_task);
 
-            std::stringstream ss;
-            ss << "{";
-            ss << "\"id\":" << current_task.id << ",";
-            ss << "\"command\":\"" << current_task.command_name << "\",";
-
-            if (const auto *success = std::get_if<SuccessResult>(&result))
             {
-                ss << "\"unresolved_request\":" << success->unresolved_input_json << ",";
-                ss << "\"request\":" << success->resolved_input_json << ",";
-                ss << "\"status\":\"success\",";
-                ss << "\"response\":" << success->output_json << ",";
-                ss << "\"schema\":" << rfl::json::write(success->output_schema);
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                running_commands_.erase(current_task.id);
+                if (auto timing = command_timings_.find(current_task.id); timing != command_timings_.end())
+                {
+                    timing->second.finished = std::chrono::steady_clock::now();
+                }
             }
-            else if (const auto *error = std::get_if<ErrorResult>(&result))
+            // Wakes workers whose command was waiting on this one, and wait_for_commands callers.
+            condition_.notify_all();
+        }
+    }
+
+    void CommandProcessor::execute_task(CommandTask &current_task)
+    {
+        spdlog::info("Executing command '{}' with ID {}...", current_task.command_name, current_task.id);
+        CommandResult result = current_task.task(current_task.id);
+
+        std::stringstream ss;
+        ss << "{";
+        ss << "\"id\":" << current_task.id << ",";
+        ss << "\"command\":\"" << current_task.command_name << "\",";
+
+        if (const auto *success = std::get_if<SuccessResult>(&result))
+        {
+            ss << "\"unresolved_request\":" << success->unresolved_input_json << ",";
+            ss << "\"request\":" << success->resolved_input_json << ",";
+            ss << "\"status\":\"success\",";
+            ss << "\"response\":" << success->output_json << ",";
+            ss << "\"schema\":" << rfl::json::write(success->output_schema);
+        }
+        else if (const auto *error = std::get_if<ErrorResult>(&result))
+        {
+            ss << "\"request\":" << current_task.input_json << ",";
+            // A quick and dirty way to escape quotes in the error message
+            std::string error_msg = error->error_message;
+            std::string escaped_error_msg;
+            for (char c : error_msg)
             {
-                ss << "\"request\":" << current_task.input_json << ",";
-                // A quick and dirty way to escape quotes in the error message
-                std::string error_msg = error->error_message;
-                std::string escaped_error_msg;
-                for (char c : error_msg)
+                if (c == '\"')
                 {
-                    if (c == '\"')
-                    {
-                        escaped_error_msg += "\\\"";
-                    }
-                    else
-                    {
-                        escaped_error_msg += c;
-                    }
+                    escaped_error_msg += "\\\"";
+                }
+                else
+                {
+                    escaped_error_msg += c;
                 }
-                ss << "\"status\":\"error\",";
-                ss << "\"response\":\"" << escaped_error_msg << "\"";
             }
-            ss << "}";
+            ss << "\"status\":\"error\",";
+            ss << "\"response\":\"" << escaped_error_msg << "\"";
+        }
+        ss << "}";
 
-            std::stringstream filename_ss;
-            filename_ss << std::setw(LOG_ID_PADDING) << std::setfill('0') << current_task.id
-                        << "_" << current_task.command_name << ".json";
-            std::ofstream log_file(log_path_ / filename_ss.str());
-            log_file << ss.str();
+        std::stringstream filename_ss;
+        filename_ss << std::setw(LOG_ID_PADDING) << std::setfill('0') << current_task.id
+                    << "_" << current_task.command_name << ".json";
+        std::ofstream log_file(log_path_ / filename_ss.str());
+        log_file << ss.str();
+
+        result_repo_->store_result(current_task.id, std::move(result));
+        spdlog::info("Result for command ID {} stored.", current_task.id);
+    }
 
-            result_repo_->store_result(current_task.id, std::move(result));
-            spdlog::info("Result for command ID {} stored.", current_task.id);
+    std::optional<CommandProcessor::CommandTiming> CommandProcessor::take_command_timing(uint64_t command_id)
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        auto it = command_timings_.find(command_id);
+        if (it == command_timings_.end() || running_commands_.count(command_id) || pending_commands_.count(command_id))
+        {
+            return std::nullopt;
         }
+        const CommandTiming timing = it->second;
+        command_timings_.erase(it);
+        return timing;
+    }
+
+    void CommandProcessor::wait_for_commands(const std::vector<uint64_t> &command_ids)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        condition_.wait(lock, [this, &command_ids]
+                        { return std::none_of(command_ids.begin(), command_ids.end(), [this](uint64_t id)
+                                              { return pending_commands_.count(id) || running_commands_.count(id); }); });
     }
 
     // CommandProcessor::resolve_refs関数を以下のように修正
@@ -284,31 +431,193 @@ namespace MITSU_Domoe
             resolved_json.replace(start, len, it->text);
         }
 
-        const size_t max_display_length = 256;
-        std::string resolved_json_for_display = resolved_json;
-        if (resolved_json.size() > max_display_length)
+        // Skip building the truncated copy entirely unless debug output is enabled.
+        if (spdlog::should_log(spdlog::level::debug))
         {
-            resolved_json_for_display = resolved_json.substr(0, max_display_length) + "...";
-        }
+            const size_t max_display_length = 256;
+            std::string resolved_json_for_display = resolved_json;
+            if (resolved_json.size() > max_display_length)
+            {
+                resolved_json_for_display = resolved_json.substr(0, max_display_length) + "...";
+            }
 
-        spdlog::debug("Reference resolution finished. Final JSON: {}", resolved_json_for_display);
+            spdlog::debug("Reference resolution finished. Final JSON: {}", resolved_json_for_display);
+        }
         return resolved_json;
     }
 
-    uint64_t CommandProcessor::add_to_queue(const std::string &command_name, const std::string &input_json)
+    std::string CommandProcessor::remap_command_refs(const std::string &input_json, const std::map<uint64_t, uint64_t> &id_map)
     {
-        const uint64_t id = next_command_id_++;
-        log_unresolved_command(id, command_name, input_json, command_history_path_);
-        std::function<CommandResult()> task_logic;
+        static const std::regex cmd_ref_regex(R"(\$ref:cmd\[(\d+)\])");
+
+        std::string remapped;
+        remapped.reserve(input_json.size());
+        auto last = input_json.cbegin();
+        for (auto it = std::sregex_iterator(input_json.begin(), input_json.end(), cmd_ref_regex); it != std::sregex_iterator(); ++it)
+        {
+            const std::smatch &match = *it;
+            remapped.append(last, match[0].first);
+            const auto mapped = id_map.find(std::stoull(match[1].str()));
+            if (mapped != id_map.end())
+            {
+                remapped += "$ref:cmd[" + std::to_string(mapped->second) + "]";
+            }
+            else
+            {
+                remapped.append(match[0].first, match[0].second);
+            }
+            last = match[0].second;
+        }
+        remapped.append(last, input_json.cend());
+        return remapped;
+    }
+
+    void CommandProcessor::update_request_index()
+    {
+        // Caller holds request_index_mutex_. Only results stored since the last call are visited, and
+        // they are normalized after the repository lock is released. A replaced result may be indexed
+        // again; find_cached_result confirms every candidate against the repository anyway.
+        std::vector<std::tuple<uint64_t, std::string, std::string>> stored;
+        indexed_position_ = result_repo_->visit_results_since(indexed_position_, [&](uint64_t id, const CommandResult &result)
+                                                              {
+            const auto *success = std::get_if<SuccessResult>(&result);
+            if (!success || success->resolved_input_json.empty())
+            {
+                return;
+            }
+            const auto cartridge = cartridge_manager.find(std::string(base_command_name(success->command_name)));
+            if (cartridge != cartridge_manager.end() && !cartridge->second.cacheable)
+            {
+                return;
+            }
+            stored.emplace_back(id, success->command_name, success->resolved_input_json); });
+        for (const auto &[id, command_name, resolved_input_json] : stored)
+        {
+            if (auto normalized = normalize_json(resolved_input_json))
+            {
+                auto &ids = request_index_[request_key(base_command_name(command_name), *normalized)];
+                if (ids.empty() || ids.back() != id)
+                {
+                    ids.push_back(id);
+                }
+            }
+        }
+    }
+
+    std::optional<std::pair<uint64_t, SuccessResult>> CommandProcessor::find_cached_result(const std::string &command_name, const std::string &resolved_input_json)
+    {
+        const auto normalized = normalize_json(resolved_input_json);
+        if (!normalized)
+        {
+            return std::nullopt;
+        }
+
+        std::vector<uint64_t> candidates;
+        {
+            std::lock_guard<std::mutex> lock(request_index_mutex_);
+            update_request_index();
+            if (auto it = request_index_.find(request_key(command_name, *normalized)); it != request_index_.end())
+            {
+                candidates = it->second;
+            }
+        }
+
+        // Results can be replaced after indexing (e.g. by a restore), so confirm every hit.
+        for (auto it = candidates.rbegin(); it != candidates.rend(); ++it)
+        {
+            auto result = result_repo_->get_result(*it);
+            if (!result)
+            {
+                continue;
+            }
+            auto *success = std::get_if<SuccessResult>(&*result);
+            if (success && base_command_name(success->command_name) == command_name &&
+                normalize_json(success->resolved_input_json) == normalized)
+            {
+                return std::make_pair(*it, std::move(*success));
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::string CommandProcessor::pin_relative_refs(const std::string &input_json, const std::vector<uint64_t> &earlier_ids)
+    {
+        static const std::regex relative_ref_regex(R"(\$ref:(?:(latest)|prev\[(\d+)\]))");
+
+        std::string pinned;
+        pinned.reserve(input_json.size());
+        auto last = input_json.cbegin();
+        for (auto it = std::sregex_iterator(input_json.begin(), input_json.end(), relative_ref_regex); it != std::sregex_iterator(); ++it)
+        {
+            const std::smatch &match = *it;
+            pinned.append(last, match[0].first);
+            const size_t n = match[1].matched ? 1 : std::stoull(match[2].str());
+            if (n >= 1 && n <= earlier_ids.size())
+            {
+                pinned += "$ref:cmd[" + std::to_string(earlier_ids[earlier_ids.size() - n]) + "]";
+            }
+            else
+            {
+                pinned.append(match[0].first, match[0].second);
+            }
+            last = match[0].second;
+        }
+        pinned.append(last, input_json.cend());
+        return pinned;
+    }
+
+    CommandProcessor::CommandDependencies CommandProcessor::collect_dependencies(const std::string &input_json, uint64_t command_id)
+    {
+        static const std::regex ref_regex(R"(\$ref:(?:cmd\[(\d+)\]|latest|prev\[\d+\]))");
+
+        CommandDependencies dependencies;
+        for (auto it = std::sregex_iterator(input_json.begin(), input_json.end(), ref_regex); it != std::sregex_iterator(); ++it)
+        {
+            const std::smatch &match = *it;
+            if (!match[1].matched)
+            {
+                dependencies.depends_on_all_earlier = true;
+                continue;
+            }
+            // Refs to later commands fail at resolution time anyway; waiting on them could deadlock.
+            const uint64_t dependency = std::stoull(match[1].str());
+            if (dependency < command_id)
+            {
+                dependencies.command_ids.push_back(dependency);
+            }
+        }
+        std::sort(dependencies.command_ids.begin(), dependencies.command_ids.end());
+        dependencies.command_ids.erase(std::unique(dependencies.command_ids.begin(), dependencies.command_ids.end()), dependencies.command_ids.end());
+        return dependencies;
+    }
+
+    uint64_t CommandProcessor::add_to_queue(const std::string &command_name, const std::string &input_json, bool reuse_cached, bool record_timing)
+    {
+        std::function<CommandResult(uint64_t)> task_logic;
 
         if (auto it = cartridge_manager.find(command_name); it != cartridge_manager.end())
         {
-            task_logic = [this, handler = it->second.handler, input_json, command_name, id]
+            const bool cacheable = reuse_cached && it->second.cacheable;
+            task_logic = [this, handler = it->second.handler, input_json, command_name, cacheable](uint64_t id)
             {
                 try
                 {
 
                     const std::string resolved_input_json = this->resolve_refs(input_json, command_name, id);
+                    if (cacheable)
+                    {
+                        if (auto cached = this->find_cached_result(command_name, resolved_input_json))
+                        {
+                            auto &[cached_id, reused] = *cached;
+                            reused.command_name = command_name;
+                            reused.unresolved_input_json = input_json;
+                            reused.resolved_input_json = resolved_input_json;
+                            spdlog::info("Command ID {} ('{}') reuses the result of command ID {} ({} reused, {} executed so far).",
+                                         id, command_name, cached_id, ++reused_result_count_, executed_result_count_.load());
+                            return CommandResult(std::move(reused));
+                        }
+                        ++executed_result_count_;
+                    }
                     CommandResult result = handler(resolved_input_json);
                     if (auto *success = std::get_if<SuccessResult>(&result))
                     {
@@ -325,22 +634,43 @@ namespace MITSU_Domoe
         }
         else
         {
-            task_logic = [command_name]
+            task_logic = [command_name](uint64_t)
             {
                 return ErrorResult{"Error: Command '" + command_name + "' not found."};
             };
         }
 
+        uint64_t id;
         {
+            // The ID is taken under the queue lock so a command never sees a lower ID that is not queued yet.
             std::lock_guard<std::mutex> lock(queue_mutex_);
-            command_queue_.emplace(CommandTask{id, command_name, input_json, std::move(task_logic)});
+            id = next_command_id_++;
+            pending_commands_.emplace(id, CommandTask{id, command_name, input_json, std::move(task_logic), collect_dependencies(input_json, id)});
+            if (record_timing)
+            {
+                command_timings_[id].queued = std::chrono::steady_clock::now();
+            }
         }
-        condition_.notify_one();
+        condition_.notify_all();
+        log_unresolved_command(id, command_name, input_json, command_history_path_);
 
         spdlog::info("Command '{}' with ID {} added to the queue. Input: {}", command_name, id, input_json);
         return id;
     }
 
+    uint64_t CommandProcessor::get_next_command_id() const
+    {
+        return next_command_id_.load();
+    }
+
+    void CommandProcessor::advance_next_command_id(uint64_t next_id)
+    {
+        uint64_t current = next_command_id_.load();
+        while (current < next_id && !next_command_id_.compare_exchange_weak(current, next_id))
+        {
+        }
+    }
+
     std::vector<std::string> CommandProcessor::get_command_names() const
     {
         std::vector<std::string> names;
@@ -363,6 +693,14 @@ namespace MITSU_Domoe
     }
 
     void CommandProcessor::load_result_from_log(const std::string &json_content)
+    {
+        if (auto parsed = parse_result_log(json_content))
+        {
+            result_repo_->store_result(parsed->first, std::move(parsed->second));
+        }
+    }
+
+    std::optional<std::pair<uint64_t, CommandResult>> CommandProcessor::parse_result_log(const std::string &json_content)
     {
         struct LogFileFormat
         {
@@ -370,6 +708,7 @@ namespace MITSU_Domoe
             rfl::Field<"command", std::string> command;
             rfl::Field<"status", std::string> status;
             rfl::Field<"request", rfl::Generic> request;
+            rfl::Field<"unresolved_request", std::optional<rfl::Generic>> unresolved_request;
             rfl::Field<"response", rfl::Generic> response;
             rfl::Field<"schema", std::optional<std::map<std::string, std::string>>> schema;
         };
@@ -378,15 +717,18 @@ namespace MITSU_Domoe
         if (!parsed_log)
         {
             spdlog::error("Failed to parse log file for loading: {}", parsed_log.error().what());
-            return;
+            return std::nullopt;
         }
 
-        parsed_log->command.value() = parsed_log->command.value() + "(Loaded)";
+        parsed_log->command.value() = parsed_log->command.value() + std::string(LOADED_COMMAND_SUFFIX);
 
         const auto &log = *parsed_log;
-        spdlog::info("request: {}", rfl::json::write(log.request()));
-
-        spdlog::info("response: {}", rfl::json::write(log.response()));
+        // These dump the whole payload, so only serialize them when debug output is enabled.
+        if (spdlog::should_log(spdlog::level::debug))
+        {
+            spdlog::debug("request: {}", rfl::json::write(log.request()));
+            spdlog::debug("response: {}", rfl::json::write(log.response()));
+        }
 
         if (log.status() == "success" && log.schema())
         {
@@ -394,11 +736,17 @@ namespace MITSU_Domoe
             success.command_name = log.command();
             success.output_json = rfl::json::write(log.response());
             success.output_schema = *log.schema();
+            // Kept so reuse_cached lookups can match this result against replayed requests.
+            success.resolved_input_json = rfl::json::write(log.request());
+            if (log.unresolved_request())
+            {
+                success.unresolved_input_json = rfl::json::write(*log.unresolved_request());
+            }
 
             // input_raw and output_raw are left empty as they are not needed for tracing.
 
-            result_repo_->store_result(log.id(), std::move(success));
             spdlog::info("Successfully loaded result for command ID {} from log.", log.id());
+            return std::make_pair(log.id(), CommandResult(std::move(success)));
         }
         else if (log.status() == "error")
         {
@@ -413,13 +761,14 @@ namespace MITSU_Domoe
             {
                 error.error_message = "Could not parse error message from log.";
             }
-            result_repo_->store_result(log.id(), std::move(error));
             spdlog::info("Successfully loaded error result for command ID {} from log.", log.id());
+            return std::make_pair(log.id(), CommandResult(std::move(error)));
         }
         else
         {
             spdlog::warn("Log for command ID {} could not be loaded. A 'success' status requires a 'schema' field, which was not found. This may be an old log file format.", log.id());
         }
+        return std::nullopt;
     }
 
 } // namespace MITSU_Domoe
@@ -8,11 +8,37 @@
 #include <rfl/json.hpp>
 
 #include "ReadStlCartridge.hpp"
+#include "ReadObjCartridge.hpp"
+#include "ReadPlyCartridge.hpp"
+#include "WriteStlCartridge.hpp"
+#include "WritePlyCartridge.hpp"
+#include "BuildBvhCartridge.hpp"
+#include "BvhNearestCartridge.hpp"
+#include "BvhRaycastCartridge.hpp"
+#include "BvhOverlapCartridge.hpp"
+#include "BuildKdTreeCartridge.hpp"
+#include "KnnSearchCartridge.hpp"
+#include "RadiusSearchCartridge.hpp"
+#include "ClusterFacesKMeansCartridge.hpp"
+#include "ClusterFacesByNormalCartridge.hpp"
+#include "PartitionMeshCartridge.hpp"
+#include "DecimateMeshCartridge.hpp"
+#include "ComputeNormalsCartridge.hpp"
+#include "SampleSurfaceCartridge.hpp"
+#include "VoxelizeMeshCartridge.hpp"
+#include "MeshStatisticsCartridge.hpp"
+#include "CleanMeshCartridge.hpp"
+#include "TransformMeshCartridge.hpp"
+#include "MergeMeshesCartridge.hpp"
 #include "GenerateCentroidsCartridge_mock.hpp"
 #include "GenerateCentroidsCartridge.hpp"
 #include "BIGprocess_mock_cartridge.hpp"
 #include "Need_many_arg_mock_cartridge.hpp"
 #include "SubdividePolygonCartridge.hpp"
+#include "OpenMeshStreamCartridge.hpp"
+#include "StreamBoundingBoxCartridge.hpp"
+#include "StreamCentroidsCartridge.hpp"
+#include "StreamStatisticsCartridge.hpp"
 
 namespace
 {
@@ -42,11 +68,37 @@ namespace MITSU_Domoe
 ConsoleClient::ConsoleClient(const std::filesystem::path& log_path) : BaseClient(log_path)
 {
     processor->register_cartridge(ReadStlCartridge{});
+    processor->register_cartridge(ReadObjCartridge{});
+    processor->register_cartridge(ReadPlyCartridge{});
+    processor->register_cartridge(WriteStlCartridge{});
+    processor->register_cartridge(WritePlyCartridge{});
+    processor->register_cartridge(BuildBvhCartridge{});
+    processor->register_cartridge(BvhNearestCartridge{});
+    processor->register_cartridge(BvhRaycastCartridge{});
+    processor->register_cartridge(BvhOverlapCartridge{});
+    processor->register_cartridge(BuildKdTreeCartridge{});
+    processor->register_cartridge(KnnSearchCartridge{});
+    processor->register_cartridge(RadiusSearchCartridge{});
+    processor->register_cartridge(ClusterFacesKMeansCartridge{});
+    processor->register_cartridge(ClusterFacesByNormalCartridge{});
+    processor->register_cartridge(PartitionMeshCartridge{});
+    processor->register_cartridge(DecimateMeshCartridge{});
+    processor->register_cartridge(ComputeNormalsCartridge{});
+    processor->register_cartridge(SampleSurfaceCartridge{});
+    processor->register_cartridge(VoxelizeMeshCartridge{});
+    processor->register_cartridge(MeshStatisticsCartridge{});
+    processor->register_cartridge(CleanMeshCartridge{});
+    processor->register_cartridge(TransformMeshCartridge{});
+    processor->register_cartridge(MergeMeshesCartridge{});
     processor->register_cartridge(GenerateCentroidsCartridge_mock{});
     processor->register_cartridge(GenerateCentroidsCartridge{});
     processor->register_cartridge(BIGprocess_mock_cartridge{});
     processor->register_cartridge(Need_many_arg_mock_cartridge{});
     processor->register_cartridge(SubdividePolygonCartridge{});
+    processor->register_cartridge(OpenMeshStreamCartridge{});
+    processor->register_cartridge(StreamBoundingBoxCartridge{});
+    processor->register_cartridge(StreamCentroidsCartridge{});
+    processor->register_cartridge(StreamStatisticsCartridge{});
 }
 
 void ConsoleClient::run()
@@ -82,12 +134,29 @@ void ConsoleClient::run()
                 handle_load(path);
             }
         } else if (command == "trace") {
+            std::string path;
+            std::string mode;
+            ss >> path >> mode;
+            if (path.empty() || !(mode.empty() || mode == "incremental")) {
+                spdlog::error("Usage: trace <file_or_directory_path> [incremental]");
+            } else {
+                handle_trace(path, mode == "incremental");
+            }
+        } else if (command == "save") {
             std::string path;
             ss >> path;
             if (path.empty()) {
-                spdlog::error("Usage: trace <file_or_directory_path>");
+                spdlog::error("Usage: save <snapshot_path>");
             } else {
-                handle_trace(path);
+                save_snapshot(path);
+            }
+        } else if (command == "restore") {
+            std::string path;
+            ss >> path;
+            if (path.empty()) {
+                spdlog::error("Usage: restore <snapshot_path>");
+            } else {
+                restore_snapshot(path);
             }
         } else if (command.empty()) {
             // do nothing
@@ -104,7 +173,11 @@ void ConsoleClient::print_help() {
     std::cout << "--- MITSUDomoe Help ---\n"
               << "Available commands:\n"
               << "  load <path>      - Loads and displays a JSON log file or all logs in a directory.\n"
-              << "  trace <path>     - Re-runs the command from a JSON log file or all logs in a directory.\n"
+              << "  trace <path> [incremental]\n"
+              << "                   - Re-runs the command from a JSON log file or all logs in a directory.\n"
+              << "                     'incremental' reuses results whose resolved input is unchanged.\n"
+              << "  save <path>      - Saves all results and the command ID counter to a binary snapshot.\n"
+              << "  restore <path>   - Restores results from a snapshot written by 'save'.\n"
               << "  run_tests        - Runs the original hardcoded test suite.\n"
               << "  help             - Displays this help message.\n"
               << "  exit             - Exits the application.\n"
@@ -166,107 +239,16 @@ void ConsoleClient::run_tests() {
 }
 
 void ConsoleClient::handle_load(const std::string& path_str) {
-    const std::filesystem::path path(path_str);
-
-    auto process_file = [this](const std::filesystem::path& file_path) {
-        if (file_path.extension() != ".json") {
-            return;
-        }
-        spdlog::info("Loading log: {}", file_path.string());
-        std::ifstream ifs(file_path);
-        if (!ifs) {
-            spdlog::error("Failed to open file: {}", file_path.string());
-            return;
-        }
-        const std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-
-        // Store the result from the log in the repository
-        this->load_result(content);
-
-        // Pretty-print the JSON
-        try {
-            auto parsed = rfl::json::read<rfl::Generic>(content);
-            if (!parsed) {
-                throw std::runtime_error(parsed.error().what());
-            }
-            const auto pretty_json = rfl::json::write(*parsed, YYJSON_WRITE_PRETTY);
-            std::cout << "--- " << file_path.filename().string() << " ---\n"
-                      << pretty_json << "\n"
-                      << "--------------------" << std::endl;
-        } catch (const std::exception& e) {
-            spdlog::error("Failed to parse or print JSON from {}: {}", file_path.string(), e.what());
-        }
-    };
-
-    if (std::filesystem::is_directory(path)) {
-        for (const auto& entry : std::filesystem::directory_iterator(path)) {
-            if (entry.is_regular_file()) {
-                process_file(entry.path());
-            }
-        }
-    } else if (std::filesystem::is_regular_file(path)) {
-        process_file(path);
-    } else {
-        spdlog::error("Path is not a valid file or directory: {}", path_str);
+    for (const auto& log : load_logs(path_str)) {
+        std::cout << "--- " << log.path.filename().string() << " ---\n"
+                  << log.pretty_json << "\n"
+                  << "--------------------" << std::endl;
     }
 }
 
-void ConsoleClient::handle_trace(const std::string& path_str) {
-    const std::filesystem::path path(path_str);
-
-    auto process_file = [this](const std::filesystem::path& file_path) {
-        if (file_path.extension() != ".json") {
-            return;
-        }
-        spdlog::info("Tracing log: {}", file_path.string());
-        std::ifstream ifs(file_path);
-        if (!ifs) {
-            spdlog::error("Failed to open file: {}", file_path.string());
-            return;
-        }
-        const std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-
-        try {
-            // Define a struct to parse the relevant fields from the log file
-            struct Log {
-                rfl::Field<"command", std::string> command;
-                rfl::Field<"request", rfl::Generic> request;
-            };
-
-            auto parsed = rfl::json::read<Log>(content);
-            if (!parsed) {
-                throw std::runtime_error(parsed.error().what());
-            }
-
-            const std::string& command_name = parsed->command();
-            const std::string request_json = rfl::json::write(parsed->request());
-
-            spdlog::info("Re-posting command '{}' with input: {}", command_name, request_json);
-            this->post_command(command_name, request_json);
-
-        } catch (const std::exception& e) {
-            spdlog::error("Failed to parse or trace JSON from {}: {}", file_path.string(), e.what());
-        }
-    };
-
-    if (std::filesystem::is_directory(path)) {
-        // When tracing a directory, it's important to process files in order.
-        // The log files are named with a zero-padded ID, so lexicographical sort is correct.
-        std::vector<std::filesystem::path> files;
-        for (const auto& entry : std::filesystem::directory_iterator(path)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                files.push_back(entry.path());
-            }
-        }
-        std::sort(files.begin(), files.end());
-        for (const auto& file_path : files) {
-            process_file(file_path);
-        }
-    } else if (std::filesystem::is_regular_file(path)) {
-        process_file(path);
-    } else {
-        spdlog::error("Path is not a valid file or directory: {}", path_str);
-    }
+void ConsoleClient::handle_trace(const std::string& path_str, bool reuse_cached) {
+    const TraceReport report = trace_logs(path_str, nullptr, reuse_cached);
+    std::cout << report.to_string() << std::endl;
 }
 
 
@@ -16,6 +16,28 @@
 
 // All cartridges used in the app
 #include "ReadStlCartridge.hpp"
+#include "ReadObjCartridge.hpp"
+#include "ReadPlyCartridge.hpp"
+#include "WriteStlCartridge.hpp"
+#include "WritePlyCartridge.hpp"
+#include "BuildBvhCartridge.hpp"
+#include "BvhNearestCartridge.hpp"
+#include "BvhRaycastCartridge.hpp"
+#include "BvhOverlapCartridge.hpp"
+#include "BuildKdTreeCartridge.hpp"
+#include "KnnSearchCartridge.hpp"
+#include "RadiusSearchCartridge.hpp"
+#include "ClusterFacesKMeansCartridge.hpp"
+#include "ClusterFacesByNormalCartridge.hpp"
+#include "PartitionMeshCartridge.hpp"
+#include "DecimateMeshCartridge.hpp"
+#include "ComputeNormalsCartridge.hpp"
+#include "SampleSurfaceCartridge.hpp"
+#include "VoxelizeMeshCartridge.hpp"
+#include "MeshStatisticsCartridge.hpp"
+#include "CleanMeshCartridge.hpp"
+#include "TransformMeshCartridge.hpp"
+#include "MergeMeshesCartridge.hpp"
 #include "GenerateCentroidsCartridge_mock.hpp"
 #include "GenerateCentroidsCartridge.hpp"
 #include "BIGprocess_mock_cartridge.hpp"
@@ -23,6 +45,12 @@
 #include "CutMeshCartridge.hpp"
 #include "SubdividePolygonCartridge.hpp"
 #include "LoadJsonCartridge.hpp"
+#include "OpenMeshStreamCartridge.hpp"
+#include "StreamBoundingBoxCartridge.hpp"
+#include "StreamCentroidsCartridge.hpp"
+#include "StreamStatisticsCartridge.hpp"
+
+#include "MITSUDomoe/SessionSnapshot.hpp"
 
 #include <rfl.hpp>
 #include <rfl_eigen_serdes.hpp>
@@ -128,6 +156,28 @@ namespace MITSU_Domoe
     GuiClient::GuiClient(const std::filesystem::path &log_path) : BaseClient(log_path)
     {
         processor->register_cartridge(ReadStlCartridge{});
+        processor->register_cartridge(ReadObjCartridge{});
+        processor->register_cartridge(ReadPlyCartridge{});
+        processor->register_cartridge(WriteStlCartridge{});
+        processor->register_cartridge(WritePlyCartridge{});
+        processor->register_cartridge(BuildBvhCartridge{});
+        processor->register_cartridge(BvhNearestCartridge{});
+        processor->register_cartridge(BvhRaycastCartridge{});
+        processor->register_cartridge(BvhOverlapCartridge{});
+        processor->register_cartridge(BuildKdTreeCartridge{});
+        processor->register_cartridge(KnnSearchCartridge{});
+        processor->register_cartridge(RadiusSearchCartridge{});
+        processor->register_cartridge(ClusterFacesKMeansCartridge{});
+        processor->register_cartridge(ClusterFacesByNormalCartridge{});
+        processor->register_cartridge(PartitionMeshCartridge{});
+        processor->register_cartridge(DecimateMeshCartridge{});
+        processor->register_cartridge(ComputeNormalsCartridge{});
+        processor->register_cartridge(SampleSurfaceCartridge{});
+        processor->register_cartridge(VoxelizeMeshCartridge{});
+        processor->register_cartridge(MeshStatisticsCartridge{});
+        processor->register_cartridge(CleanMeshCartridge{});
+        processor->register_cartridge(TransformMeshCartridge{});
+        processor->register_cartridge(MergeMeshesCartridge{});
         processor->register_cartridge(GenerateCentroidsCartridge_mock{});
         processor->register_cartridge(GenerateCentroidsCartridge{});
         processor->register_cartridge(BIGprocess_mock_cartridge{});
@@ -135,10 +185,25 @@ namespace MITSU_Domoe
         processor->register_cartridge(CutMeshCartridge{});
         processor->register_cartridge(SubdividePolygonCartridge{});
         processor->register_cartridge(LoadJsonCartridge{});
+        processor->register_cartridge(OpenMeshStreamCartridge{});
+        processor->register_cartridge(StreamBoundingBoxCartridge{});
+        processor->register_cartridge(StreamCentroidsCartridge{});
+        processor->register_cartridge(StreamStatisticsCartridge{});
     }
 
     void GuiClient::process_mesh_results()
     {
+        {
+            std::lock_guard<std::mutex> lock(restored_render_states_mutex);
+            if (reset_render_states)
+            {
+                reset_render_states = false;
+                mesh_render_states.clear();
+                saved_render_states = std::move(restored_render_states);
+                restored_render_states.clear();
+            }
+        }
+
         auto results = get_all_results();
         for (const auto &pair : results)
         {
@@ -181,18 +246,37 @@ namespace MITSU_Domoe
                         if (mesh_obj)
                         {
                             const auto &mesh = *mesh_obj;
-                            Eigen::Vector3d min_bound = mesh.V.colwise().minCoeff();
-                            Eigen::Vector3d max_bound = mesh.V.colwise().maxCoeff();
+                            MITSU_Domoe::MeshDerivedData derived(mesh);
+                            const auto bounds = derived.bounding_box();
+                            Eigen::Vector3d min_bound = bounds->row(0).transpose();
+                            Eigen::Vector3d max_bound = bounds->row(1).transpose();
                             Eigen::Vector3d center = (min_bound + max_bound) / 2.0;
                             double radius = (max_bound - min_bound).norm() / 2.0;
 
                             MeshRenderState state;
-                            state.renderer = std::make_unique<Renderer>(mesh);
+                            state.renderer = std::make_unique<Renderer>(mesh, derived);
                             state.camera_target = center.cast<float>();
                             state.distance = radius * 2.5f;
                             state.near_clip = 0.01f * radius;
                             state.far_clip = 1000.0f * radius;
 
+                            if (auto it = saved_render_states.find(mesh_key); it != saved_render_states.end())
+                            {
+                                const auto &saved = it->second;
+                                state.is_visible = saved.is_visible;
+                                state.selected_shader_name = saved.selected_shader_name;
+                                if (saved.camera_target.size() == 3)
+                                {
+                                    state.camera_target = Eigen::Vector3f(saved.camera_target[0], saved.camera_target[1], saved.camera_target[2]);
+                                }
+                                state.distance = saved.distance;
+                                state.yaw = saved.yaw;
+                                state.pitch = saved.pitch;
+                                state.near_clip = saved.near_clip;
+                                state.far_clip = saved.far_clip;
+                                saved_render_states.erase(it);
+                            }
+
                             mesh_render_states[mesh_key] = std::move(state);
                         }
                     }
@@ -284,6 +368,7 @@ namespace MITSU_Domoe
         {
             glfwPollEvents();
 
+            poll_log_job();
             process_mesh_results();
 
             ImGui_ImplOpenGL3_NewFrame();
@@ -319,13 +404,18 @@ namespace MITSU_Domoe
                         bool first = true;
                         for (const auto &pair : arg_inputs)
                         {
-                            if (!first)
-                                json_stream << ",";
-
                             const std::string &arg_name = pair.first;
                             const char *arg_value = pair.second.data();
                             const std::string &arg_type = current_schema[arg_name];
 
+                            // Optional arguments left blank are omitted so the cartridge sees them as unset.
+                            if (strlen(arg_value) == 0 && arg_type.find("optional") != std::string::npos)
+                            {
+                                continue;
+                            }
+                            if (!first)
+                                json_stream << ",";
+
                             json_stream << "\"" << arg_name << "\":";
 
                             if (arg_type.find("string") != std::string::npos || arg_type.find("path") != std::string::npos)
@@ -360,6 +450,8 @@ namespace MITSU_Domoe
                 ImGui::Separator();
                 ImGui::Text("Log Playback");
                 ImGui::InputText("Log Path", log_path_buffer, sizeof(log_path_buffer));
+                const bool log_job_running = is_log_job_running();
+                ImGui::BeginDisabled(log_job_running);
                 if (ImGui::Button("Load Log"))
                 {
                     handle_load(log_path_buffer);
@@ -374,6 +466,29 @@ namespace MITSU_Domoe
                 {
                     handle_trace_history(log_path_buffer);
                 }
+                ImGui::EndDisabled();
+                ImGui::Checkbox("Reuse cached results", &trace_reuse_cached);
+
+                if (log_job_running)
+                {
+                    const size_t total = log_job_progress->total;
+                    const size_t completed = log_job_progress->completed;
+                    const float fraction = total > 0 ? static_cast<float>(completed) / static_cast<float>(total) : 0.0f;
+                    const std::string overlay = log_job_label + " " + std::to_string(completed) + "/" + std::to_string(total);
+                    ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), overlay.c_str());
+                }
+
+                ImGui::BeginDisabled(log_job_running);
+                if (ImGui::Button("Save Snapshot"))
+                {
+                    handle_save_snapshot(log_path_buffer);
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Restore Snapshot"))
+                {
+                    handle_restore_snapshot(log_path_buffer);
+                }
+                ImGui::EndDisabled();
 
                 if (!loaded_log_content.empty())
                 {
@@ -626,202 +741,147 @@ namespace MITSU_Domoe
         glfwTerminate();
     }
 
-    void GuiClient::handle_load(const std::string &path_str)
+    void GuiClient::start_log_job(const std::string &label, std::function<std::string(LogLoadProgress &)> job)
     {
-        const std::filesystem::path path(path_str);
-        loaded_log_content.clear();
-
-        auto process_file = [this](const std::filesystem::path &file_path)
+        if (is_log_job_running())
         {
-            if (file_path.extension() != ".json")
-            {
-                return;
-            }
-            spdlog::info("GUI: Loading log: {}", file_path.string());
-            std::ifstream ifs(file_path);
-            if (!ifs)
-            {
-                spdlog::error("Failed to open file: {}", file_path.string());
-                return;
-            }
-            const std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-
-            // Store the result from the log in the repository
-            this->load_result(content);
+            spdlog::warn("GUI: A log job is already running.");
+            return;
+        }
+        log_job_label = label;
+        log_job_progress = std::make_shared<LogLoadProgress>();
+        log_job = std::async(std::launch::async, [job = std::move(job), progress = log_job_progress]
+                             { return job(*progress); });
+    }
 
+    void GuiClient::poll_log_job()
+    {
+        if (log_job.valid() && log_job.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
             try
             {
-                auto parsed = rfl::json::read<rfl::Generic>(content);
-                if (!parsed)
-                {
-                    throw std::runtime_error(parsed.error().what());
-                }
-                const auto pretty_json = rfl::json::write(*parsed, YYJSON_WRITE_PRETTY);
-                loaded_log_content += "--- " + file_path.filename().string() + " ---\n";
-                loaded_log_content += pretty_json;
-                loaded_log_content += "\n\n";
+                loaded_log_content += log_job.get();
             }
             catch (const std::exception &e)
             {
-                spdlog::error("Failed to parse or print JSON from {}: {}", file_path.string(), e.what());
-            }
-        };
-
-        if (std::filesystem::is_directory(path))
-        {
-            for (const auto &entry : std::filesystem::directory_iterator(path))
-            {
-                if (entry.is_regular_file())
-                {
-                    process_file(entry.path());
-                }
+                spdlog::error("GUI: {} failed: {}", log_job_label, e.what());
             }
         }
-        else if (std::filesystem::is_regular_file(path))
-        {
-            process_file(path);
-        }
-        else
-        {
-            spdlog::error("Path is not a valid file or directory: {}", path_str);
-        }
     }
 
-    void GuiClient::handle_trace(const std::string &path_str)
+    bool GuiClient::is_log_job_running() const
     {
-        const std::filesystem::path path(path_str);
-
-        auto process_file = [this](const std::filesystem::path &file_path)
-        {
-            if (file_path.extension() != ".json")
-            {
-                return;
-            }
-            spdlog::info("GUI: Tracing log: {}", file_path.string());
-            std::ifstream ifs(file_path);
-            if (!ifs)
-            {
-                spdlog::error("Failed to open file: {}", file_path.string());
-                return;
-            }
-            const std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-
-            try
-            {
-                struct Log
-                {
-                    rfl::Field<"command", std::string> command;
-                    rfl::Field<"request", rfl::Generic> request;
-                };
-
-                auto parsed = rfl::json::read<Log>(content);
-                if (!parsed)
-                {
-                    throw std::runtime_error(parsed.error().what());
-                }
+        return log_job.valid();
+    }
 
-                const std::string &command_name = parsed->command();
-                const std::string request_json = rfl::json::write(parsed->request());
+    void GuiClient::handle_load(const std::string &path_str)
+    {
+        loaded_log_content.clear();
+        spdlog::info("GUI: Loading log: {}", path_str);
 
-                spdlog::info("GUI: Re-posting command '{}' with input: {}", command_name, request_json);
-                this->post_command(command_name, request_json);
-            }
-            catch (const std::exception &e)
+        start_log_job("Loading", [this, path = std::filesystem::path(path_str)](LogLoadProgress &progress)
+                      {
+            std::string content;
+            for (const auto &log : load_logs(path, &progress))
             {
-                spdlog::error("Failed to parse or trace JSON from {}: {}", file_path.string(), e.what());
+                content += "--- " + log.path.filename().string() + " ---\n";
+                content += log.pretty_json;
+                content += "\n\n";
             }
-        };
+            return content; });
+    }
 
-        if (std::filesystem::is_directory(path))
-        {
-            std::vector<std::filesystem::path> files;
-            for (const auto &entry : std::filesystem::directory_iterator(path))
-            {
-                if (entry.is_regular_file() && entry.path().extension() == ".json")
-                {
-                    files.push_back(entry.path());
-                }
-            }
-            std::sort(files.begin(), files.end());
-            for (const auto &file_path : files)
-            {
-                process_file(file_path);
-            }
-        }
-        else if (std::filesystem::is_regular_file(path))
-        {
-            process_file(path);
-        }
-        else
-        {
-            spdlog::error("Path is not a valid file or directory: {}", path_str);
-        }
+    void GuiClient::handle_trace(const std::string &path_str)
+    {
+        spdlog::info("GUI: Tracing log: {}", path_str);
+
+        start_log_job("Tracing", [this, path = std::filesystem::path(path_str), reuse_cached = trace_reuse_cached](LogLoadProgress &progress)
+                      {
+            return trace_logs(path, &progress, reuse_cached).to_string() + "\n\n"; });
     }
 
     void GuiClient::handle_trace_history(const std::string &path_str)
     {
         const std::filesystem::path path(path_str);
-
-        auto process_file = [this](const std::filesystem::path &file_path)
+        if (!std::filesystem::is_directory(path))
         {
-            if (file_path.extension() != ".json")
-            {
-                return;
-            }
-            spdlog::info("GUI: Tracing command history log: {}", file_path.string());
-            std::ifstream ifs(file_path);
-            if (!ifs)
-            {
-                spdlog::error("Failed to open file: {}", file_path.string());
-                return;
-            }
-            const std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-
-            try
-            {
-                struct Log
-                {
-                    rfl::Field<"command", std::string> command;
-                    rfl::Field<"request", rfl::Generic> request;
-                };
+            spdlog::error("Path is not a valid directory for tracing history: {}", path_str);
+            return;
+        }
+        spdlog::info("GUI: Tracing command history log: {}", path_str);
 
-                auto parsed = rfl::json::read<Log>(content);
-                if (!parsed)
-                {
-                    throw std::runtime_error(parsed.error().what());
-                }
+        start_log_job("Tracing history", [this, path, reuse_cached = trace_reuse_cached](LogLoadProgress &progress)
+                      {
+            return trace_logs(path, &progress, reuse_cached).to_string() + "\n\n"; });
+    }
 
-                const std::string &command_name = parsed->command();
-                const std::string request_json = rfl::json::write(parsed->request());
+    void GuiClient::handle_save_snapshot(const std::string &path_str)
+    {
+        // Render state is captured here on the render thread; only the file write runs in the background.
+        auto attachments = get_snapshot_attachments();
+        start_log_job("Saving snapshot", [this, path = std::filesystem::path(path_str), attachments = std::move(attachments)](LogLoadProgress &)
+                      {
+            write_session_snapshot(path, *result_repo, processor->get_next_command_id(), attachments);
+            return std::string(); });
+    }
 
-                spdlog::info("GUI: Re-posting command '{}' from history with input: {}", command_name, request_json);
-                this->post_command(command_name, request_json);
-            }
-            catch (const std::exception &e)
+    void GuiClient::handle_restore_snapshot(const std::string &path_str)
+    {
+        start_log_job("Restoring snapshot", [this, path = std::filesystem::path(path_str)](LogLoadProgress &)
+                      {
+            // The restored results may replace ones on screen, so every render state is rebuilt. The
+            // saved states are published only together with the reset, so that the render thread
+            // cannot apply them to a mesh it is about to discard.
+            if (restore_snapshot(path))
             {
-                spdlog::error("Failed to parse or trace JSON from {}: {}", file_path.string(), e.what());
+                std::lock_guard<std::mutex> lock(restored_render_states_mutex);
+                restored_render_states = std::move(snapshot_render_states);
+                snapshot_render_states.clear();
+                reset_render_states = true;
             }
-        };
+            return std::string(); });
+    }
 
-        if (std::filesystem::is_directory(path))
+    std::map<std::string, std::string> GuiClient::get_snapshot_attachments()
+    {
+        std::vector<SavedRenderState> saved_states;
+        for (const auto &[mesh_key, state] : mesh_render_states)
         {
-            std::vector<std::filesystem::path> files;
-            for (const auto &entry : std::filesystem::directory_iterator(path))
-            {
-                if (entry.is_regular_file() && entry.path().extension() == ".json")
-                {
-                    files.push_back(entry.path());
-                }
-            }
-            std::sort(files.begin(), files.end());
-            for (const auto &file_path : files)
-            {
-                process_file(file_path);
-            }
+            saved_states.push_back(SavedRenderState{
+                .result_id = mesh_key.first,
+                .output_name = mesh_key.second,
+                .is_visible = state.is_visible,
+                .selected_shader_name = state.selected_shader_name,
+                .camera_target = {state.camera_target.x(), state.camera_target.y(), state.camera_target.z()},
+                .distance = state.distance,
+                .yaw = state.yaw,
+                .pitch = state.pitch,
+                .near_clip = state.near_clip,
+                .far_clip = state.far_clip});
         }
-        else
+        return {{"gui_render_states", rfl::json::write(saved_states)}};
+    }
+
+    void GuiClient::restore_snapshot_attachments(const std::map<std::string, std::string> &attachments)
+    {
+        auto it = attachments.find("gui_render_states");
+        if (it == attachments.end())
         {
-            spdlog::error("Path is not a valid directory for tracing history: {}", path_str);
+            return;
+        }
+        auto saved_states = rfl::json::read<std::vector<SavedRenderState>>(it->second);
+        if (!saved_states)
+        {
+            spdlog::error("GUI: Failed to parse render state from snapshot: {}", saved_states.error().what());
+            return;
+        }
+
+        // Held back until handle_restore_snapshot publishes them with the reset.
+        snapshot_render_states.clear();
+        for (auto &saved : *saved_states)
+        {
+            auto mesh_key = std::make_pair(saved.result_id, saved.output_name);
+            snapshot_render_states[mesh_key] = std::move(saved);
         }
     }
 }
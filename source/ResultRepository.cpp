@@ -6,11 +6,14 @@ namespace MITSU_Domoe
 {
 
     // (中身は前回と同じ)
-    void ResultRepository::store_result(uint64_t id, CommandResult result)
+    void ResultRepository::log_stored_result(uint64_t id, const CommandResult &result)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
         if (const auto *success = std::get_if<SuccessResult>(&result))
         {
+            if (!spdlog::should_log(spdlog::level::info))
+            {
+                return;
+            }
             const size_t max_display_length = 512;
             std::string result_str_for_display; // 表示用の文字列を準備
 
@@ -33,7 +36,25 @@ namespace MITSU_Domoe
         {
             spdlog::error("Storing error result for command ID {}: {}", id, error->error_message);
         }
+    }
+
+    void ResultRepository::store_result(uint64_t id, CommandResult result)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        log_stored_result(id, result);
         results_[id] = std::move(result);
+        store_log_.push_back(id);
+    }
+
+    void ResultRepository::store_results(std::vector<std::pair<uint64_t, CommandResult>> results)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &[id, result] : results)
+        {
+            log_stored_result(id, result);
+            results_[id] = std::move(result);
+            store_log_.push_back(id);
+        }
     }
 
     std::optional<CommandResult> ResultRepository::get_result(uint64_t id)
@@ -58,6 +79,29 @@ namespace MITSU_Domoe
         return results_;
     }
 
+    void ResultRepository::visit_results(const std::function<void(uint64_t, const CommandResult &)> &visitor) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &[id, result] : results_)
+        {
+            visitor(id, result);
+        }
+    }
+
+    size_t ResultRepository::visit_results_since(size_t position, const std::function<void(uint64_t, const CommandResult &)> &visitor) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = position; i < store_log_.size(); ++i)
+        {
+            // Removed results leave their entries in the log behind.
+            if (auto it = results_.find(store_log_[i]); it != results_.end())
+            {
+                visitor(it->first, it->second);
+            }
+        }
+        return store_log_.size();
+    }
+
     std::optional<uint64_t> ResultRepository::get_latest_result_id(uint64_t command_id_to_ignore) const
     {
         std::lock_guard<std::mutex> lock(mutex_);
@@ -0,0 +1,303 @@
+#include <MITSUDomoe/SessionSnapshot.hpp>
+#include <MITSUDomoe/MappedFile.hpp>
+#include <MITSUDomoe/ThreadPool.hpp>
+#include <spdlog/spdlog.h>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace MITSU_Domoe
+{
+    namespace
+    {
+        constexpr char SNAPSHOT_MAGIC[8] = {'M', 'I', 'T', 'S', 'U', 'S', 'N', 'P'};
+        constexpr uint32_t SNAPSHOT_VERSION = 1;
+        constexpr uint8_t RECORD_SUCCESS = 0;
+        constexpr uint8_t RECORD_ERROR = 1;
+
+        struct SnapshotHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+            uint64_t next_command_id;
+            uint64_t result_count;
+            uint64_t attachment_count;
+            uint64_t attachments_offset;
+            uint64_t index_offset;
+        };
+
+        class SnapshotWriter
+        {
+        public:
+            explicit SnapshotWriter(const std::filesystem::path &path)
+                : buffer_(1 << 20)
+            {
+                out_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+                out_.open(path, std::ios::binary | std::ios::trunc);
+                if (!out_)
+                {
+                    throw std::runtime_error("Failed to open snapshot file for writing: " + path.string());
+                }
+            }
+
+            void write_bytes(const void *data, size_t size)
+            {
+                out_.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+                offset_ += size;
+            }
+
+            template <typename T>
+            void write_pod(const T &value)
+            {
+                write_bytes(&value, sizeof(T));
+            }
+
+            void write_string(const std::string &s)
+            {
+                write_pod<uint64_t>(s.size());
+                write_bytes(s.data(), s.size());
+            }
+
+            void patch_header(const SnapshotHeader &header)
+            {
+                out_.seekp(0);
+                out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            }
+
+            void close()
+            {
+                out_.close();
+                if (!out_)
+                {
+                    throw std::runtime_error("Failed to finish writing snapshot file.");
+                }
+            }
+
+            uint64_t offset() const { return offset_; }
+
+        private:
+            std::vector<char> buffer_;
+            std::ofstream out_;
+            uint64_t offset_ = 0;
+        };
+
+        // Bounds-checked cursor over the mapped file.
+        class SnapshotReader
+        {
+        public:
+            SnapshotReader(const char *data, size_t size, size_t offset)
+                : data_(data), size_(size), offset_(offset) {}
+
+            template <typename T>
+            T read_pod()
+            {
+                require(sizeof(T));
+                T value;
+                std::memcpy(&value, data_ + offset_, sizeof(T));
+                offset_ += sizeof(T);
+                return value;
+            }
+
+            std::string read_string()
+            {
+                const uint64_t length = read_pod<uint64_t>();
+                require(length);
+                std::string s(data_ + offset_, length);
+                offset_ += length;
+                return s;
+            }
+
+            size_t offset() const { return offset_; }
+
+        private:
+            void require(uint64_t n) const
+            {
+                if (offset_ > size_ || n > size_ - offset_)
+                {
+                    throw std::runtime_error("Snapshot file is truncated or corrupted.");
+                }
+            }
+
+            const char *data_;
+            size_t size_;
+            size_t offset_;
+        };
+
+        void write_record(SnapshotWriter &writer, uint64_t id, const CommandResult &result)
+        {
+            writer.write_pod<uint64_t>(id);
+            if (const auto *success = std::get_if<SuccessResult>(&result))
+            {
+                writer.write_pod<uint8_t>(RECORD_SUCCESS);
+                writer.write_string(success->command_name);
+                writer.write_string(success->input_json_ref_solved);
+                writer.write_string(success->input_json_original);
+                writer.write_string(success->unresolved_input_json);
+                writer.write_string(success->resolved_input_json);
+                writer.write_string(success->output_json);
+                writer.write_pod<uint64_t>(success->output_schema.size());
+                for (const auto &[name, type] : success->output_schema)
+                {
+                    writer.write_string(name);
+                    writer.write_string(type);
+                }
+            }
+            else
+            {
+                writer.write_pod<uint8_t>(RECORD_ERROR);
+                writer.write_string(std::get<ErrorResult>(result).error_message);
+            }
+        }
+
+        // The fields write_record serializes, without input_raw and output_raw, which may hold whole
+        // meshes and are not written anyway.
+        CommandResult serialized_fields(const CommandResult &result)
+        {
+            if (const auto *success = std::get_if<SuccessResult>(&result))
+            {
+                SuccessResult copy;
+                copy.command_name = success->command_name;
+                copy.input_json_ref_solved = success->input_json_ref_solved;
+                copy.input_json_original = success->input_json_original;
+                copy.output_json = success->output_json;
+                copy.output_schema = success->output_schema;
+                copy.unresolved_input_json = success->unresolved_input_json;
+                copy.resolved_input_json = success->resolved_input_json;
+                return copy;
+            }
+            return result;
+        }
+
+        std::pair<uint64_t, CommandResult> read_record(SnapshotReader &reader)
+        {
+            const uint64_t id = reader.read_pod<uint64_t>();
+            const uint8_t kind = reader.read_pod<uint8_t>();
+            if (kind == RECORD_SUCCESS)
+            {
+                // input_raw and output_raw are left empty, as with results loaded from logs.
+                SuccessResult success;
+                success.command_name = reader.read_string();
+                success.input_json_ref_solved = reader.read_string();
+                success.input_json_original = reader.read_string();
+                success.unresolved_input_json = reader.read_string();
+                success.resolved_input_json = reader.read_string();
+                success.output_json = reader.read_string();
+                const uint64_t schema_size = reader.read_pod<uint64_t>();
+                for (uint64_t i = 0; i < schema_size; ++i)
+                {
+                    std::string name = reader.read_string();
+                    success.output_schema[std::move(name)] = reader.read_string();
+                }
+                return {id, std::move(success)};
+            }
+            if (kind == RECORD_ERROR)
+            {
+                return {id, ErrorResult{reader.read_string()}};
+            }
+            throw std::runtime_error("Unknown record kind in snapshot: " + std::to_string(kind));
+        }
+    }
+
+    bool write_session_snapshot(const std::filesystem::path &path, const ResultRepository &repo,
+                                uint64_t next_command_id, const std::map<std::string, std::string> &attachments)
+    {
+        try
+        {
+            SnapshotWriter writer(path);
+
+            SnapshotHeader header{};
+            std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+            header.version = SNAPSHOT_VERSION;
+            header.next_command_id = next_command_id;
+            header.attachment_count = attachments.size();
+            writer.write_pod(header);
+
+            // Copied so that commands storing results are not blocked behind the disk write.
+            std::vector<std::pair<uint64_t, CommandResult>> results;
+            repo.visit_results([&](uint64_t id, const CommandResult &result)
+                               { results.emplace_back(id, serialized_fields(result)); });
+            std::vector<uint64_t> index;
+            index.reserve(results.size());
+            for (const auto &[id, result] : results)
+            {
+                index.push_back(writer.offset());
+                write_record(writer, id, result);
+            }
+
+            header.attachments_offset = writer.offset();
+            for (const auto &[name, content] : attachments)
+            {
+                writer.write_string(name);
+                writer.write_string(content);
+            }
+
+            header.result_count = index.size();
+            header.index_offset = writer.offset();
+            writer.write_bytes(index.data(), index.size() * sizeof(uint64_t));
+            writer.patch_header(header);
+            writer.close();
+
+            spdlog::info("Wrote session snapshot with {} results to {}", index.size(), path.string());
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            spdlog::error("Failed to write session snapshot {}: {}", path.string(), e.what());
+            return false;
+        }
+    }
+
+    std::optional<SessionSnapshot> read_session_snapshot(const std::filesystem::path &path)
+    {
+        try
+        {
+            const MappedFile file(path);
+            SnapshotReader header_reader(file.data(), file.size(), 0);
+            const auto header = header_reader.read_pod<SnapshotHeader>();
+            if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+            {
+                throw std::runtime_error("Not a session snapshot file.");
+            }
+            if (header.version != SNAPSHOT_VERSION)
+            {
+                throw std::runtime_error("Unsupported snapshot version " + std::to_string(header.version));
+            }
+            if (header.index_offset > file.size() ||
+                header.result_count > (file.size() - header.index_offset) / sizeof(uint64_t))
+            {
+                throw std::runtime_error("Snapshot index is out of bounds.");
+            }
+
+            std::vector<uint64_t> index(header.result_count);
+            std::memcpy(index.data(), file.data() + header.index_offset, index.size() * sizeof(uint64_t));
+
+            SessionSnapshot snapshot;
+            snapshot.next_command_id = header.next_command_id;
+            snapshot.results.resize(index.size());
+            parallel_for(0, index.size(), [&](size_t begin, size_t end)
+                         {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    SnapshotReader reader(file.data(), header.index_offset, index[i]);
+                    snapshot.results[i] = read_record(reader);
+                } });
+
+            SnapshotReader attachment_reader(file.data(), header.index_offset, header.attachments_offset);
+            for (uint64_t i = 0; i < header.attachment_count; ++i)
+            {
+                std::string name = attachment_reader.read_string();
+                snapshot.attachments[std::move(name)] = attachment_reader.read_string();
+            }
+
+            spdlog::info("Read session snapshot with {} results from {}", snapshot.results.size(), path.string());
+            return snapshot;
+        }
+        catch (const std::exception &e)
+        {
+            spdlog::error("Failed to read session snapshot {}: {}", path.string(), e.what());
+            return std::nullopt;
+        }
+    }
+
+} // namespace MITSU_Domoe